@@ -0,0 +1,184 @@
+#include <rtthread.h>
+#include <string.h>
+#include "dap.h"
+#include "attach_cache.h"
+/* black magic debug includes */
+#include "general.h"
+#include "exception.h"
+#include "gdb_main.h"
+#include "target.h"
+#include "platform.h"
+
+#define DBG_TAG "ATTACH"
+#define DBG_LVL DBG_INFO
+#include <rtdbg.h>
+
+/* fast re-attach. see attach_cache.h */
+
+static struct attach_id          attach_last;  /* board at the last full attach */
+static bool                      attach_valid; /* target list is of attach_last */
+static struct attach_cache_stats attach_stats;
+
+/* every scan, swd or jtag, from gdb or from here, begins by freeing the target list.
+ * the linker sends calls here, see SConscript */
+
+void __real_target_list_free(void);
+
+void __wrap_target_list_free(void)
+{
+    attach_valid = false;
+    __real_target_list_free();
+}
+
+/* connect, power up the debug domain, read the ids, disconnect. see dap_probe_begin().
+ * false if no dp answers, or the ap can not be read */
+static bool attach_read_id(struct attach_id *id)
+{
+    memset(id, 0, sizeof(*id));
+    if (dap_probe_begin(&id->idcode) == 1)
+    {
+        /* TARGETID is in dp bank 2, from dpv2 on */
+        if (((id->idcode >> 12) & 0xf) >= 2)
+        {
+            id->targetid = 0x02; /* SELECT, then dp 0x4 */
+            if (dap_probe_transfer(0x08, &id->targetid) != 1 || dap_probe_transfer(0x06, &id->targetid) != 1)
+                id->targetid = 0;
+        }
+        /* IDR is at 0xfc, ap bank 0xf */
+        id->ap_idr = 0xf0; /* SELECT, then ap 0xc */
+        if (dap_probe_transfer(0x08, &id->ap_idr) != 1 || dap_probe_transfer(0x0f, &id->ap_idr) != 1)
+            id->ap_idr = 0;
+    }
+    dap_probe_end();
+    return id->idcode != 0 && id->ap_idr != 0;
+}
+
+/* full scan of the swd bus. returns NULL on success, else an error message */
+static const char *attach_scan()
+{
+    const char *msg = NULL;
+
+    if (connect_assert_nrst)
+        platform_nrst_set_val(true); /* will be deasserted after attach */
+
+    bool scan_result = false;
+    TRY(EXCEPTION_ALL)
+    {
+        scan_result = adiv5_swd_scan(0);
+    }
+    CATCH()
+    {
+    case EXCEPTION_TIMEOUT:
+        msg = "Timeout during scan. Is target stuck in WFI?";
+        break;
+    case EXCEPTION_ERROR:
+        msg = (char *)exception_frame.msg;
+        break;
+    default:
+        break;
+    }
+
+    if (!scan_result)
+        msg = "swd scan failed";
+
+    if (msg)
+    {
+        platform_target_clk_output_enable(false);
+        platform_nrst_set_val(false);
+        return msg;
+    }
+
+    platform_target_clk_output_enable(false);
+    return NULL;
+}
+
+const char *attach_cache_attach(void)
+{
+    extern target_controller_s gdb_controller;
+    struct attach_id           id;
+    const char                *msg = NULL;
+    bool                       known;
+    rt_tick_t                  start = rt_tick_get();
+
+    known = attach_read_id(&id);
+    if (known && attach_valid && !memcmp(&id, &attach_last, sizeof(id)))
+    {
+        /* same board as last time; the target list still holds its aps, rom tables and driver */
+        if (connect_assert_nrst)
+            platform_nrst_set_val(true);
+        cur_target = target_attach_n(1, &gdb_controller);
+        if (cur_target)
+        {
+            attach_stats.fast++;
+            attach_stats.last_ms = (rt_tick_get() - start) * 1000 / RT_TICK_PER_SECOND;
+            attach_stats.fast_ms += attach_stats.last_ms;
+            LOG_I("attached in %u ms, idcode %08x", attach_stats.last_ms, id.idcode);
+            return NULL;
+        }
+        attach_stats.fallback++;
+        platform_nrst_set_val(false);
+    }
+
+    msg = attach_scan();
+    if (!msg)
+    {
+        /* Attach to remote target processor */
+        cur_target = target_attach_n(1, &gdb_controller);
+        if (!cur_target)
+            msg = "attach failed";
+    }
+    if (msg)
+    {
+        attach_stats.failed++;
+        return msg;
+    }
+    attach_last  = id;
+    attach_valid = known;
+    attach_stats.full++;
+    attach_stats.last_ms = (rt_tick_get() - start) * 1000 / RT_TICK_PER_SECOND;
+    attach_stats.full_ms += attach_stats.last_ms;
+    LOG_I("attached in %u ms with scan, idcode %08x", attach_stats.last_ms, id.idcode);
+    return NULL;
+}
+
+void attach_cache_clear(void)
+{
+    attach_valid = false;
+}
+
+void attach_cache_get_stats(struct attach_cache_stats *stats, bool clear)
+{
+    *stats = attach_stats;
+    if (clear)
+        memset(&attach_stats, 0, sizeof(attach_stats));
+}
+
+#ifdef RT_USING_FINSH
+static int cmd_attach_cache(int argc, char **argv)
+{
+    struct attach_cache_stats stats;
+
+    if (argc == 2 && !strcmp(argv[1], "forget"))
+    {
+        attach_cache_clear();
+        return RT_EOK;
+    }
+    if (argc != 1 && !(argc == 2 && !strcmp(argv[1], "clear")))
+    {
+        rt_kprintf("attach_cache [clear | forget]\r\n");
+        return -RT_EINVAL;
+    }
+    attach_cache_get_stats(&stats, argc == 2);
+    if (attach_valid)
+        rt_kprintf("idcode %08x targetid %08x ap idr %08x\r\n", attach_last.idcode, attach_last.targetid,
+                   attach_last.ap_idr);
+    else
+        rt_kprintf("no target\r\n");
+    rt_kprintf("with scan %u avg %u ms, without scan %u avg %u ms, fallback %u, failed %u, last %u ms\r\n", stats.full,
+               stats.full ? stats.full_ms / stats.full : 0, stats.fast, stats.fast ? stats.fast_ms / stats.fast : 0,
+               stats.fallback, stats.failed, stats.last_ms);
+    return RT_EOK;
+}
+
+MSH_CMD_EXPORT_ALIAS(cmd_attach_cache, attach_cache, re-attach without scan: attach_cache [clear | forget]);
+#endif
@@ -0,0 +1,45 @@
+#ifndef _ATTACH_CACHE_H
+#define _ATTACH_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+   attach black magic debug to the first target on the swd bus.
+
+   a full attach scans the bus, walks the rom tables and probes the target drivers.
+   the targets found stay in the black magic target list until the next scan.
+   before each attach, the dp IDCODE, TARGETID and the IDR of the first ap are read.
+   if these are the same as at the last full attach, and the target list is still
+   there, the scan is skipped and the target attached at once. if not, or if that
+   attach fails, the bus is scanned again.
+ */
+
+struct attach_id
+{
+    uint32_t idcode;   /* dp IDCODE */
+    uint32_t targetid; /* dp TARGETID, 0 before dpv2 */
+    uint32_t ap_idr;   /* IDR of ap 0 */
+};
+
+struct attach_cache_stats
+{
+    uint32_t full;      /* attaches with scan */
+    uint32_t fast;      /* attaches without scan */
+    uint32_t fallback;  /* attaches without scan that failed, and scanned after all */
+    uint32_t failed;    /* attaches that failed */
+    uint32_t last_ms;   /* time to attach, last attach */
+    uint32_t full_ms;   /* time to attach with scan, total */
+    uint32_t fast_ms;   /* time to attach without scan, total */
+};
+
+/* sets cur_target. returns NULL on success, else an error message.
+   call with the swd pins taken by SWD_USER_BMD, see swd_arbiter.h */
+const char *attach_cache_attach(void);
+
+/* forget the target; the next attach scans */
+void attach_cache_clear(void);
+
+void attach_cache_get_stats(struct attach_cache_stats *stats, bool clear);
+
+#endif
@@ -14,6 +14,7 @@
 
 #include <rtthread.h>
 #include <rtdevice.h>
+#include <board.h>
 
 #if defined(RT_USING_CAN) && defined(BSP_USING_CAN1)
 
@@ -314,6 +315,7 @@ rt_err_t canbus_set_mode(int mode)
 
 /* CAN receive */
 
+AT32_RAMFUNC
 static rt_err_t can_rx_handler(rt_device_t dev, rt_size_t size)
 {
     if (can_rx_sem)
@@ -120,6 +120,7 @@ enum
   DAP_TRANSFER_A3           = 1 << 3,
   DAP_TRANSFER_MATCH_VALUE  = 1 << 4,
   DAP_TRANSFER_MATCH_MASK   = 1 << 5,
+  DAP_TRANSFER_TIMESTAMP    = 1 << 7,
   DAP_TRANSFER_JTAG_ABORT   = 1 << 16,
 };
 
@@ -161,9 +162,26 @@ enum
 {
   SWD_DP_R_IDCODE           = 0x00,
   SWD_DP_W_ABORT            = 0x00,
+  SWD_DP_W_CTRL_STAT        = 0x04,
+  SWD_DP_W_SELECT           = 0x08,
   SWD_DP_R_RDBUFF           = 0x0c,
 };
 
+enum
+{
+  MEM_AP_CSW                = 0x00,
+  MEM_AP_TAR                = 0x04,
+  MEM_AP_DRW                = 0x0c,
+};
+
+enum
+{
+  MEM_AP_CSW_SIZE_MASK      = 0x07,
+  MEM_AP_CSW_SIZE_32        = 0x02,
+  MEM_AP_CSW_ADDRINC_MASK   = 0x30,
+  MEM_AP_CSW_ADDRINC_SINGLE = 0x10,
+};
+
 enum
 {
   JTAG_ABORT                = 0x08,
@@ -233,6 +251,39 @@ static int dap_idle_cycles;
 static int dap_retry_count;
 static int dap_match_retry_count;
 static int dap_clock_delay;
+static int dap_clock_freq;
+static bool dap_cal_valid;
+static uint32_t dap_cal_fast;
+static uint32_t dap_cal_base;
+static uint32_t dap_cal_step;
+static bool dap_fast_clock;
+static int dap_swd_engine = DAP_SWD_ENGINE_BIT;
+static uint32_t dap_swd_verify_checks;
+static uint32_t dap_swd_verify_errors;
+static struct dap_stats dap_stats;
+static uint32_t dap_wait_budget_us = DAP_CONFIG_WAIT_BUDGET_US;
+static bool dap_mem_active;
+static uint32_t dap_mem_csw;
+static uint32_t dap_mem_tar;
+static bool dap_mem_next_valid;
+static uint32_t dap_mem_next;
+static bool dap_select_valid;
+static uint32_t dap_select;
+static bool dap_saved_valid;
+static uint32_t dap_saved_csw;
+static uint32_t dap_saved_tar;
+static struct
+{
+  int port;
+  bool select_valid;
+  uint32_t select;
+  int idle_cycles;
+  int retry_count;
+  int match_retry_count;
+  struct dap_stats stats;
+} dap_session;
+static bool dap_probe_suspended;
+static int dap_probe_clock;
 
 static void (*dap_swj_run)(int);
 static void (*dap_swd_write)(uint32_t, int);
@@ -251,6 +302,7 @@ static int dap_req_ptr;
 static uint8_t *dap_resp_buf;
 static int dap_resp_size;
 static int dap_resp_ptr;
+static int dap_resp_base;
 
 static bool dap_buf_error;
 
@@ -302,8 +354,7 @@ DAP_SWJ_FN(fast, (void))
   {									\
     for (int i = 0; i < size; i++)					\
     {									\
-      DAP_CONFIG_SWDIO_TMS_write(value & 1);				\
-      DAP_CONFIG_SWCLK_TCK_clr();					\
+      DAP_CONFIG_SWCLK_TCK_clr_SWDIO_TMS_write(value & 1);		\
       delay(dap_clock_delay);						\
       DAP_CONFIG_SWCLK_TCK_set();					\
       delay(dap_clock_delay);						\
@@ -331,6 +382,95 @@ DAP_SWJ_FN(fast, (void))
 DAP_SWD_FN(slow, DAP_CONFIG_DELAY)
 DAP_SWD_FN(fast, (void))
 
+//-----------------------------------------------------------------------------
+// Word engine: fast clock only, with the 1, 8 and 32 bit shifts of a transfer
+// fully unrolled. Other sizes (ACK, sequences) use the bit loop.
+#define DAP_REPEAT8(m, n) m(n) m(n+1) m(n+2) m(n+3) m(n+4) m(n+5) m(n+6) m(n+7)
+
+#define DAP_SWD_WRITE_BIT(i)						\
+  DAP_CONFIG_SWCLK_TCK_clr_SWDIO_TMS_write((value >> (i)) & 1);		\
+  DAP_CONFIG_SWCLK_TCK_set();						\
+  if (verify && DAP_CONFIG_SWDIO_TMS_read() != (int)((value >> (i)) & 1)) \
+    dap_swd_verify_errors++;
+
+#define DAP_SWD_READ_BIT(i)						\
+  DAP_CONFIG_SWCLK_TCK_clr();						\
+  value |= (uint32_t)DAP_CONFIG_SWDIO_TMS_read() << (i);		\
+  DAP_CONFIG_SWCLK_TCK_set();
+
+//-----------------------------------------------------------------------------
+__attribute__((always_inline)) static inline void dap_swd_write_word_body(uint32_t value, int size, bool verify)
+{
+  switch (size)
+  {
+    case 32:
+      DAP_REPEAT8(DAP_SWD_WRITE_BIT, 0)
+      DAP_REPEAT8(DAP_SWD_WRITE_BIT, 8)
+      DAP_REPEAT8(DAP_SWD_WRITE_BIT, 16)
+      DAP_REPEAT8(DAP_SWD_WRITE_BIT, 24)
+      break;
+
+    case 8:
+      DAP_REPEAT8(DAP_SWD_WRITE_BIT, 0)
+      break;
+
+    case 1:
+      DAP_SWD_WRITE_BIT(0)
+      break;
+
+    default:
+      dap_swd_write_fast(value, size);
+      break;
+  }
+}
+
+//-----------------------------------------------------------------------------
+DAP_CONFIG_PERFORMANCE_ATTR
+static void dap_swd_write_word(uint32_t value, int size)
+{
+  dap_swd_write_word_body(value, size, false);
+}
+
+//-----------------------------------------------------------------------------
+// Word engine, checking every bit driven on SWDIO against the expected value
+DAP_CONFIG_PERFORMANCE_ATTR
+static void dap_swd_write_verify(uint32_t value, int size)
+{
+  dap_swd_verify_checks++;
+  dap_swd_write_word_body(value, size, true);
+}
+
+//-----------------------------------------------------------------------------
+DAP_CONFIG_PERFORMANCE_ATTR
+static uint32_t dap_swd_read_word(int size)
+{
+  uint32_t value = 0;
+
+  switch (size)
+  {
+    case 32:
+      DAP_REPEAT8(DAP_SWD_READ_BIT, 0)
+      DAP_REPEAT8(DAP_SWD_READ_BIT, 8)
+      DAP_REPEAT8(DAP_SWD_READ_BIT, 16)
+      DAP_REPEAT8(DAP_SWD_READ_BIT, 24)
+      break;
+
+    case 8:
+      DAP_REPEAT8(DAP_SWD_READ_BIT, 0)
+      break;
+
+    case 1:
+      DAP_SWD_READ_BIT(0)
+      break;
+
+    default:
+      value = dap_swd_read_fast(size);
+      break;
+  }
+
+  return value;
+}
+
 //-----------------------------------------------------------------------------
 static inline uint32_t dap_parity(uint32_t value)
 {
@@ -343,8 +483,15 @@ static inline uint32_t dap_parity(uint32_t value)
 }
 
 //-----------------------------------------------------------------------------
-static int dap_swd_operation(int req, uint32_t *data)
+// Direct call to the fast or slow variant. With a constant 'fast' argument the
+// choice is made at compile time, and the bit functions can be inlined.
+#define DAP_FN(fast, name) ((fast) ? name##_fast : name##_slow)
+
+//-----------------------------------------------------------------------------
+__attribute__((always_inline)) static inline int dap_swd_operation_body(int req, uint32_t *data, bool fast,
+    void (*dap_swd_write)(uint32_t, int), uint32_t (*dap_swd_read)(int))
 {
+  void (*dap_swj_run)(int) = DAP_FN(fast, dap_swj_run);
   uint32_t value;
   int ack = 0;
 
@@ -414,6 +561,131 @@ static int dap_swd_operation(int req, uint32_t *data)
   return ack;
 }
 
+//-----------------------------------------------------------------------------
+DAP_CONFIG_PERFORMANCE_ATTR
+static int dap_swd_operation_fast(int req, uint32_t *data)
+{
+  return dap_swd_operation_body(req, data, true, dap_swd_write_fast, dap_swd_read_fast);
+}
+
+//-----------------------------------------------------------------------------
+DAP_CONFIG_PERFORMANCE_ATTR
+static int dap_swd_operation_slow(int req, uint32_t *data)
+{
+  return dap_swd_operation_body(req, data, false, dap_swd_write_slow, dap_swd_read_slow);
+}
+
+//-----------------------------------------------------------------------------
+DAP_CONFIG_PERFORMANCE_ATTR
+static int dap_swd_operation_word(int req, uint32_t *data)
+{
+  return dap_swd_operation_body(req, data, true, dap_swd_write_word, dap_swd_read_word);
+}
+
+//-----------------------------------------------------------------------------
+// Word engine with cross-check against the bit engine. Writes are checked bit by
+// bit on the SWDIO pin. DP reads have no side effects, and are read again with
+// the bit engine and compared.
+static int dap_swd_operation_verify(int req, uint32_t *data)
+{
+  uint32_t value = 0, check;
+  int ack;
+
+  if (0 == (req & DAP_TRANSFER_RnW))
+    return dap_swd_operation_body(req, data, true, dap_swd_write_verify, dap_swd_read_word);
+
+  ack = dap_swd_operation_body(req, &value, true, dap_swd_write_verify, dap_swd_read_word);
+
+  if (DAP_TRANSFER_OK == ack && 0 == (req & DAP_TRANSFER_APnDP))
+  {
+    dap_swd_verify_checks++;
+
+    if (DAP_TRANSFER_OK != dap_swd_operation_fast(req, &check) || check != value)
+      dap_swd_verify_errors++;
+  }
+
+  if (data)
+    *data = value;
+
+  return ack;
+}
+
+//-----------------------------------------------------------------------------
+DAP_CONFIG_PERFORMANCE_ATTR
+static int dap_swd_operation(int req, uint32_t *data)
+{
+  if (!dap_fast_clock)
+    return dap_swd_operation_slow(req, data);
+  else if (DAP_SWD_ENGINE_WORD == dap_swd_engine)
+    return dap_swd_operation_word(req, data);
+  else if (DAP_SWD_ENGINE_VERIFY == dap_swd_engine)
+    return dap_swd_operation_verify(req, data);
+  else
+    return dap_swd_operation_fast(req, data);
+}
+
+//-----------------------------------------------------------------------------
+// WAIT retries back off. The first DAP_WAIT_FAST_RETRIES follow at once, for
+// targets that are busy for a few clocks. After that, the idle cycles between
+// retries double up to DAP_WAIT_MAX_IDLE, for slow targets such as a flash
+// being written or a core in a low power mode. The transfer gives up when both
+// the retry count and the time budget are used up.
+#define DAP_WAIT_FAST_RETRIES   4
+#define DAP_WAIT_MIN_IDLE       8
+#define DAP_WAIT_MAX_IDLE       1024
+
+static int dap_wait_retry(int req, uint32_t *data, int ack, int (*operation)(int, uint32_t *))
+{
+  uint32_t mhz = DAP_CONFIG_CPU_HZ / 1000000;
+  uint32_t start = DAP_CONFIG_CYCLES();
+  uint32_t elapsed;
+  int idle = 0;
+
+  for (int i = 1; DAP_TRANSFER_WAIT == ack && !dap_abort; i++)
+  {
+    dap_stats.wait++;
+
+    if (i >= dap_retry_count && (DAP_CONFIG_CYCLES() - start) >= dap_wait_budget_us * mhz)
+    {
+      dap_stats.timeouts++;
+      break;
+    }
+
+    if (i > DAP_WAIT_FAST_RETRIES)
+    {
+      idle = (0 == idle) ? DAP_WAIT_MIN_IDLE : (idle < DAP_WAIT_MAX_IDLE) ? 2 * idle : idle;
+
+      DAP_CONFIG_SWDIO_TMS_write(0);
+      dap_swj_run(idle);
+      DAP_CONFIG_SWDIO_TMS_write(1);
+    }
+
+    dap_stats.retries++;
+    ack = operation(req, data);
+  }
+
+  elapsed = (DAP_CONFIG_CYCLES() - start) / mhz;
+
+  if (elapsed > dap_stats.max_wait_us)
+    dap_stats.max_wait_us = elapsed;
+
+  return ack;
+}
+
+//-----------------------------------------------------------------------------
+// Count the final ack of a transfer
+static int dap_count_ack(int ack)
+{
+  if (DAP_TRANSFER_FAULT == ack)
+    dap_stats.fault++;
+  else if (DAP_TRANSFER_ERROR == ack)
+    dap_stats.parity++;
+  else if (DAP_TRANSFER_OK != ack && DAP_TRANSFER_WAIT != ack)
+    dap_stats.no_ack++;
+
+  return ack;
+}
+
 #ifdef DAP_CONFIG_ENABLE_JTAG
 //-----------------------------------------------------------------------------
 #define DAP_JTAG_FN(ver, delay) \
@@ -422,8 +694,7 @@ static int dap_swd_operation(int req, uint32_t *data)
   {									\
     for (int i = 0; i < size; i++)					\
     {									\
-      DAP_CONFIG_TDI_write(value & 1);					\
-      DAP_CONFIG_SWCLK_TCK_clr();					\
+      DAP_CONFIG_SWCLK_TCK_clr_TDI_write(value & 1);			\
       delay(dap_clock_delay);						\
       DAP_CONFIG_SWCLK_TCK_set();					\
       delay(dap_clock_delay);						\
@@ -456,8 +727,7 @@ static int dap_swd_operation(int req, uint32_t *data)
     uint32_t bit;							\
     for (int i = 0; i < size; i++)					\
     {									\
-      DAP_CONFIG_TDI_write(value & 1);					\
-      DAP_CONFIG_SWCLK_TCK_clr();					\
+      DAP_CONFIG_SWCLK_TCK_clr_TDI_write(value & 1);			\
       delay(dap_clock_delay);						\
       bit = DAP_CONFIG_TDO_read();					\
       DAP_CONFIG_SWCLK_TCK_set();					\
@@ -469,18 +739,127 @@ static int dap_swd_operation(int req, uint32_t *data)
   }
 
 DAP_JTAG_FN(slow, DAP_CONFIG_DELAY)
-DAP_JTAG_FN(fast, (void))
 
 //-----------------------------------------------------------------------------
-static void dap_jtag_write_ir(int ir)
+// At the fast clock, JTAG shifts are unrolled a byte at a time
+#define DAP_JTAG_WRITE_BIT(i)						\
+  DAP_CONFIG_SWCLK_TCK_clr_TDI_write((value >> (i)) & 1);		\
+  DAP_CONFIG_SWCLK_TCK_set();
+
+#define DAP_JTAG_READ_BIT(i)						\
+  DAP_CONFIG_SWCLK_TCK_clr();						\
+  byte |= (uint32_t)DAP_CONFIG_TDO_read() << (i);			\
+  DAP_CONFIG_SWCLK_TCK_set();
+
+#define DAP_JTAG_RDWR_BIT(i)						\
+  DAP_CONFIG_SWCLK_TCK_clr_TDI_write((value >> (i)) & 1);		\
+  byte |= (uint32_t)DAP_CONFIG_TDO_read() << (i);			\
+  DAP_CONFIG_SWCLK_TCK_set();
+
+//-----------------------------------------------------------------------------
+DAP_CONFIG_PERFORMANCE_ATTR
+static uint32_t dap_jtag_write_fast(uint32_t value, int size)
+{
+  for (; size >= 8; size -= 8)
+  {
+    DAP_REPEAT8(DAP_JTAG_WRITE_BIT, 0)
+    value >>= 8;
+  }
+
+  for (; size; size--)
+  {
+    DAP_JTAG_WRITE_BIT(0)
+    value >>= 1;
+  }
+
+  return value;
+}
+
+//-----------------------------------------------------------------------------
+DAP_CONFIG_PERFORMANCE_ATTR
+static uint32_t dap_jtag_read_fast(int size)
+{
+  uint32_t value = 0;
+  uint32_t byte;
+  int shift = 0;
+
+  for (; size >= 8; size -= 8, shift += 8)
+  {
+    byte = 0;
+    DAP_REPEAT8(DAP_JTAG_READ_BIT, 0)
+    value |= byte << shift;
+  }
+
+  for (; size; size--, shift++)
+  {
+    byte = 0;
+    DAP_JTAG_READ_BIT(0)
+    value |= byte << shift;
+  }
+
+  return value;
+}
+
+//-----------------------------------------------------------------------------
+DAP_CONFIG_PERFORMANCE_ATTR
+static uint32_t dap_jtag_rdwr_fast(uint32_t value, int size)
+{
+  uint32_t rvalue = 0;
+  uint32_t byte;
+  int shift = 0;
+
+  for (; size >= 8; size -= 8, shift += 8)
+  {
+    byte = 0;
+    DAP_REPEAT8(DAP_JTAG_RDWR_BIT, 0)
+    value >>= 8;
+    rvalue |= byte << shift;
+  }
+
+  for (; size; size--, shift++)
+  {
+    byte = 0;
+    DAP_JTAG_RDWR_BIT(0)
+    value >>= 1;
+    rvalue |= byte << shift;
+  }
+
+  return rvalue;
+}
+
+//-----------------------------------------------------------------------------
+#define DAP_ONES(n) (((n) < 32) ? ((1u << (n)) - 1) : 0xffffffffu)
+
+//-----------------------------------------------------------------------------
+__attribute__((always_inline)) static inline void dap_jtag_write_ir(int ir, bool fast)
 {
+  void (*dap_swj_run)(int) = DAP_FN(fast, dap_swj_run);
+  uint32_t (*dap_jtag_write)(uint32_t, int) = DAP_FN(fast, dap_jtag_write);
   int len = dap_jtag_ir_length[dap_jtag_dev_index];
+  int before = dap_jtag_ir_before[dap_jtag_dev_index];
+  int total = before + len + dap_jtag_ir_after[dap_jtag_dev_index];
 
   DAP_CONFIG_SWDIO_TMS_write(1);
   dap_swj_run(2); // -> Select-IR-Scan
   DAP_CONFIG_SWDIO_TMS_write(0);
   dap_swj_run(2); // -> Shift-IR
 
+  if (total <= 32)
+  {
+    // The other devices get BYPASS (all ones): the whole chain in one shift
+    uint32_t value = (DAP_ONES(total) & ~(DAP_ONES(len) << before)) | ((uint32_t)ir << before);
+
+    value = dap_jtag_write(value, total - 1);
+    DAP_CONFIG_SWDIO_TMS_write(1);
+    dap_jtag_write(value, 1); // -> Exit1-IR
+
+    dap_swj_run(1); // -> Update-IR
+    DAP_CONFIG_SWDIO_TMS_write(0);
+    dap_swj_run(1); // -> Idle
+    DAP_CONFIG_TDI_write(1);
+    return;
+  }
+
   DAP_CONFIG_TDI_write(1);
   dap_swj_run(dap_jtag_ir_before[dap_jtag_dev_index]);
 
@@ -509,8 +888,12 @@ static void dap_jtag_write_ir(int ir)
 }
 
 //-----------------------------------------------------------------------------
-static int dap_jtag_operation(int req, uint32_t *data)
+__attribute__((always_inline)) static inline int dap_jtag_operation_body(int req, uint32_t *data, bool fast)
 {
+  void (*dap_swj_run)(int) = DAP_FN(fast, dap_swj_run);
+  uint32_t (*dap_jtag_write)(uint32_t, int) = DAP_FN(fast, dap_jtag_write);
+  uint32_t (*dap_jtag_read)(int) = DAP_FN(fast, dap_jtag_read);
+  uint32_t (*dap_jtag_rdwr)(uint32_t, int) = DAP_FN(fast, dap_jtag_rdwr);
   int ack, ir;
 
   if (DAP_TRANSFER_JTAG_ABORT == req)
@@ -521,7 +904,7 @@ static int dap_jtag_operation(int req, uint32_t *data)
   if (ir != dap_jtag_ir)
   {
     dap_jtag_ir = ir;
-    dap_jtag_write_ir(ir);
+    dap_jtag_write_ir(ir, fast);
   }
 
   DAP_CONFIG_SWDIO_TMS_write(1);
@@ -536,7 +919,10 @@ static int dap_jtag_operation(int req, uint32_t *data)
   else if (ack == 0x1)
     ack = DAP_TRANSFER_WAIT;
   else
+  {
     ack = DAP_TRANSFER_INVALID;
+    dap_jtag_ir = JTAG_INVALID; // No target, or the chain is not as configured
+  }
 
   if (DAP_TRANSFER_OK == ack)
   {
@@ -596,17 +982,87 @@ static int dap_jtag_operation(int req, uint32_t *data)
 
   return ack;
 }
+
+//-----------------------------------------------------------------------------
+DAP_CONFIG_PERFORMANCE_ATTR
+static int dap_jtag_operation_fast(int req, uint32_t *data)
+{
+  return dap_jtag_operation_body(req, data, true);
+}
+
+//-----------------------------------------------------------------------------
+DAP_CONFIG_PERFORMANCE_ATTR
+static int dap_jtag_operation_slow(int req, uint32_t *data)
+{
+  return dap_jtag_operation_body(req, data, false);
+}
+
+//-----------------------------------------------------------------------------
+static int dap_jtag_operation(int req, uint32_t *data)
+{
+  if (dap_fast_clock)
+    return dap_jtag_operation_fast(req, data);
+  else
+    return dap_jtag_operation_slow(req, data);
+}
 #endif // DAP_CONFIG_ENABLE_JTAG
 
+//-----------------------------------------------------------------------------
+static void dap_setup_swd_engine(void)
+{
+  if (!dap_fast_clock)
+  {
+    dap_swd_write = dap_swd_write_slow;
+    dap_swd_read  = dap_swd_read_slow;
+  }
+  else if (DAP_SWD_ENGINE_BIT == dap_swd_engine)
+  {
+    dap_swd_write = dap_swd_write_fast;
+    dap_swd_read  = dap_swd_read_fast;
+  }
+  else
+  {
+    dap_swd_write = (DAP_SWD_ENGINE_VERIFY == dap_swd_engine) ? dap_swd_write_verify : dap_swd_write_word;
+    dap_swd_read  = dap_swd_read_word;
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Delay loop count for a clock frequency, or -1 for the fast clock. With
+// calibration, the count is rounded up: the clock is never above the request.
+static int dap_clock_delay_for(int freq)
+{
+  uint64_t cycles;
+
+  if (freq < 1)
+    freq = 1;
+
+  if (!dap_cal_valid)
+    return (freq > DAP_CONFIG_FAST_CLOCK) ? -1 : (DAP_CONFIG_DELAY_CONSTANT * 1000) / freq;
+
+  cycles = (uint64_t)DAP_CONFIG_CPU_HZ * 256 / freq;
+
+  if (cycles <= (uint64_t)dap_cal_fast * 256)
+    return -1;
+
+  if (cycles <= (uint64_t)dap_cal_base * 256)
+    return 0;
+
+  return (cycles - (uint64_t)dap_cal_base * 256 + dap_cal_step - 1) / dap_cal_step;
+}
+
 //-----------------------------------------------------------------------------
 static void dap_setup_clock(int freq)
 {
-  if (freq > DAP_CONFIG_FAST_CLOCK)
+  int delay = dap_clock_delay_for(freq);
+
+  dap_clock_freq = freq;
+
+  if (delay < 0)
   {
     dap_clock_delay = 0;
+    dap_fast_clock  = true;
     dap_swj_run     = dap_swj_run_fast;
-    dap_swd_write   = dap_swd_write_fast;
-    dap_swd_read    = dap_swd_read_fast;
 #ifdef DAP_CONFIG_ENABLE_JTAG
     dap_jtag_write  = dap_jtag_write_fast;
     dap_jtag_read   = dap_jtag_read_fast;
@@ -615,16 +1071,38 @@ static void dap_setup_clock(int freq)
   }
   else
   {
-    dap_clock_delay = (DAP_CONFIG_DELAY_CONSTANT * 1000) / freq;
+    dap_clock_delay = delay;
+    dap_fast_clock  = false;
     dap_swj_run     = dap_swj_run_slow;
-    dap_swd_write   = dap_swd_write_slow;
-    dap_swd_read    = dap_swd_read_slow;
 #ifdef DAP_CONFIG_ENABLE_JTAG
     dap_jtag_write  = dap_jtag_write_slow;
     dap_jtag_read   = dap_jtag_read_slow;
     dap_jtag_rdwr   = dap_jtag_rdwr_slow;
 #endif
   }
+
+  dap_setup_swd_engine();
+}
+
+//-----------------------------------------------------------------------------
+// Long sequences are played out by the waveform engine, if available.
+// Returns false if the sequence has to be clocked by the cpu.
+static bool dap_wave_sequence(int out_pin, uint8_t *out, int in_pin, uint8_t *in, int bits)
+{
+  if (bits < DAP_CONFIG_WAVE_MIN_BITS)
+    return false;
+
+  return DAP_CONFIG_WAVE(out_pin, out, in_pin, in, bits, dap_clock_freq);
+}
+
+//-----------------------------------------------------------------------------
+// The IR of the selected device is kept across requests. The other devices are
+// in BYPASS. Commands that may change the TAP state or the chain forget it.
+static void dap_jtag_ir_invalidate(void)
+{
+#ifdef DAP_CONFIG_ENABLE_JTAG
+  dap_jtag_ir = JTAG_INVALID;
+#endif
 }
 
 //-----------------------------------------------------------------------------
@@ -639,6 +1117,9 @@ static bool dap_select_device(int index)
     if (index >= dap_jtag_dev_count || dap_jtag_ir_length[index] != ARM_JTAG_IR_LENGTH)
       return false;
 
+    if (index != dap_jtag_dev_index)
+      dap_jtag_ir_invalidate();
+
     dap_jtag_dev_index = index;
 
     return true;
@@ -650,25 +1131,35 @@ static bool dap_select_device(int index)
 }
 
 //-----------------------------------------------------------------------------
-static int dap_transfer_word(int req, uint32_t *data)
+static int dap_transfer_once(int req, uint32_t *data)
 {
-  int ack = DAP_TRANSFER_INVALID;
-
-  for (int i = 0; i < dap_retry_count; i++)
-  {
-    if (DAP_PORT_SWD == dap_port)
-      ack = dap_swd_operation(req, data);
+  if (DAP_PORT_SWD == dap_port)
+    return dap_swd_operation(req, data);
 
 #ifdef DAP_CONFIG_ENABLE_JTAG
-    else if (DAP_PORT_JTAG == dap_port)
-      ack = dap_jtag_operation(req, data);
+  else if (DAP_PORT_JTAG == dap_port)
+    return dap_jtag_operation(req, data);
 #endif
 
-    if (DAP_TRANSFER_WAIT != ack || dap_abort)
-      break;
+  return DAP_TRANSFER_INVALID;
+}
+
+//-----------------------------------------------------------------------------
+static int dap_transfer_word(int req, uint32_t *data)
+{
+  int ack = dap_transfer_once(req, data);
+
+  if (DAP_TRANSFER_WAIT == ack)
+    ack = dap_wait_retry(req, data, ack, dap_transfer_once);
+
+  // The host's SELECT, restored by dap_resume()
+  if (DAP_TRANSFER_OK == ack && SWD_DP_W_SELECT == (req & 0x0f))
+  {
+    dap_select = *data;
+    dap_select_valid = true;
   }
 
-  return ack;
+  return dap_count_ack(ack);
 }
 
 //-----------------------------------------------------------------------------
@@ -698,6 +1189,7 @@ static void dap_buf_init(uint8_t *req, int req_size, uint8_t *resp, int resp_siz
   dap_resp_buf  = resp;
   dap_resp_size = resp_size;
   dap_resp_ptr  = 0;
+  dap_resp_base = 0;
 
   dap_buf_error = false;
 }
@@ -779,32 +1271,111 @@ void dap_resp_add_word(uint32_t value)
 }
 
 //-----------------------------------------------------------------------------
-void dap_resp_set_byte(int index, uint8_t value)
+// Bytes left in the request buffer
+int dap_req_space(void)
 {
-  if (index < dap_resp_ptr)
-    dap_resp_buf[index] = value;
+  return dap_buf_error ? 0 : (dap_req_size - dap_req_ptr);
 }
 
 //-----------------------------------------------------------------------------
-bool dap_is_buf_error(void)
+// 'size' bytes of the request, in place
+uint8_t *dap_req_get_data(int size)
 {
-  return dap_buf_error;
+  uint8_t *data = &dap_req_buf[dap_req_ptr];
+
+  if (dap_buf_error || ((dap_req_size - dap_req_ptr) < size))
+  {
+    dap_buf_error = true;
+    return NULL;
+  }
+
+  dap_req_ptr += size;
+
+  return data;
 }
 
 //-----------------------------------------------------------------------------
-static void dap_info(void)
+// Bytes left in the response buffer
+int dap_resp_space(void)
 {
-  int index = dap_req_get_byte();
+  return dap_buf_error ? 0 : (dap_resp_size - dap_resp_ptr);
+}
 
-  if (DAP_INFO_CAPABILITIES == index)
+//-----------------------------------------------------------------------------
+// 'size' bytes added to the response, to be filled in place
+uint8_t *dap_resp_add_data(int size)
+{
+  uint8_t *data = &dap_resp_buf[dap_resp_ptr];
+
+  if (dap_buf_error || ((dap_resp_size - dap_resp_ptr) < size))
   {
-    int cap = DAP_CAP_SWD;
-#ifdef DAP_CONFIG_ENABLE_JTAG
-    cap |= DAP_CAP_JTAG;
+    dap_buf_error = true;
+    return NULL;
+  }
+
+  dap_resp_ptr += size;
+
+  return data;
+}
+
+//-----------------------------------------------------------------------------
+// the last 'size' bytes of dap_resp_add_data() taken back out of the response
+void dap_resp_trim(int size)
+{
+  if (!dap_buf_error && size <= dap_resp_ptr - dap_resp_base)
+    dap_resp_ptr -= size;
+}
+
+//-----------------------------------------------------------------------------
+// index is relative to the response of the current command
+void dap_resp_set_byte(int index, uint8_t value)
+{
+  index += dap_resp_base;
+
+  if (index < dap_resp_ptr)
+    dap_resp_buf[index] = value;
+}
+
+//-----------------------------------------------------------------------------
+bool dap_is_buf_error(void)
+{
+  return dap_buf_error;
+}
+
+//-----------------------------------------------------------------------------
+static void dap_info(void)
+{
+  int index = dap_req_get_byte();
+
+  if (DAP_INFO_CAPABILITIES == index)
+  {
+    int cap = DAP_CAP_SWD;
+#ifdef DAP_CONFIG_ENABLE_JTAG
+    cap |= DAP_CAP_JTAG;
+#endif
+#ifdef DAP_CONFIG_ENABLE_SWO
+    cap |= DAP_CAP_SWO_UART | DAP_CAP_SWO_STREAMING;
+#endif
+#ifdef DAP_CONFIG_ENABLE_TIMESTAMP
+    cap |= DAP_CAP_TDT;
 #endif
     dap_resp_add_byte(1);
     dap_resp_add_byte(cap);
   }
+#ifdef DAP_CONFIG_ENABLE_TIMESTAMP
+  else if (DAP_INFO_TDT == index)
+  {
+    dap_resp_add_byte(4);
+    dap_resp_add_word(DAP_CONFIG_TIMESTAMP_CLOCK);
+  }
+#endif
+#ifdef DAP_CONFIG_ENABLE_SWO
+  else if (DAP_INFO_SWO_BUF_SIZE == index)
+  {
+    dap_resp_add_byte(4);
+    dap_resp_add_word(DAP_CONFIG_SWO_BUF_SIZE);
+  }
+#endif
   else if (DAP_INFO_PACKET_COUNT == index)
   {
     dap_resp_add_byte(1);
@@ -830,7 +1401,7 @@ static void dap_info(void)
           dap_resp_add_byte(*str++);
         dap_resp_add_byte(0);
 
-        dap_resp_set_byte(1, dap_resp_ptr-2);
+        dap_resp_set_byte(1, dap_resp_ptr-dap_resp_base-2);
 
         break;
       }
@@ -858,6 +1429,9 @@ static void dap_connect(void)
     port = DAP_CONFIG_DEFAULT_PORT;
 
   dap_port = DAP_PORT_DISABLED;
+  dap_jtag_ir_invalidate();
+  memset(&dap_stats, 0, sizeof(dap_stats));
+  dap_select_valid = false;
 
   if (DAP_PORT_SWD == port)
   {
@@ -882,6 +1456,7 @@ static void dap_disconnect(void)
   DAP_CONFIG_DISCONNECT();
 
   dap_port = DAP_PORT_DISABLED;
+  dap_jtag_ir_invalidate();
 
   dap_resp_add_byte(DAP_OK);
 }
@@ -896,21 +1471,55 @@ static void dap_transfer_configure(void)
   dap_resp_add_byte(DAP_OK);
 }
 
+//-----------------------------------------------------------------------------
+// Skip the data of requests that are not executed, so that the next command of
+// an ExecuteCommands request is parsed from the right place. request -1: read
+// the request bytes from the request buffer.
+static void dap_transfer_skip(int request, int count)
+{
+  for (int i = 0; i < count && !dap_buf_error; i++)
+  {
+    int req = (request < 0) ? dap_req_get_byte() : request;
+
+    if (0 == (req & DAP_TRANSFER_RnW) || (req & DAP_TRANSFER_MATCH_VALUE))
+      dap_req_get_word();
+  }
+}
+
+//-----------------------------------------------------------------------------
+// The timestamp is taken when the transfer has completed. Transfers with
+// value match have no timestamp.
+static inline void dap_transfer_timestamp(int request)
+{
+#ifdef DAP_CONFIG_ENABLE_TIMESTAMP
+  if (request & DAP_TRANSFER_TIMESTAMP)
+    dap_resp_add_word(DAP_CONFIG_TIMESTAMP());
+#else
+  (void)request;
+#endif
+}
+
 //-----------------------------------------------------------------------------
 static void dap_transfer(void)
 {
-  int req_count, resp_count, request, ack;
+  int req_count, resp_count, request, ack, index, parsed, total;
   bool posted_read, verify_write;
   uint32_t data, match_value;
 
   dap_resp_add_byte(0); // Count
   dap_resp_add_byte(DAP_TRANSFER_INVALID);
 
-  if (!dap_select_device(dap_req_get_byte()))
-    return;
-
+  index      = dap_req_get_byte();
   req_count  = dap_req_get_byte();
   resp_count = 0;
+  total      = req_count;
+  parsed     = 0;
+
+  if (!dap_select_device(index))
+  {
+    dap_transfer_skip(-1, total);
+    return;
+  }
 
   posted_read = false;
   verify_write = false;
@@ -919,6 +1528,7 @@ static void dap_transfer(void)
   for (; req_count && !dap_abort && !dap_buf_error; req_count--, resp_count++)
   {
     request = dap_req_get_byte();
+    parsed++;
     verify_write = false;
 
     if (posted_read)
@@ -934,12 +1544,18 @@ static void dap_transfer(void)
       }
 
       if (ack != DAP_TRANSFER_OK)
+      {
+        dap_transfer_skip(request, 1);
         break;
+      }
 
       dap_resp_add_word(data);
 
       if (posted_read)
+      {
+        dap_transfer_timestamp(request);
         continue;
+      }
     }
 
     if (request & DAP_TRANSFER_RnW)
@@ -972,6 +1588,7 @@ static void dap_transfer(void)
         if (ack != DAP_TRANSFER_OK)
           break;
 
+        dap_transfer_timestamp(request);
         posted_read = true;
       }
       else
@@ -981,6 +1598,7 @@ static void dap_transfer(void)
         if (DAP_TRANSFER_OK != ack)
           break;
 
+        dap_transfer_timestamp(request);
         dap_resp_add_word(data);
       }
     }
@@ -1000,6 +1618,7 @@ static void dap_transfer(void)
         if (ack != DAP_TRANSFER_OK)
           break;
 
+        dap_transfer_timestamp(request);
         verify_write = true;
       }
     }
@@ -1018,23 +1637,34 @@ static void dap_transfer(void)
     }
   }
 
+  dap_transfer_skip(-1, total - parsed);
+
   dap_resp_set_byte(1, resp_count);
   dap_resp_set_byte(2, ack);
 }
 
+//-----------------------------------------------------------------------------
+// Skip the data of block writes that are not executed
+static void dap_transfer_block_skip(int request, int count)
+{
+  if (0 == (request & DAP_TRANSFER_RnW))
+  {
+    for (int i = 0; i < count && !dap_buf_error; i++)
+      dap_req_get_word();
+  }
+}
+
 //-----------------------------------------------------------------------------
 static void dap_transfer_block(void)
 {
-  int req_count, resp_count, request, ack;
+  int req_count, resp_count, request, ack, index;
   uint32_t data;
 
   dap_resp_add_byte(0); // Count
   dap_resp_add_byte(0); // Count
   dap_resp_add_byte(DAP_TRANSFER_INVALID);
 
-  if (!dap_select_device(dap_req_get_byte()))
-    return;
-
+  index      = dap_req_get_byte();
   req_count  = dap_req_get_half();
   resp_count = 0;
 
@@ -1044,6 +1674,12 @@ static void dap_transfer_block(void)
   request = dap_req_get_byte();
   ack = DAP_TRANSFER_INVALID;
 
+  if (!dap_select_device(index))
+  {
+    dap_transfer_block_skip(request, req_count);
+    return;
+  }
+
   if (request & DAP_TRANSFER_RnW)
   {
     bool needs_posted = dap_needs_posted_read(request);
@@ -1075,7 +1711,10 @@ static void dap_transfer_block(void)
       ack = dap_transfer_word(request, &data);
 
       if (DAP_TRANSFER_OK != ack)
+      {
+        dap_transfer_block_skip(request, req_count - i - 1);
         break;
+      }
 
       resp_count++;
     }
@@ -1140,6 +1779,7 @@ static void dap_delay(void)
 static void dap_reset_target(void)
 {
   dap_resp_add_byte(DAP_OK);
+  dap_jtag_ir_invalidate();
 
 #ifdef DAP_CONFIG_RESET_TARGET_FN
   DAP_CONFIG_RESET_TARGET_FN();
@@ -1171,6 +1811,9 @@ static void dap_swj_pins(void)
   if (select & DAP_SWJ_nRESET)
     DAP_CONFIG_nRESET_write(value & DAP_SWJ_nRESET);
 
+  if (select & (DAP_SWJ_SWCLK_TCK | DAP_SWJ_SWDIO_TMS | DAP_SWJ_nTRST))
+    dap_jtag_ir_invalidate();
+
   dap_delay_us(wait * 1000);
 
   value =
@@ -1196,12 +1839,21 @@ static void dap_swj_clock(void)
 static void dap_swj_sequence(void)
 {
   int size = dap_req_get_byte();
+  uint8_t buf[32];
 
-  while (size)
+  for (int i = 0; i < (size + 7) / 8; i++)
+    buf[i] = dap_req_get_byte();
+
+  dap_jtag_ir_invalidate();
+
+  if (!dap_wave_sequence(DAP_CONFIG_WAVE_SWDIO_TMS, buf, DAP_CONFIG_WAVE_NONE, NULL, size))
   {
-    int sz = (size > 8) ? 8 : size;
-    dap_swd_write(dap_req_get_byte(), sz);
-    size -= sz;
+    for (int i = 0; size; i++)
+    {
+      int sz = (size > 8) ? 8 : size;
+      dap_swd_write(buf[i], sz);
+      size -= sz;
+    }
   }
 
   dap_resp_add_byte(DAP_OK);
@@ -1238,6 +1890,7 @@ static void dap_swd_sequence(void)
     int info  = dap_req_get_byte();
     int count = info & SWD_SEQUENCE_COUNT;
     int din   = info & SWD_SEQUENCE_DIN;
+    uint8_t buf[8];
 
     if (count == 0)
       count = 64U;
@@ -1246,6 +1899,13 @@ static void dap_swd_sequence(void)
     {
       DAP_CONFIG_SWDIO_TMS_in();
 
+      if (dap_wave_sequence(DAP_CONFIG_WAVE_NONE, NULL, DAP_CONFIG_WAVE_SWDIO_TMS, buf, count))
+      {
+        for (int j = 0; j < (count + 7) / 8; j++)
+          dap_resp_add_byte(buf[j]);
+        continue;
+      }
+
       while (count)
       {
         int sz = (count > 8) ? 8 : count;
@@ -1258,10 +1918,16 @@ static void dap_swd_sequence(void)
     {
       DAP_CONFIG_SWDIO_TMS_out();
 
-      while (count)
+      for (int j = 0; j < (count + 7) / 8; j++)
+        buf[j] = dap_req_get_byte();
+
+      if (dap_wave_sequence(DAP_CONFIG_WAVE_SWDIO_TMS, buf, DAP_CONFIG_WAVE_NONE, NULL, count))
+        continue;
+
+      for (int j = 0; count; j++)
       {
         int sz = (count > 8) ? 8 : count;
-        dap_swd_write(dap_req_get_byte(), sz);
+        dap_swd_write(buf[j], sz);
         count -= sz;
       }
     }
@@ -1283,6 +1949,7 @@ static void dap_jtag_sequence(void)
   }
 
   dap_resp_add_byte(DAP_OK);
+  dap_jtag_ir_invalidate();
 
   req_count = dap_req_get_byte();
 
@@ -1292,24 +1959,42 @@ static void dap_jtag_sequence(void)
     int count = info & JTAG_SEQUENCE_COUNT;
     int tms   = info & JTAG_SEQUENCE_TMS;
     int tdo   = info & JTAG_SEQUENCE_TDO;
+    uint8_t tdi_buf[8] = {0}, tdo_buf[8];
 
     if (count == 0)
       count = 64;
 
     DAP_CONFIG_SWDIO_TMS_write(tms);
 
-    while (count)
+    for (int j = 0; j < (count + 7) / 8; j++)
+      tdi_buf[j] = dap_req_get_byte();
+
+    if (dap_wave_sequence(DAP_CONFIG_WAVE_TDI, tdi_buf,
+        tdo ? DAP_CONFIG_WAVE_TDO : DAP_CONFIG_WAVE_NONE, tdo_buf, count))
+    {
+      if (tdo)
+      {
+        for (int j = 0; j < (count + 7) / 8; j++)
+          dap_resp_add_byte(tdo_buf[j]);
+      }
+      continue;
+    }
+
+    for (int j = 0; count; j += 4)
     {
-      int sz = (count > 8) ? 8 : count;
+      int sz = (count > 32) ? 32 : count;
+      uint32_t value = tdi_buf[j] | (tdi_buf[j + 1] << 8) | (tdi_buf[j + 2] << 16) | ((uint32_t)tdi_buf[j + 3] << 24);
 
       if (tdo)
       {
-        int value = dap_jtag_rdwr(dap_req_get_byte(), sz);
-        dap_resp_add_byte(value);
+        value = dap_jtag_rdwr(value, sz);
+
+        for (int k = 0; k < (sz + 7) / 8; k++)
+          dap_resp_add_byte(value >> (8 * k));
       }
       else
       {
-        dap_jtag_write(dap_req_get_byte(), sz);
+        dap_jtag_write(value, sz);
       }
 
       count -= sz;
@@ -1335,6 +2020,7 @@ static void dap_jtag_configure(void)
 
   dap_jtag_dev_count = count;
   dap_jtag_dev_index = 0;
+  dap_jtag_ir_invalidate();
 
   for (int i = 0; i < dap_jtag_dev_count; i++)
   {
@@ -1367,7 +2053,11 @@ static void dap_jtag_idcode(void)
     return;
   }
 
-  dap_jtag_write_ir(JTAG_IDCODE);
+  if (dap_jtag_ir != JTAG_IDCODE)
+  {
+    dap_jtag_ir = JTAG_IDCODE;
+    dap_jtag_write_ir(JTAG_IDCODE, dap_fast_clock);
+  }
 
   DAP_CONFIG_SWDIO_TMS_write(1);
   dap_swj_run(1); // -> Select-DR-Scan
@@ -1389,6 +2079,88 @@ static void dap_jtag_idcode(void)
 #endif
 }
 
+#ifdef DAP_CONFIG_ENABLE_SWO
+//-----------------------------------------------------------------------------
+static void dap_swo_transport(void)
+{
+  int transport = dap_req_get_byte();
+
+  dap_resp_add_byte(DAP_CONFIG_SWO_TRANSPORT(transport) ? DAP_OK : DAP_ERROR);
+}
+
+//-----------------------------------------------------------------------------
+static void dap_swo_mode(void)
+{
+  int mode = dap_req_get_byte();
+
+  dap_resp_add_byte(DAP_CONFIG_SWO_MODE(mode) ? DAP_OK : DAP_ERROR);
+}
+
+//-----------------------------------------------------------------------------
+static void dap_swo_baudrate(void)
+{
+  uint32_t baudrate = dap_req_get_word();
+
+  dap_resp_add_word(DAP_CONFIG_SWO_BAUDRATE(baudrate));
+}
+
+//-----------------------------------------------------------------------------
+static void dap_swo_control(void)
+{
+  int control = dap_req_get_byte();
+
+  dap_resp_add_byte(DAP_CONFIG_SWO_CONTROL(control & 1) ? DAP_OK : DAP_ERROR);
+}
+
+//-----------------------------------------------------------------------------
+static void dap_swo_status(void)
+{
+  dap_resp_add_byte(DAP_CONFIG_SWO_STATUS());
+  dap_resp_add_word(DAP_CONFIG_SWO_COUNT());
+}
+
+//-----------------------------------------------------------------------------
+static void dap_swo_ext_status(void)
+{
+  int control = dap_req_get_byte();
+
+  if (control & 1)
+    dap_resp_add_byte(DAP_CONFIG_SWO_STATUS());
+
+  if (control & 2)
+    dap_resp_add_word(DAP_CONFIG_SWO_COUNT());
+
+  if (control & 4)
+  {
+    dap_resp_add_word(DAP_CONFIG_SWO_INDEX());
+    dap_resp_add_word(DAP_CONFIG_SWO_TIMESTAMP());
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Trace data is read straight into the response buffer
+static void dap_swo_data(void)
+{
+  int count = dap_req_get_half();
+
+  dap_resp_add_byte(DAP_CONFIG_SWO_STATUS());
+  dap_resp_add_byte(0); // Count
+  dap_resp_add_byte(0); // Count
+
+  if (dap_buf_error)
+    return;
+
+  if (count > dap_resp_size - dap_resp_ptr)
+    count = dap_resp_size - dap_resp_ptr;
+
+  count = DAP_CONFIG_SWO_READ(&dap_resp_buf[dap_resp_ptr], count);
+  dap_resp_ptr += count;
+
+  dap_resp_set_byte(2, count);
+  dap_resp_set_byte(3, count >> 8);
+}
+#endif // DAP_CONFIG_ENABLE_SWO
+
 //-----------------------------------------------------------------------------
 void dap_init(void)
 {
@@ -1400,12 +2172,18 @@ void dap_init(void)
   dap_match_retry_count = 100;
   dap_swd_turnaround    = 1;
   dap_swd_data_phase    = false;
+  dap_mem_active        = false;
+  dap_select_valid      = false;
+  dap_saved_valid       = false;
 #ifdef DAP_CONFIG_ENABLE_JTAG
   dap_jtag_dev_count = 0;
+  dap_jtag_dev_index = 0;
+  dap_jtag_ir = JTAG_INVALID;
 #endif
 
   dap_setup_clock(DAP_CONFIG_DEFAULT_CLOCK);
 
+  DAP_CONFIG_CYCLES_INIT();
   DAP_CONFIG_SETUP();
 }
 
@@ -1424,7 +2202,8 @@ bool dap_filter_request(uint8_t *req)
 }
 
 //-----------------------------------------------------------------------------
-int dap_process_request(uint8_t *req, int req_size, uint8_t *resp, int resp_size)
+// Process one command at the request pointer, and add its response
+static void dap_process_command(void)
 {
   static const struct
   {
@@ -1451,26 +2230,33 @@ int dap_process_request(uint8_t *req, int req_size, uint8_t *resp, int resp_size
     { ID_DAP_JTAG_SEQUENCE,		dap_jtag_sequence },
     { ID_DAP_JTAG_CONFIGURE,		dap_jtag_configure },
     { ID_DAP_JTAG_IDCODE,		dap_jtag_idcode },
+#ifdef DAP_CONFIG_ENABLE_SWO
+    { ID_DAP_SWO_TRANSPORT,		dap_swo_transport },
+    { ID_DAP_SWO_MODE,			dap_swo_mode },
+    { ID_DAP_SWO_BAUDRATE,		dap_swo_baudrate },
+    { ID_DAP_SWO_CONTROL,		dap_swo_control },
+    { ID_DAP_SWO_STATUS,		dap_swo_status },
+    { ID_DAP_SWO_EXT_STATUS,		dap_swo_ext_status },
+    { ID_DAP_SWO_DATA,			dap_swo_data },
+#endif
   };
   int cmd;
 
-  dap_buf_init(req, req_size, resp, resp_size);
-
-  dap_abort = false;
-
-#ifdef DAP_CONFIG_ENABLE_JTAG
-  dap_jtag_ir = JTAG_INVALID;
-#endif
+  dap_resp_base = dap_resp_ptr;
 
   cmd = dap_req_get_byte();
   dap_resp_add_byte(cmd);
 
+  // A vendor memory session ends with the first other command
+  if (cmd < ID_DAP_VENDOR_0 && ID_DAP_EXECUTE_COMMANDS != cmd)
+    dap_mem_end();
+
   for (int i = 0; i < ARRAY_SIZE(handlers); i++)
   {
     if (cmd == handlers[i].cmd)
     {
       handlers[i].handler();
-      return dap_resp_ptr;
+      return;
     }
   }
 
@@ -1481,29 +2267,793 @@ int dap_process_request(uint8_t *req, int req_size, uint8_t *resp, int resp_size
 #else
     dap_resp_add_byte(DAP_ERROR);
 #endif
-    return dap_resp_ptr;
+    return;
   }
 
   dap_resp_set_byte(0, ID_DAP_INVALID);
+}
+
+//-----------------------------------------------------------------------------
+// Several commands in one request, with the responses concatenated. The usb
+// code holds back queued requests until a request that is not queued arrives,
+// then they are processed like ExecuteCommands.
+static void dap_execute_commands(void)
+{
+  int count = dap_req_get_byte();
+
+  dap_resp_add_byte(ID_DAP_EXECUTE_COMMANDS);
+  dap_resp_add_byte(count);
+
+  for (int i = 0; i < count && !dap_buf_error; i++)
+    dap_process_command();
+}
+
+//-----------------------------------------------------------------------------
+int dap_process_request(uint8_t *req, int req_size, uint8_t *resp, int resp_size)
+{
+  dap_buf_init(req, req_size, resp, resp_size);
+
+  dap_abort = false;
+
+  if (ID_DAP_EXECUTE_COMMANDS == req[0] || ID_DAP_QUEUE_COMMANDS == req[0])
+  {
+    dap_req_get_byte();
+    dap_execute_commands();
+  }
+  else
+    dap_process_command();
 
   return dap_resp_ptr;
 }
 
 //-----------------------------------------------------------------------------
-void dap_clock_test(int delay)
+#define DAP_CLOCK_TEST_CYCLES   1000
+#define DAP_CLOCK_TEST_WORDS    32
+
+//-----------------------------------------------------------------------------
+// Run SWCLK for 'ms' milliseconds, then do SWD word transfers (DP ABORT writes
+// of 0) for another 'ms' milliseconds. 'delay' is the delay loop count, or 0 for
+// the fast clock and the selected SWD engine. Measured SWCLK frequency and words
+// per second are returned. Without a target there is no ACK, and no data phase.
+DAP_CONFIG_PERFORMANCE_ATTR
+void dap_clock_test(int delay, int ms, uint32_t *clock_hz, uint32_t *word_rate)
 {
+  int saved_delay = dap_clock_delay;
+  bool saved_fast = dap_fast_clock;
+  uint32_t start, elapsed, count;
+  uint32_t data = 0;
+
   DAP_CONFIG_CONNECT_SWD();
 
-  if (delay)
+  dap_clock_delay = delay;
+  dap_fast_clock  = (0 == delay);
+
+  count = 0;
+  start = DAP_CONFIG_MILLISECONDS();
+  do
   {
-    dap_clock_delay = delay;
+    if (dap_fast_clock)
+      dap_swj_run_fast(DAP_CLOCK_TEST_CYCLES);
+    else
+      dap_swj_run_slow(DAP_CLOCK_TEST_CYCLES);
+    count += DAP_CLOCK_TEST_CYCLES;
+  } while ((elapsed = DAP_CONFIG_MILLISECONDS() - start) < (uint32_t)ms);
+
+  *clock_hz = (uint64_t)count * 1000 / elapsed;
+
+  count = 0;
+  start = DAP_CONFIG_MILLISECONDS();
+  do
+  {
+    for (int i = 0; i < DAP_CLOCK_TEST_WORDS; i++)
+      dap_swd_operation(SWD_DP_W_ABORT, &data);
+    count += DAP_CLOCK_TEST_WORDS;
+  } while ((elapsed = DAP_CONFIG_MILLISECONDS() - start) < (uint32_t)ms);
+
+  *word_rate = (uint64_t)count * 1000 / elapsed;
+
+  dap_clock_delay = saved_delay;
+  dap_fast_clock  = saved_fast;
+
+  DAP_CONFIG_DISCONNECT();
+}
+
+//-----------------------------------------------------------------------------
+// Cycles per SWD word transfer (DP ABORT write of 0) at the fast clock and the
+// selected SWD engine: the fastest, slowest and mean of 'count' transfers. Code
+// fetched from flash stalls on cache misses, and widens the spread.
+DAP_CONFIG_PERFORMANCE_ATTR
+void dap_clock_jitter(int count, uint32_t *min, uint32_t *max, uint32_t *mean)
+{
+  bool saved_fast = dap_fast_clock;
+  uint32_t start, cycles, total = 0;
+  uint32_t data = 0;
+
+  DAP_CONFIG_CYCLES_INIT();
+  DAP_CONFIG_CONNECT_SWD();
+
+  dap_fast_clock = true;
+  *min = 0xffffffff;
+  *max = 0;
 
-    while (1)
-      dap_swj_run_slow(1<<30);
+  for (int i = 0; i < count; i++)
+  {
+    start = DAP_CONFIG_CYCLES();
+    dap_swd_operation(SWD_DP_W_ABORT, &data);
+    cycles = DAP_CONFIG_CYCLES() - start;
+
+    total += cycles;
+    if (cycles < *min)
+      *min = cycles;
+    if (cycles > *max)
+      *max = cycles;
   }
-  else
+
+  *mean = (count > 0) ? total / count : 0;
+
+  dap_fast_clock = saved_fast;
+
+  DAP_CONFIG_DISCONNECT();
+}
+
+//-----------------------------------------------------------------------------
+// Target memory access for the vendor commands, through the MEM-AP that SELECT
+// points at, bank 0. The host sets SELECT. CSW is saved and set to 32-bit
+// auto-increment. The session stays open across vendor commands; CSW and TAR
+// are restored before any other command, so the host's cached copies stay
+// valid. The functions return the DAP_Transfer ack.
+int dap_mem_begin(int index)
+{
+  int ack;
+  uint32_t data;
+
+  if (!dap_select_device(index))
+    return DAP_TRANSFER_INVALID;
+
+  if (dap_mem_active)
+    return DAP_TRANSFER_OK;
+
+  ack = dap_transfer_word(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | MEM_AP_CSW, NULL);
+
+  if (DAP_TRANSFER_OK == ack)
+    ack = dap_transfer_word(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | MEM_AP_TAR, &dap_mem_csw);
+
+  if (DAP_TRANSFER_OK == ack)
+    ack = dap_transfer_word(SWD_DP_R_RDBUFF | DAP_TRANSFER_RnW, &dap_mem_tar);
+
+  if (DAP_TRANSFER_OK == ack)
   {
-    while (1)
-      dap_swj_run_fast(1<<30);
+    data = (dap_mem_csw & ~(MEM_AP_CSW_SIZE_MASK | MEM_AP_CSW_ADDRINC_MASK)) |
+        MEM_AP_CSW_SIZE_32 | MEM_AP_CSW_ADDRINC_SINGLE;
+    ack = dap_transfer_word(DAP_TRANSFER_APnDP | MEM_AP_CSW, &data);
   }
+
+  dap_mem_active = (DAP_TRANSFER_OK == ack);
+  dap_mem_next_valid = false;
+
+  return ack;
+}
+
+//-----------------------------------------------------------------------------
+// Auto-increment stops at 1 KB boundaries, so TAR is written there, and
+// wherever it does not already hold the address.
+static int dap_mem_set_tar(uint32_t addr)
+{
+  uint32_t data = addr;
+  int ack;
+
+  if (dap_mem_next_valid && addr == dap_mem_next && (addr & 0x3ff))
+    return DAP_TRANSFER_OK;
+
+  ack = dap_transfer_word(DAP_TRANSFER_APnDP | MEM_AP_TAR, &data);
+  dap_mem_next_valid = (DAP_TRANSFER_OK == ack);
+  dap_mem_next = addr;
+
+  return ack;
+}
+
+//-----------------------------------------------------------------------------
+// Words per run: up to the next 1 KB boundary
+static int dap_mem_run(uint32_t addr, int count)
+{
+  int n = (0x400 - (addr & 0x3ff)) / 4;
+
+  return (n > count) ? count : n;
+}
+
+//-----------------------------------------------------------------------------
+// 'count' words at 'addr' to 'buf', little endian. AP reads are posted: the
+// first read of each run returns nothing, and RDBUFF has the last word.
+int dap_mem_read(uint32_t addr, uint8_t *buf, int count)
+{
+  const int req = DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | MEM_AP_DRW;
+  int ack = DAP_TRANSFER_OK;
+  uint32_t data;
+
+  while (count && DAP_TRANSFER_OK == ack && !dap_abort)
+  {
+    int n = dap_mem_run(addr, count);
+
+    ack = dap_mem_set_tar(addr);
+
+    if (DAP_TRANSFER_OK == ack)
+      ack = dap_transfer_word(req, NULL);
+
+    for (int i = 0; DAP_TRANSFER_OK == ack && i < n; i++)
+    {
+      ack = dap_transfer_word((i == n - 1) ? (SWD_DP_R_RDBUFF | DAP_TRANSFER_RnW) : req, &data);
+
+      buf[4 * i + 0] = data;
+      buf[4 * i + 1] = data >> 8;
+      buf[4 * i + 2] = data >> 16;
+      buf[4 * i + 3] = data >> 24;
+    }
+
+    addr += 4 * n;
+    buf += 4 * n;
+    count -= n;
+    dap_mem_next = addr;
+  }
+
+  if (DAP_TRANSFER_OK == ack && dap_abort)
+    ack = DAP_TRANSFER_INVALID;
+
+  if (DAP_TRANSFER_OK != ack)
+    dap_mem_next_valid = false;
+
+  return ack;
+}
+
+//-----------------------------------------------------------------------------
+// 'count' words from 'buf', little endian, to 'addr'. RDBUFF is read at the
+// end, so the last write has completed when this returns OK.
+int dap_mem_write(uint32_t addr, uint8_t *buf, int count)
+{
+  const int req = DAP_TRANSFER_APnDP | MEM_AP_DRW;
+  int ack = DAP_TRANSFER_OK;
+  uint32_t data;
+
+  while (count && DAP_TRANSFER_OK == ack && !dap_abort)
+  {
+    int n = dap_mem_run(addr, count);
+
+    ack = dap_mem_set_tar(addr);
+
+    for (int i = 0; DAP_TRANSFER_OK == ack && i < n; i++)
+    {
+      data = buf[4 * i] | (buf[4 * i + 1] << 8) | (buf[4 * i + 2] << 16) | ((uint32_t)buf[4 * i + 3] << 24);
+      ack = dap_transfer_word(req, &data);
+    }
+
+    addr += 4 * n;
+    buf += 4 * n;
+    count -= n;
+    dap_mem_next = addr;
+  }
+
+  if (DAP_TRANSFER_OK == ack)
+    ack = dap_transfer_word(SWD_DP_R_RDBUFF | DAP_TRANSFER_RnW, NULL);
+
+  if (DAP_TRANSFER_OK == ack && dap_abort)
+    ack = DAP_TRANSFER_INVALID;
+
+  if (DAP_TRANSFER_OK != ack)
+    dap_mem_next_valid = false;
+
+  return ack;
+}
+
+//-----------------------------------------------------------------------------
+int dap_mem_end(void)
+{
+  int ack;
+
+  if (!dap_mem_active)
+    return DAP_TRANSFER_OK;
+
+  dap_mem_active = false;
+
+  ack = dap_transfer_word(DAP_TRANSFER_APnDP | MEM_AP_CSW, &dap_mem_csw);
+
+  if (DAP_TRANSFER_OK == ack)
+    ack = dap_transfer_word(DAP_TRANSFER_APnDP | MEM_AP_TAR, &dap_mem_tar);
+
+  if (DAP_TRANSFER_OK == ack)
+    ack = dap_transfer_word(SWD_DP_R_RDBUFF | DAP_TRANSFER_RnW, NULL);
+
+  return ack;
+}
+
+//-----------------------------------------------------------------------------
+// Another debugger is about to use the pins between two requests. The host
+// caches SELECT, CSW and TAR, so those of the MEM-AP it last selected are saved
+// here, and dap_resume() puts them back. SELECT is write-only, and is the one
+// the host last wrote. Returns the DAP_Transfer ack.
+int dap_suspend(void)
+{
+  uint32_t data;
+  int ack;
+
+  dap_saved_valid = false;
+
+  if (DAP_PORT_DISABLED == dap_port)
+    return DAP_TRANSFER_OK;
+
+  ack = dap_mem_end();
+
+  if (DAP_TRANSFER_OK != ack || !dap_select_valid)
+    return ack;
+
+  data = dap_select & ~0xf0u; // bank 0
+  ack = dap_transfer_word(SWD_DP_W_SELECT, &data);
+
+  if (DAP_TRANSFER_OK == ack)
+    ack = dap_transfer_word(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | MEM_AP_CSW, NULL);
+
+  if (DAP_TRANSFER_OK == ack)
+    ack = dap_transfer_word(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | MEM_AP_TAR, &dap_saved_csw);
+
+  if (DAP_TRANSFER_OK == ack)
+    ack = dap_transfer_word(SWD_DP_R_RDBUFF | DAP_TRANSFER_RnW, &dap_saved_tar);
+
+  dap_saved_valid = (DAP_TRANSFER_OK == ack);
+
+  return ack;
+}
+
+//-----------------------------------------------------------------------------
+// The pins are back from the other debugger. They are set up for the port
+// again, and the state saved by dap_suspend() is written back. The other
+// debugger must leave the line idle, in the same protocol.
+int dap_resume(void)
+{
+  uint32_t data;
+  int ack = DAP_TRANSFER_OK;
+
+  dap_jtag_ir_invalidate();
+
+  if (DAP_PORT_SWD == dap_port)
+    DAP_CONFIG_CONNECT_SWD();
+
+#ifdef DAP_CONFIG_ENABLE_JTAG
+  else if (DAP_PORT_JTAG == dap_port)
+    DAP_CONFIG_CONNECT_JTAG();
+#endif
+
+  if (!dap_saved_valid)
+    return ack;
+
+  dap_saved_valid = false;
+
+  data = dap_select & ~0xf0u;
+  ack = dap_transfer_word(SWD_DP_W_SELECT, &data);
+
+  if (DAP_TRANSFER_OK == ack)
+    ack = dap_transfer_word(DAP_TRANSFER_APnDP | MEM_AP_CSW, &dap_saved_csw);
+
+  if (DAP_TRANSFER_OK == ack)
+    ack = dap_transfer_word(DAP_TRANSFER_APnDP | MEM_AP_TAR, &dap_saved_tar);
+
+  if (DAP_TRANSFER_OK == ack)
+    ack = dap_transfer_word(SWD_DP_W_SELECT, &dap_select);
+
+  if (DAP_TRANSFER_OK == ack)
+    ack = dap_transfer_word(SWD_DP_R_RDBUFF | DAP_TRANSFER_RnW, NULL);
+
+  return ack;
+}
+
+//-----------------------------------------------------------------------------
+// The other debugger may send its own requests through dap_process_request(),
+// for instance to identify the target. DAP_Connect and DAP_Disconnect there
+// would end the host's session: the port, SELECT and the statistics are lost.
+// dap_session_save(), after dap_suspend(), keeps them, and dap_session_restore()
+// puts them back before the pins return to the host with dap_resume().
+void dap_session_save(void)
+{
+  dap_session.port              = dap_port;
+  dap_session.select_valid      = dap_select_valid;
+  dap_session.select            = dap_select;
+  dap_session.idle_cycles       = dap_idle_cycles;
+  dap_session.retry_count       = dap_retry_count;
+  dap_session.match_retry_count = dap_match_retry_count;
+  dap_session.stats             = dap_stats;
+}
+
+//-----------------------------------------------------------------------------
+void dap_session_restore(void)
+{
+  dap_port              = dap_session.port;
+  dap_select_valid      = dap_session.select_valid;
+  dap_select            = dap_session.select;
+  dap_idle_cycles       = dap_session.idle_cycles;
+  dap_retry_count       = dap_session.retry_count;
+  dap_match_retry_count = dap_session.match_retry_count;
+  dap_stats             = dap_session.stats;
+}
+
+//-----------------------------------------------------------------------------
+// Probe the target outside a host request: connect SWD, line reset, JTAG to
+// SWD, line reset, idle cycles and DP IDCODE. If the DP answers, the sticky
+// errors are cleared and the debug domain is powered up, with SELECT at AP 0,
+// bank 0. The host's session and clock are saved first, and dap_probe_end()
+// puts them back, also after dap_clock_tune().
+// If the pins have not been handed over with dap_suspend(), that is done here,
+// and dap_probe_end() resumes. Returns the DAP_Transfer ack.
+int dap_probe_begin(uint32_t *idcode)
+{
+  uint32_t data;
+  int ack;
+
+  dap_probe_suspended = !dap_saved_valid;
+
+  if (dap_probe_suspended)
+    dap_suspend();
+
+  dap_session_save();
+  dap_probe_clock = dap_clock_freq;
+
+  dap_port = DAP_PORT_SWD;
+  dap_select_valid = false;
+  dap_jtag_ir_invalidate();
+  DAP_CONFIG_CONNECT_SWD();
+
+  DAP_CONFIG_SWDIO_TMS_out();
+  DAP_CONFIG_SWDIO_TMS_write(1);
+  dap_swj_run(51);
+  dap_swd_write(0xe79e, 16);
+  DAP_CONFIG_SWDIO_TMS_write(1);
+  dap_swj_run(51);
+  DAP_CONFIG_SWDIO_TMS_write(0);
+  dap_swj_run(8);
+
+  ack = dap_transfer_word(SWD_DP_R_IDCODE | DAP_TRANSFER_RnW, idcode);
+
+  if (DAP_TRANSFER_OK != ack)
+    *idcode = 0;
+
+  data = 0x1e; // STKCMPCLR, STKERRCLR, WDERRCLR, ORUNERRCLR
+  if (DAP_TRANSFER_OK == ack)
+    ack = dap_transfer_word(SWD_DP_W_ABORT, &data);
+
+  data = 0x50000000; // CSYSPWRUPREQ, CDBGPWRUPREQ
+  if (DAP_TRANSFER_OK == ack)
+    ack = dap_transfer_word(SWD_DP_W_CTRL_STAT, &data);
+
+  data = 0;
+  if (DAP_TRANSFER_OK == ack)
+    ack = dap_transfer_word(SWD_DP_W_SELECT, &data);
+
+  return ack;
+}
+
+//-----------------------------------------------------------------------------
+// One DP or AP register access of a probe. 'request' has the bits of a
+// DAP_Transfer request. The value of an AP read comes from RDBUFF.
+int dap_probe_transfer(int request, uint32_t *data)
+{
+  int ack = dap_transfer_word(request, data);
+
+  if (DAP_TRANSFER_OK == ack && dap_needs_posted_read(request))
+    ack = dap_transfer_word(SWD_DP_R_RDBUFF | DAP_TRANSFER_RnW, data);
+
+  return ack;
+}
+
+//-----------------------------------------------------------------------------
+void dap_probe_end(void)
+{
+  DAP_CONFIG_DISCONNECT();
+  dap_jtag_ir_invalidate();
+
+  dap_session_restore();
+
+  if (dap_clock_freq != dap_probe_clock)
+    dap_setup_clock(dap_probe_clock);
+
+  if (dap_probe_suspended)
+    dap_resume();
+}
+
+//-----------------------------------------------------------------------------
+// Select the SWD engine used at the fast clock. Lower clocks always use the bit engine.
+void dap_swd_set_engine(int engine)
+{
+  dap_swd_engine = engine;
+  dap_setup_swd_engine();
+}
+
+//-----------------------------------------------------------------------------
+int dap_swd_get_engine(void)
+{
+  return dap_swd_engine;
+}
+
+//-----------------------------------------------------------------------------
+void dap_swd_verify_stats(uint32_t *checks, uint32_t *errors, bool clear)
+{
+  *checks = dap_swd_verify_checks;
+  *errors = dap_swd_verify_errors;
+
+  if (clear)
+  {
+    dap_swd_verify_checks = 0;
+    dap_swd_verify_errors = 0;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void dap_get_stats(struct dap_stats *stats, bool clear)
+{
+  *stats = dap_stats;
+
+  if (clear)
+    memset(&dap_stats, 0, sizeof(dap_stats));
+}
+
+//-----------------------------------------------------------------------------
+// The budget is counted in cpu cycles, and the cycle counter wraps after
+// 2^32 cycles (19.8 s at 216 MHz). Longer budgets are cut to half of that.
+void dap_set_wait_budget(uint32_t us)
+{
+  uint32_t max = UINT32_MAX / (DAP_CONFIG_CPU_HZ / 1000000) / 2;
+
+  dap_wait_budget_us = (us > max) ? max : us;
+}
+
+//-----------------------------------------------------------------------------
+uint32_t dap_get_wait_budget(void)
+{
+  return dap_wait_budget_us;
+}
+
+//-----------------------------------------------------------------------------
+#define DAP_CAL_CLOCKS    64
+#define DAP_CAL_RUNS      8
+#define DAP_CAL_DELAY1    8
+#define DAP_CAL_DELAY2    136
+
+//-----------------------------------------------------------------------------
+// Cpu cycles for DAP_CAL_CLOCKS clock cycles, fastest of DAP_CAL_RUNS runs.
+// Interrupts only make a run slower.
+static uint32_t dap_cal_measure(int delay)
+{
+  uint32_t best = UINT32_MAX;
+  int saved_delay = dap_clock_delay;
+
+  dap_clock_delay = delay;
+
+  for (int i = 0; i < DAP_CAL_RUNS; i++)
+  {
+    uint32_t start = DAP_CONFIG_CYCLES();
+
+    if (delay < 0)
+      dap_swj_run_fast(DAP_CAL_CLOCKS);
+    else
+      dap_swj_run_slow(DAP_CAL_CLOCKS);
+
+    uint32_t cycles = DAP_CONFIG_CYCLES() - start;
+
+    if (cycles < best)
+      best = cycles;
+  }
+
+  dap_clock_delay = saved_delay;
+
+  return best;
+}
+
+//-----------------------------------------------------------------------------
+// Time the fast and slow clock loops against the cpu cycle counter. The slow
+// loop is linear in the delay count: cycles = base + step * delay.
+void dap_clock_calibrate(void)
+{
+  uint32_t fast, slow1, slow2;
+
+  DAP_CONFIG_CYCLES_INIT();
+
+  fast  = dap_cal_measure(-1);
+  slow1 = dap_cal_measure(DAP_CAL_DELAY1);
+  slow2 = dap_cal_measure(DAP_CAL_DELAY2);
+
+  if (0 == fast || slow2 <= slow1)
+    return;
+
+  // per clock cycle, step in 1/256 cycles
+  dap_cal_fast = fast / DAP_CAL_CLOCKS;
+  dap_cal_step = ((uint64_t)(slow2 - slow1) * 256) / ((DAP_CAL_DELAY2 - DAP_CAL_DELAY1) * DAP_CAL_CLOCKS);
+  dap_cal_base = (slow1 - (uint64_t)dap_cal_step * DAP_CAL_DELAY1 * DAP_CAL_CLOCKS / 256) / DAP_CAL_CLOCKS;
+  dap_cal_valid = (dap_cal_step > 0);
+
+  if (dap_clock_freq)
+    dap_setup_clock(dap_clock_freq);
+}
+
+//-----------------------------------------------------------------------------
+// Clock frequency expected from the calibration for a requested frequency,
+// and the delay loop count used (-1: fast clock).
+int dap_clock_achieved(int freq, int *delay)
+{
+  uint64_t cycles;
+
+  *delay = dap_clock_delay_for(freq);
+
+  if (!dap_cal_valid)
+    return 0;
+
+  if (*delay < 0)
+    cycles = (uint64_t)dap_cal_fast * 256;
+  else
+    cycles = (uint64_t)dap_cal_base * 256 + (uint64_t)dap_cal_step * *delay;
+
+  return ((uint64_t)DAP_CONFIG_CPU_HZ * 256) / cycles;
+}
+
+//-----------------------------------------------------------------------------
+// Clock frequency measured with the cycle counter, for a requested frequency.
+int dap_clock_measure(int freq)
+{
+  int delay = dap_clock_delay_for(freq);
+  uint32_t cycles;
+
+  DAP_CONFIG_CYCLES_INIT();
+
+  cycles = dap_cal_measure(delay);
+
+  return ((uint64_t)DAP_CONFIG_CPU_HZ * DAP_CAL_CLOCKS) / cycles;
+}
+
+//-----------------------------------------------------------------------------
+int dap_clock_get(void)
+{
+  return dap_clock_freq;
+}
+
+//-----------------------------------------------------------------------------
+// SWCLK auto-tune. The clock steps up through dap_tune_freq while DP IDCODE,
+// and the word at 'addr' if it is not 0, read back DAP_TUNE_READS times with
+// no error and the values of the first step. It stops at the first step that
+// fails, or that is no faster than the step before. After a failure the clock
+// is set to DAP_TUNE_MARGIN percent of the fastest step that passed. The
+// memory reads need the debug domain powered up, and go through the MEM-AP
+// in SELECT.
+#define DAP_TUNE_READS    64
+#define DAP_TUNE_MARGIN   75
+
+static const int dap_tune_freq[] =
+{
+  100000, 250000, 500000, 1000000, 2000000, 3000000, 4000000, 6000000,
+  8000000, 10000000, 12000000, 16000000, 20000000, 25000000, 30000000,
+};
+
+//-----------------------------------------------------------------------------
+// Line reset, IDCODE, and clear the sticky errors that a failed step left.
+// After a transfer without ack SWDIO is still an input, as SWJ_Sequence expects.
+static int dap_tune_reset(uint32_t *idcode)
+{
+  uint32_t data = 0x1e; // STKCMPCLR, STKERRCLR, WDERRCLR, ORUNERRCLR
+  int ack;
+
+  DAP_CONFIG_SWDIO_TMS_out();
+  DAP_CONFIG_SWDIO_TMS_write(1);
+  dap_swj_run(51);
+  DAP_CONFIG_SWDIO_TMS_write(0);
+  dap_swj_run(2);
+  DAP_CONFIG_SWDIO_TMS_write(1);
+
+  ack = dap_transfer_word(SWD_DP_R_IDCODE | DAP_TRANSFER_RnW, idcode);
+
+  if (DAP_TRANSFER_OK == ack)
+    ack = dap_transfer_word(SWD_DP_W_ABORT, &data);
+
+  return ack;
+}
+
+//-----------------------------------------------------------------------------
+static bool dap_tune_step(uint32_t addr, uint32_t idcode, uint32_t word)
+{
+  uint32_t data;
+  uint8_t buf[4];
+
+  if (DAP_TRANSFER_OK != dap_tune_reset(&data) || data != idcode)
+    return false;
+
+  for (int i = 0; i < DAP_TUNE_READS && !dap_abort; i++)
+  {
+    if (DAP_TRANSFER_OK != dap_transfer_word(SWD_DP_R_IDCODE | DAP_TRANSFER_RnW, &data) || data != idcode)
+      return false;
+
+    if (addr && (DAP_TRANSFER_OK != dap_mem_read(addr, buf, 1) ||
+        word != (buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24))))
+      return false;
+  }
+
+  return !dap_abort;
+}
+
+//-----------------------------------------------------------------------------
+// Unless 'retune' is set, a frequency cached for the IDCODE is used instead.
+// Returns the DAP_Transfer ack of the first step.
+int dap_clock_tune(uint32_t addr, bool retune, struct dap_tune *tune)
+{
+  uint32_t word = 0;
+  uint8_t buf[4] = {0};
+  int ack, delay, prev_delay = 0;
+
+  memset(tune, 0, sizeof(*tune));
+
+  if (DAP_PORT_SWD != dap_port)
+    return DAP_TRANSFER_INVALID;
+
+  dap_setup_clock(dap_tune_freq[0]);
+
+  ack = dap_tune_reset(&tune->idcode);
+
+  if (DAP_TRANSFER_OK == ack && addr)
+  {
+    ack = dap_mem_begin(0);
+
+    if (DAP_TRANSFER_OK == ack)
+      ack = dap_mem_read(addr, buf, 1);
+
+    word = buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+  }
+
+  if (DAP_TRANSFER_OK != ack)
+  {
+    dap_mem_end();
+    return ack;
+  }
+
+#ifdef DAP_CONFIG_TUNE_LOOKUP
+  if (!retune && (tune->freq = DAP_CONFIG_TUNE_LOOKUP(tune->idcode)))
+  {
+    tune->cached = true;
+    tune->fastest = tune->freq;
+  }
+#else
+  (void)retune;
+#endif
+
+  for (int i = 0; i < ARRAY_SIZE(dap_tune_freq) && !tune->cached; i++)
+  {
+    delay = dap_clock_delay_for(dap_tune_freq[i]);
+
+    if (i > 0 && delay >= 0 && delay == prev_delay)
+      continue;
+
+    dap_setup_clock(dap_tune_freq[i]);
+
+    if (!dap_tune_step(addr, tune->idcode, word))
+    {
+      tune->failed = dap_tune_freq[i];
+      break;
+    }
+
+    tune->fastest = dap_tune_freq[i];
+
+    if (delay < 0)
+      break;
+
+    prev_delay = delay;
+  }
+
+  if (!tune->cached)
+  {
+    tune->freq = tune->failed ? (int)((int64_t)tune->fastest * DAP_TUNE_MARGIN / 100) : tune->fastest;
+
+    if (tune->freq < dap_tune_freq[0])
+      tune->freq = dap_tune_freq[0];
+
+#ifdef DAP_CONFIG_TUNE_STORE
+    if (tune->fastest)
+      DAP_CONFIG_TUNE_STORE(tune->idcode, tune->freq);
+#endif
+  }
+
+  dap_setup_clock(tune->freq);
+  ack = dap_tune_reset(&word);
+  dap_mem_end();
+
+  return ack;
 }
@@ -33,6 +33,36 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+/*- Definitions -------------------------------------------------------------*/
+enum
+{
+  DAP_SWD_ENGINE_BIT    = 0, // bit loop
+  DAP_SWD_ENGINE_WORD   = 1, // unrolled word shifts
+  DAP_SWD_ENGINE_VERIFY = 2, // word shifts, cross-checked against the bit loop
+};
+
+// Transfer errors since DAP_Connect
+struct dap_stats
+{
+  uint32_t wait;        // WAIT acks
+  uint32_t retries;     // transfers repeated after WAIT
+  uint32_t timeouts;    // transfers still WAIT after the retry count and the time budget
+  uint32_t fault;       // FAULT acks
+  uint32_t parity;      // read data with a parity error
+  uint32_t no_ack;      // no target, or a protocol error
+  uint32_t max_wait_us; // longest time a transfer was retried
+};
+
+// Result of dap_clock_tune()
+struct dap_tune
+{
+  uint32_t idcode;  // DP IDCODE
+  int freq;         // clock set, in Hz
+  int fastest;      // fastest step that passed
+  int failed;       // step that failed, 0 if none did
+  bool cached;      // freq was cached for the IDCODE, and no steps were run
+};
+
 /*- Prototypes --------------------------------------------------------------*/
 void dap_init(void);
 uint8_t dap_req_get_byte(void);
@@ -42,9 +72,38 @@ void dap_resp_add_byte(uint8_t value);
 void dap_resp_add_word(uint32_t value);
 void dap_resp_set_byte(int index, uint8_t value);
 bool dap_is_buf_error(void);
+int dap_req_space(void);
+uint8_t *dap_req_get_data(int size);
+int dap_resp_space(void);
+uint8_t *dap_resp_add_data(int size);
+void dap_resp_trim(int size);
 bool dap_filter_request(uint8_t *req);
 int dap_process_request(uint8_t *req, int req_size, uint8_t *resp, int resp_size);
-void dap_clock_test(int delay);
+void dap_clock_test(int delay, int ms, uint32_t *clock_hz, uint32_t *word_rate);
+void dap_clock_jitter(int count, uint32_t *min, uint32_t *max, uint32_t *mean);
+void dap_clock_calibrate(void);
+int dap_clock_achieved(int freq, int *delay);
+int dap_clock_measure(int freq);
+int dap_clock_get(void);
+int dap_clock_tune(uint32_t addr, bool retune, struct dap_tune *tune);
+void dap_swd_set_engine(int engine);
+int dap_swd_get_engine(void);
+void dap_swd_verify_stats(uint32_t *checks, uint32_t *errors, bool clear);
+void dap_get_stats(struct dap_stats *stats, bool clear);
+void dap_set_wait_budget(uint32_t us);
+uint32_t dap_get_wait_budget(void);
+int dap_mem_begin(int index);
+int dap_mem_read(uint32_t addr, uint8_t *buf, int count);
+int dap_mem_write(uint32_t addr, uint8_t *buf, int count);
+int dap_mem_end(void);
+int dap_suspend(void);
+int dap_resume(void);
+void dap_session_save(void);
+void dap_session_restore(void);
+int dap_probe_begin(uint32_t *idcode);
+int dap_probe_transfer(int request, uint32_t *data);
+void dap_probe_end(void);
+void dap_vendor_command(int index);
 
 #endif // _DAP_H_
 
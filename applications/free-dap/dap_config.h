@@ -5,12 +5,19 @@
 #define _DAP_CONFIG_H_
 
 #define DAP_CONFIG_ENABLE_JTAG 1
+#define DAP_CONFIG_ENABLE_SWO 1
+#define DAP_CONFIG_ENABLE_TIMESTAMP 1
 
 /*- Includes ----------------------------------------------------------------*/
 #include "hal_config.h"
 /* for CONFIG_USB_HS */
 #include "usb_desc.h"
 #include "usb_serial_number.h"
+#include "gpio_wave.h"
+#include "swo_capture.h"
+#include "timestamp.h"
+#include "swd_tune.h"
+#include <board.h>
 
 #ifdef PKG_USING_BLACKMAGIC
 extern void platform_init(void);
@@ -25,10 +32,19 @@ extern void platform_init(void);
 #else
 #define DAP_CONFIG_PACKET_SIZE         64
 #endif
-#define DAP_CONFIG_PACKET_COUNT        2
+// Slots in the request/response ring of usb_dap.c
+#define DAP_CONFIG_PACKET_COUNT        4
 
 #define DAP_CONFIG_JTAG_DEV_COUNT      8
 
+// WAIT is retried for at least this long, and at least the retry count of
+// DAP_TransferConfigure. Set with swd_stats.
+#define DAP_CONFIG_WAIT_BUDGET_US      20000
+
+// SWCLK auto-tune results, cached per DP IDCODE in eeprom
+#define DAP_CONFIG_TUNE_LOOKUP(idcode)       swd_tune_lookup(idcode)
+#define DAP_CONFIG_TUNE_STORE(idcode, freq)  swd_tune_store(idcode, freq)
+
 // DAP_CONFIG_PRODUCT_STR must contain "CMSIS-DAP" to be compatible with the standard
 #define DAP_CONFIG_VENDOR_STR          "Alex Taradov"
 #define DAP_CONFIG_PRODUCT_STR         "Generic CMSIS-DAP Adapter"
@@ -36,16 +52,21 @@ extern void platform_init(void);
 #define DAP_CONFIG_CMSIS_DAP_VER_STR   "2.0.0"
 
 //#define DAP_CONFIG_RESET_TARGET_FN     target_specific_reset_function
-//#define DAP_CONFIG_VENDOR_FN           vendor_command_handler_function
+// Memory CRC and compare, see dap_vendor.c
+#define DAP_CONFIG_VENDOR_FN           dap_vendor_command
 
 // Attribute to use for performance-critical functions
-#define DAP_CONFIG_PERFORMANCE_ATTR
+// The project is built -O0 for debugging; the bit engine is always optimized,
+// and runs from sram, so swclk does not stall on qspi flash cache misses
+#define DAP_CONFIG_PERFORMANCE_ATTR    __attribute__((optimize("O2"))) AT32_RAMFUNC
 
 // A value at which dap_clock_test() produces 1 kHz output on the SWCLK pin
+// Only used until dap_clock_calibrate() has run
 #define DAP_CONFIG_DELAY_CONSTANT      14300
 
 // A threshold for switching to fast clock (no added delays)
 // This is the frequency produced by dap_clock_test(1) on the SWCLK pin
+// Only used until dap_clock_calibrate() has run
 #define DAP_CONFIG_FAST_CLOCK          910000
 
 /*- Prototypes --------------------------------------------------------------*/
@@ -53,19 +74,38 @@ extern void platform_init(void);
 /*- Implementations ---------------------------------------------------------*/
 
 //-----------------------------------------------------------------------------
-static inline void DAP_CONFIG_SWCLK_TCK_write(int value)
+__attribute__((always_inline)) static inline void DAP_CONFIG_SWCLK_TCK_write(int value)
 {
   HAL_GPIO_SWCLK_TCK_write(value);
 }
 
 //-----------------------------------------------------------------------------
-static inline void DAP_CONFIG_SWDIO_TMS_write(int value)
+__attribute__((always_inline)) static inline void DAP_CONFIG_SWDIO_TMS_write(int value)
 {
   HAL_GPIO_SWDIO_TMS_write(value);
 }
 
 //-----------------------------------------------------------------------------
-static inline void DAP_CONFIG_TDI_write(int value)
+// SWCLK low and new SWDIO value, in one gpio write if the pins share a port
+__attribute__((always_inline)) static inline void DAP_CONFIG_SWCLK_TCK_clr_SWDIO_TMS_write(int value)
+{
+  HAL_GPIO_SWCLK_TCK_clr_SWDIO_TMS_write(value);
+}
+
+//-----------------------------------------------------------------------------
+// TCK low and new TDI value, in one gpio write if the pins share a port
+__attribute__((always_inline)) static inline void DAP_CONFIG_SWCLK_TCK_clr_TDI_write(int value)
+{
+#ifdef DAP_CONFIG_ENABLE_JTAG
+  HAL_GPIO_SWCLK_TCK_clr_TDI_write(value);
+#else
+  HAL_GPIO_SWCLK_TCK_clr();
+  (void)value;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+__attribute__((always_inline)) static inline void DAP_CONFIG_TDI_write(int value)
 {
 #ifdef DAP_CONFIG_ENABLE_JTAG
   HAL_GPIO_TDI_write(value);
@@ -103,13 +143,13 @@ static inline int DAP_CONFIG_SWCLK_TCK_read(void)
 }
 
 //-----------------------------------------------------------------------------
-static inline int DAP_CONFIG_SWDIO_TMS_read(void)
+__attribute__((always_inline)) static inline int DAP_CONFIG_SWDIO_TMS_read(void)
 {
   return HAL_GPIO_SWDIO_TMS_read();
 }
 
 //-----------------------------------------------------------------------------
-static inline int DAP_CONFIG_TDO_read(void)
+__attribute__((always_inline)) static inline int DAP_CONFIG_TDO_read(void)
 {
 #ifdef DAP_CONFIG_ENABLE_JTAG
   return HAL_GPIO_TDO_read();
@@ -141,13 +181,13 @@ static inline int DAP_CONFIG_nRESET_read(void)
 }
 
 //-----------------------------------------------------------------------------
-static inline void DAP_CONFIG_SWCLK_TCK_set(void)
+__attribute__((always_inline)) static inline void DAP_CONFIG_SWCLK_TCK_set(void)
 {
   HAL_GPIO_SWCLK_TCK_set();
 }
 
 //-----------------------------------------------------------------------------
-static inline void DAP_CONFIG_SWCLK_TCK_clr(void)
+__attribute__((always_inline)) static inline void DAP_CONFIG_SWCLK_TCK_clr(void)
 {
   HAL_GPIO_SWCLK_TCK_clr();
 }
@@ -248,6 +288,72 @@ static inline void DAP_CONFIG_LED(int index, int state)
 #endif
 }
 
+//-----------------------------------------------------------------------------
+// Clock long sequences out and in with timer-triggered dma, see gpio_wave.h.
+// Returns false if the sequence has to be clocked by the cpu.
+#define DAP_CONFIG_WAVE_NONE           (-1)
+#define DAP_CONFIG_WAVE_MIN_BITS       16
+#ifdef USE_SLOW_GPIO
+#define DAP_CONFIG_WAVE_SWDIO_TMS      0
+#define DAP_CONFIG_WAVE_TDI            0
+#define DAP_CONFIG_WAVE_TDO            0
+#else
+#define DAP_CONFIG_WAVE_SWDIO_TMS      SWDIO_BIT
+#define DAP_CONFIG_WAVE_TDI            TDI_BIT
+#define DAP_CONFIG_WAVE_TDO            TDO_BIT
+#endif
+
+static inline bool DAP_CONFIG_WAVE(int out_pin, uint8_t *out, int in_pin, uint8_t *in, int bits, int freq)
+{
+#ifdef USE_SLOW_GPIO
+  (void)out_pin; (void)out; (void)in_pin; (void)in; (void)bits; (void)freq;
+  return false;
+#else
+  return RT_EOK == gpio_wave_run(out_pin, out, in_pin, in, bits, freq);
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// SWO trace, received by the serial2 uart. See swo_capture.h
+#define DAP_CONFIG_SWO_BUF_SIZE                SWO_CAPTURE_BUF_SIZE
+#define DAP_CONFIG_SWO_TRANSPORT(transport)    swo_capture_transport(transport)
+#define DAP_CONFIG_SWO_MODE(mode)              swo_capture_mode(mode)
+#define DAP_CONFIG_SWO_BAUDRATE(baudrate)      swo_capture_baudrate(baudrate)
+#define DAP_CONFIG_SWO_CONTROL(start)          swo_capture_control(start)
+#define DAP_CONFIG_SWO_STATUS()                swo_capture_status()
+#define DAP_CONFIG_SWO_COUNT()                 swo_capture_count()
+#define DAP_CONFIG_SWO_INDEX()                 swo_capture_index()
+#define DAP_CONFIG_SWO_TIMESTAMP()             swo_capture_timestamp()
+#define DAP_CONFIG_SWO_READ(buf, len)          swo_capture_read(buf, len)
+
+//-----------------------------------------------------------------------------
+// Transfer timestamps. The SWO trace and SLCAN use the same timer
+#define DAP_CONFIG_TIMESTAMP_CLOCK             TIMESTAMP_FREQ
+#define DAP_CONFIG_TIMESTAMP()                 timestamp_get()
+
+//-----------------------------------------------------------------------------
+// DWT cycle counter, for clock calibration
+extern unsigned int system_core_clock;
+#define DAP_CONFIG_CPU_HZ              system_core_clock
+
+static inline void DAP_CONFIG_CYCLES_INIT(void)
+{
+  *(volatile uint32_t *)0xe000edfc |= (1 << 24); // DEMCR.TRCENA
+  *(volatile uint32_t *)0xe0001000 |= (1 << 0);  // DWT_CTRL.CYCCNTENA
+}
+
+static inline uint32_t DAP_CONFIG_CYCLES(void)
+{
+  return *(volatile uint32_t *)0xe0001004;      // DWT_CYCCNT
+}
+
+//-----------------------------------------------------------------------------
+// Millisecond time, for dap_clock_test()
+static inline uint32_t DAP_CONFIG_MILLISECONDS(void)
+{
+  return rt_tick_get() * 1000 / RT_TICK_PER_SECOND;
+}
+
 //-----------------------------------------------------------------------------
 __attribute__((always_inline)) static inline void DAP_CONFIG_DELAY(uint32_t cycles)
 {
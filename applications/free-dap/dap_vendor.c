@@ -0,0 +1,330 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "dap.h"
+
+/* cmsis-dap vendor commands: crc32 of target memory, computed on the probe,
+   bulk memory reads and writes, transfer error counts and swclk auto-tune.
+   verifying a flashed image sends checksums over usb, not the image.
+
+   DAP_Vendor0 (0x80) memory crc32
+     request:  index, address (word), size in bytes (word)
+     response: ack, crc32 (word)
+
+   DAP_Vendor1 (0x81) compare sectors against crcs from the host
+     request:  index, address (word), sector size in bytes (word), count (byte), count crc32s (words)
+     response: ack, sectors checked, sectors that differ, first sector that differs (0xff for none),
+               bitmap of the sectors that differ, (count + 7) / 8 bytes
+
+   DAP_Vendor2 (0x82) memory read
+     request:  index, address (word), count of words (half)
+     response: ack, words read (half), data
+   DAP_Vendor3 (0x83) memory read, continued after the last word read or written
+     request:  count of words (half)
+     response: as DAP_Vendor2
+
+   DAP_Vendor4 (0x84) memory write
+     request:  index, address (word), count of words (half), data
+     response: ack, words written (half)
+   DAP_Vendor5 (0x85) memory write, continued after the last word read or written
+     request:  count of words (half), data
+     response: as DAP_Vendor4
+
+   DAP_Vendor6 (0x86) transfer error counts since DAP_Connect, and the WAIT time budget
+     request:  clear the counts (byte), new budget in us (word, 0 keeps the budget)
+     response: ack, WAIT acks, retries, timeouts, FAULT acks, parity errors, no ack,
+               longest retry in us, budget in us (words)
+
+   DAP_Vendor7 (0x87) swclk auto-tune, see dap_clock_tune(). leaves the clock set
+     request:  retune, ignoring a cached frequency (byte), address of a word to read back,
+               0 for none (word)
+     response: ack, DP IDCODE, swclk in Hz, fastest step that passed, step that failed
+               or 0 (words), frequency was cached (byte)
+
+   a read returns as many words as fit in the response; the host asks for the rest with
+   DAP_Vendor3, and can have several of those in flight. the probe writes TAR at 1 KB
+   boundaries, where auto-increment stops, and at the start of a read or write; CSW and
+   TAR keep their state between vendor commands, and are restored before the next
+   command that is not a vendor command. a write has completed when its response is sent.
+
+   index is the jtag device, as in DAP_Transfer. the host selects the mem-ap, bank 0, in DP SELECT.
+   address and sizes are multiples of 4. ack is that of DAP_Transfer, or 0xff for a bad request.
+   the crc is the one of zlib and ethernet. */
+
+#define VENDOR_ACK_OK          1 /* DAP_TRANSFER_OK */
+#define VENDOR_ACK_BAD_REQUEST 0xff
+#define VENDOR_MAX_SECTORS     255
+#define VENDOR_CHUNK_WORDS     64
+
+#define VENDOR_CRC32      0
+#define VENDOR_COMPARE    1
+#define VENDOR_READ       2
+#define VENDOR_READ_NEXT  3
+#define VENDOR_WRITE      4
+#define VENDOR_WRITE_NEXT 5
+#define VENDOR_STATS      6
+#define VENDOR_TUNE       7
+
+static const uint32_t vendor_crc_table[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+static uint8_t vendor_buf[4 * VENDOR_CHUNK_WORDS];
+
+/* where DAP_Vendor3 and DAP_Vendor5 continue */
+static bool     vendor_next_valid;
+static int      vendor_next_index;
+static uint32_t vendor_next_addr;
+
+/* crc32 a nibble at a time: a 64 byte table */
+static uint32_t vendor_crc32(uint32_t crc, const uint8_t *buf, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++)
+    {
+        crc ^= buf[i];
+        crc  = (crc >> 4) ^ vendor_crc_table[crc & 0xf];
+        crc  = (crc >> 4) ^ vendor_crc_table[crc & 0xf];
+    }
+    return crc;
+}
+
+/* crc32 of size bytes of target memory at addr */
+static int vendor_mem_crc32(uint32_t addr, uint32_t size, uint32_t *crc)
+{
+    int ack = VENDOR_ACK_OK;
+
+    *crc = 0xffffffff;
+    while (size && ack == VENDOR_ACK_OK)
+    {
+        uint32_t n = size > sizeof(vendor_buf) ? sizeof(vendor_buf) : size;
+
+        ack   = dap_mem_read(addr, vendor_buf, n / 4);
+        *crc  = vendor_crc32(*crc, vendor_buf, n);
+        addr += n;
+        size -= n;
+    }
+    *crc ^= 0xffffffff;
+    return ack;
+}
+
+static void vendor_crc(void)
+{
+    int      index = dap_req_get_byte();
+    uint32_t addr  = dap_req_get_word();
+    uint32_t size  = dap_req_get_word();
+    uint32_t crc   = 0;
+    int      ack;
+
+    if (dap_is_buf_error() || (addr & 3) || (size & 3))
+    {
+        dap_resp_add_byte(VENDOR_ACK_BAD_REQUEST);
+        dap_resp_add_word(0);
+        return;
+    }
+
+    ack = dap_mem_begin(index);
+    if (ack == VENDOR_ACK_OK)
+        ack = vendor_mem_crc32(addr, size, &crc);
+    if (ack == VENDOR_ACK_OK)
+        ack = dap_mem_end();
+
+    dap_resp_add_byte(ack);
+    dap_resp_add_word(crc);
+}
+
+static void vendor_compare(void)
+{
+    int      index  = dap_req_get_byte();
+    uint32_t addr   = dap_req_get_word();
+    uint32_t sector = dap_req_get_word();
+    int      count  = dap_req_get_byte();
+    uint8_t  bitmap[(VENDOR_MAX_SECTORS + 7) / 8] = {0};
+    int      checked = 0, differ = 0, first = 0xff;
+    uint32_t crc, expected;
+    int      ack;
+
+    if (dap_is_buf_error() || (addr & 3) || (sector & 3) || sector == 0)
+        ack = VENDOR_ACK_BAD_REQUEST;
+    else
+        ack = dap_mem_begin(index);
+
+    /* every crc is taken from the request, also after an error, so that a command
+       behind this one in DAP_ExecuteCommands is not parsed from crc data */
+    for (int i = 0; i < count; i++)
+    {
+        expected = dap_req_get_word();
+        if (ack != VENDOR_ACK_OK)
+            continue;
+        if (dap_is_buf_error())
+        {
+            ack = VENDOR_ACK_BAD_REQUEST;
+            continue;
+        }
+        ack = vendor_mem_crc32(addr, sector, &crc);
+        if (ack != VENDOR_ACK_OK)
+            continue;
+        if (crc != expected)
+        {
+            bitmap[checked / 8] |= 1 << (checked % 8);
+            if (differ++ == 0)
+                first = checked;
+        }
+        checked++;
+        addr += sector;
+    }
+    if (ack == VENDOR_ACK_OK)
+        ack = dap_mem_end();
+
+    /* the first four bytes are what openocd "cmsis-dap cmd" prints */
+    dap_resp_add_byte(ack);
+    dap_resp_add_byte(checked);
+    dap_resp_add_byte(differ);
+    dap_resp_add_byte(first);
+    for (int i = 0; i < (count + 7) / 8; i++)
+        dap_resp_add_byte(bitmap[i]);
+}
+
+static void vendor_add_half(int value)
+{
+    dap_resp_add_byte(value);
+    dap_resp_add_byte(value >> 8);
+}
+
+/* the words go straight into the response */
+static void vendor_read(bool next)
+{
+    int      index = next ? vendor_next_index : dap_req_get_byte();
+    uint32_t addr  = next ? vendor_next_addr : dap_req_get_word();
+    int      count = dap_req_get_half();
+    int      space = (dap_resp_space() - 3) / 4;
+    uint8_t *data;
+    int      ack;
+
+    if (dap_is_buf_error() || (addr & 3) || (next && !vendor_next_valid))
+    {
+        vendor_next_valid = false;
+        dap_resp_add_byte(VENDOR_ACK_BAD_REQUEST);
+        vendor_add_half(0);
+        return;
+    }
+
+    if (count > space)
+        count = space;
+
+    ack = dap_mem_begin(index);
+    dap_resp_add_byte(ack);
+    vendor_add_half(count);
+    data = dap_resp_add_data(4 * count);
+    if (ack == VENDOR_ACK_OK)
+        ack = dap_mem_read(addr, data, count);
+    if (ack != VENDOR_ACK_OK)
+    {
+        /* the data is not valid: no words, and the next command follows the count */
+        dap_resp_trim(4 * count);
+        dap_resp_set_byte(1, ack);
+        dap_resp_set_byte(2, 0);
+        dap_resp_set_byte(3, 0);
+    }
+
+    vendor_next_valid = (ack == VENDOR_ACK_OK);
+    vendor_next_index = index;
+    vendor_next_addr  = addr + 4 * count;
+}
+
+/* the words are written from the request */
+static void vendor_write(bool next)
+{
+    int      index = next ? vendor_next_index : dap_req_get_byte();
+    uint32_t addr  = next ? vendor_next_addr : dap_req_get_word();
+    int      count = dap_req_get_half();
+    uint8_t *data  = dap_req_get_data(4 * count);
+    int      ack;
+
+    if (dap_is_buf_error() || (addr & 3) || (next && !vendor_next_valid))
+    {
+        vendor_next_valid = false;
+        dap_resp_add_byte(VENDOR_ACK_BAD_REQUEST);
+        vendor_add_half(0);
+        return;
+    }
+
+    ack = dap_mem_begin(index);
+    if (ack == VENDOR_ACK_OK)
+        ack = dap_mem_write(addr, data, count);
+
+    dap_resp_add_byte(ack);
+    vendor_add_half(ack == VENDOR_ACK_OK ? count : 0);
+
+    vendor_next_valid = (ack == VENDOR_ACK_OK);
+    vendor_next_index = index;
+    vendor_next_addr  = addr + 4 * count;
+}
+
+static void vendor_stats(void)
+{
+    bool             clear  = dap_req_get_byte();
+    uint32_t         budget = dap_req_get_word();
+    struct dap_stats stats;
+
+    if (dap_is_buf_error())
+    {
+        dap_resp_add_byte(VENDOR_ACK_BAD_REQUEST);
+        return;
+    }
+
+    if (budget)
+        dap_set_wait_budget(budget);
+    dap_get_stats(&stats, clear);
+
+    dap_resp_add_byte(VENDOR_ACK_OK);
+    dap_resp_add_word(stats.wait);
+    dap_resp_add_word(stats.retries);
+    dap_resp_add_word(stats.timeouts);
+    dap_resp_add_word(stats.fault);
+    dap_resp_add_word(stats.parity);
+    dap_resp_add_word(stats.no_ack);
+    dap_resp_add_word(stats.max_wait_us);
+    dap_resp_add_word(dap_get_wait_budget());
+}
+
+static void vendor_tune(void)
+{
+    bool            retune = dap_req_get_byte();
+    uint32_t        addr   = dap_req_get_word();
+    struct dap_tune tune;
+    int             ack;
+
+    if (dap_is_buf_error() || (addr & 3))
+    {
+        dap_resp_add_byte(VENDOR_ACK_BAD_REQUEST);
+        return;
+    }
+
+    ack = dap_clock_tune(addr, retune, &tune);
+
+    dap_resp_add_byte(ack);
+    dap_resp_add_word(tune.idcode);
+    dap_resp_add_word(tune.freq);
+    dap_resp_add_word(tune.fastest);
+    dap_resp_add_word(tune.failed);
+    dap_resp_add_byte(tune.cached);
+}
+
+/* DAP_CONFIG_VENDOR_FN. index is the command id - ID_DAP_VENDOR_0 */
+void dap_vendor_command(int index)
+{
+    if (index == VENDOR_CRC32)
+        vendor_crc();
+    else if (index == VENDOR_COMPARE)
+        vendor_compare();
+    else if (index == VENDOR_READ || index == VENDOR_READ_NEXT)
+        vendor_read(index == VENDOR_READ_NEXT);
+    else if (index == VENDOR_WRITE || index == VENDOR_WRITE_NEXT)
+        vendor_write(index == VENDOR_WRITE_NEXT);
+    else if (index == VENDOR_STATS)
+        vendor_stats();
+    else if (index == VENDOR_TUNE)
+        vendor_tune();
+    else
+        dap_resp_add_byte(0xff); /* DAP_ERROR */
+}
@@ -19,8 +19,7 @@
 #define NRST_OUT_PIN  TARGET_RST_OUT_PIN
 
 /* GPIO Register Definitions */
-#define REG_GPIOA_CLEAR (*((volatile uint32_t *)0x4002001A)) /* Bit clear register */
-#define REG_GPIOA_SET   (*((volatile uint32_t *)0x40020018)) /* Bit set register */
+#define REG_GPIOA_SET   (*((volatile uint32_t *)0x40020018)) /* Bit set (bits 0-15) and clear (bits 16-31) */
 #define REG_GPIOA_IDT   (*((volatile uint32_t *)0x40020010)) /* Input status */
 #define REG_GPIOA_CFGR  (*((volatile uint32_t *)0x40020000)) /* Configuration low */
 
@@ -38,58 +37,63 @@
 #define TMS_DIR_BIT   SWDIO_DIR_BIT
 #define TCK_DIR_BIT   SWCLK_DIR_BIT
 
+/* the gpio helpers and the swd/jtag pin functions are always inlined, also in -O0 debug builds */
+
 /* GPIO Mode Configuration */
 /* Assumes the pin is in MODE_INPUT or MODE_OUTPUT */
-static inline void GPIOA_OUTPUT(uint32_t pin)
+__attribute__((always_inline)) static inline void GPIOA_OUTPUT(uint32_t pin)
 {
     REG_GPIOA_CFGR = REG_GPIOA_CFGR & ~((uint32_t)0x3 << (pin * 2)) | ((uint32_t)0x1 << (pin * 2));
 }
 
-static inline void GPIOA_INPUT(uint32_t pin)
+__attribute__((always_inline)) static inline void GPIOA_INPUT(uint32_t pin)
 {
     REG_GPIOA_CFGR &= ~((uint32_t)0x3 << (pin * 2));
 }
 
 /* GPIO Access Functions */
-static inline void GPIOA_SET(uint32_t pin)
+__attribute__((always_inline)) static inline void GPIOA_SET(uint32_t pin)
 {
     REG_GPIOA_SET = (1U << pin);
 }
 
-static inline void GPIOA_CLEAR(uint32_t pin)
+__attribute__((always_inline)) static inline void GPIOA_CLEAR(uint32_t pin)
 {
-    REG_GPIOA_CLEAR = (1U << pin);
+    REG_GPIOA_SET = (1U << (pin + 16));
 }
 
-static inline void GPIOA_WRITE(uint32_t pin, int value)
+__attribute__((always_inline)) static inline void GPIOA_WRITE(uint32_t pin, int value)
 {
-    if (value)
-        REG_GPIOA_SET = (1U << pin);
-    else
-        REG_GPIOA_CLEAR = (1U << pin);
+    REG_GPIOA_SET = value ? (1U << pin) : (1U << (pin + 16));
 }
 
-static inline int GPIOA_READ(uint32_t pin)
+/* clock low and data pin in a single register write */
+__attribute__((always_inline)) static inline void GPIOA_CLOCK_LOW_WRITE(uint32_t pin, int value)
+{
+    REG_GPIOA_SET = (1U << (SWCLK_BIT + 16)) | (value ? (1U << pin) : (1U << (pin + 16)));
+}
+
+__attribute__((always_inline)) static inline int GPIOA_READ(uint32_t pin)
 {
     return (REG_GPIOA_IDT & (1U << pin)) != 0;
 }
 
-static inline void HAL_GPIO_SWCLK_TCK_write(int value)
+__attribute__((always_inline)) static inline void HAL_GPIO_SWCLK_TCK_write(int value)
 {
     GPIOA_WRITE(SWCLK_BIT, value);
 }
 
-static inline void HAL_GPIO_SWCLK_TCK_set()
+__attribute__((always_inline)) static inline void HAL_GPIO_SWCLK_TCK_set()
 {
     GPIOA_SET(SWCLK_BIT);
 }
 
-static inline void HAL_GPIO_SWCLK_TCK_clr()
+__attribute__((always_inline)) static inline void HAL_GPIO_SWCLK_TCK_clr()
 {
     GPIOA_CLEAR(SWCLK_BIT);
 }
 
-static inline int HAL_GPIO_SWCLK_TCK_read()
+__attribute__((always_inline)) static inline int HAL_GPIO_SWCLK_TCK_read()
 {
     return GPIOA_READ(SWCLK_BIT);
 }
@@ -106,17 +110,22 @@ static inline void HAL_GPIO_SWCLK_TCK_in()
     GPIOA_CLEAR(SWCLK_DIR_BIT);
 }
 
-static inline void HAL_GPIO_SWDIO_TMS_write(int value)
+__attribute__((always_inline)) static inline void HAL_GPIO_SWCLK_TCK_clr_SWDIO_TMS_write(int value)
+{
+    GPIOA_CLOCK_LOW_WRITE(SWDIO_BIT, value);
+}
+
+__attribute__((always_inline)) static inline void HAL_GPIO_SWDIO_TMS_write(int value)
 {
     GPIOA_WRITE(SWDIO_BIT, value);
 }
 
-static inline void HAL_GPIO_SWDIO_TMS_set()
+__attribute__((always_inline)) static inline void HAL_GPIO_SWDIO_TMS_set()
 {
     GPIOA_SET(SWDIO_BIT);
 }
 
-static inline int HAL_GPIO_SWDIO_TMS_read()
+__attribute__((always_inline)) static inline int HAL_GPIO_SWDIO_TMS_read()
 {
     return GPIOA_READ(SWDIO_BIT);
 }
@@ -134,7 +143,12 @@ static inline void HAL_GPIO_SWDIO_TMS_in()
 }
 
 #ifdef DAP_CONFIG_ENABLE_JTAG
-static inline void HAL_GPIO_TDI_write(int value)
+__attribute__((always_inline)) static inline void HAL_GPIO_SWCLK_TCK_clr_TDI_write(int value)
+{
+    GPIOA_CLOCK_LOW_WRITE(TDI_BIT, value);
+}
+
+__attribute__((always_inline)) static inline void HAL_GPIO_TDI_write(int value)
 {
     GPIOA_WRITE(TDI_BIT, value);
 }
@@ -166,7 +180,7 @@ static inline void HAL_GPIO_TDO_write(int value)
     GPIOA_WRITE(TDO_BIT, value);
 }
 
-static inline int HAL_GPIO_TDO_read()
+__attribute__((always_inline)) static inline int HAL_GPIO_TDO_read()
 {
     return GPIOA_READ(TDO_BIT);
 }
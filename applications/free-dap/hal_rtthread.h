@@ -55,6 +55,12 @@ static inline void HAL_GPIO_SWDIO_TMS_write(int value)
     rt_pin_write(SWDIO_PIN, value ? PIN_HIGH : PIN_LOW);
 }
 
+static inline void HAL_GPIO_SWCLK_TCK_clr_SWDIO_TMS_write(int value)
+{
+    rt_pin_write(SWCLK_PIN, PIN_LOW);
+    rt_pin_write(SWDIO_PIN, value ? PIN_HIGH : PIN_LOW);
+}
+
 static inline void HAL_GPIO_SWDIO_TMS_set()
 {
     rt_pin_write(SWDIO_PIN, PIN_HIGH);
@@ -87,6 +93,12 @@ static inline void HAL_GPIO_TDI_write(int value)
     rt_pin_write(TDI_PIN, value ? PIN_HIGH : PIN_LOW);
 }
 
+static inline void HAL_GPIO_SWCLK_TCK_clr_TDI_write(int value)
+{
+    rt_pin_write(SWCLK_PIN, PIN_LOW);
+    rt_pin_write(TDI_PIN, value ? PIN_HIGH : PIN_LOW);
+}
+
 static inline void HAL_GPIO_TDI_set()
 {
     rt_pin_write(TDI_PIN, PIN_HIGH);
@@ -135,7 +147,7 @@ static inline void HAL_GPIO_TDO_out()
 static inline void HAL_GPIO_nRESET_write(int value)
 {
     /* pull-down transistor inverts logic */
-    rt_pin_write(NRST_OUT_PIN, value ? PIN_LOW : PIN_HIGH)
+    rt_pin_write(NRST_OUT_PIN, value ? PIN_LOW : PIN_HIGH);
 }
 
 static inline void HAL_GPIO_nRESET_set()
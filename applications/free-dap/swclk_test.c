@@ -1,17 +1,125 @@
 #include <rtthread.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
 #include "dap.h"
+#include "swd_arbiter.h"
 
-/* FINSH swclk_test command 
-   determine DAP_CONFIG_DELAY_CONSTANT, DAP_CONFIG_FAST_CLOCK  */
+/* FINSH swclk_test command
+   determine DAP_CONFIG_DELAY_CONSTANT, DAP_CONFIG_FAST_CLOCK
+   and measure SWCLK frequency and SWD word transfer rate */
 
 static void swclk_test(int argc, char **argv)
 {
     uint32_t delay = 0;
-    if (argc >= 1)
-        delay = atoi(argv[0]);
-    dap_clock_test(delay);
+    uint32_t ms = 1000;
+    uint32_t clock_hz, word_rate;
+    if (argc >= 2)
+        delay = atoi(argv[1]);
+    if (argc >= 3)
+        ms = atoi(argv[2]);
+    if (ms == 0)
+        ms = 1;
+    if (!swd_arbiter_take(SWD_USER_DAP))
+    {
+        rt_kprintf("swd busy\r\n");
+        return;
+    }
+    dap_clock_test(delay, ms, &clock_hz, &word_rate);
+    swd_arbiter_release(SWD_USER_DAP);
+    rt_kprintf("delay %u swclk %u Hz %u words/s\r\n", delay, clock_hz, word_rate);
 }
 
-MSH_CMD_EXPORT(swclk_test, calibrate bit - banging delay loop);
+MSH_CMD_EXPORT(swclk_test, calibrate bit - banging delay loop: swclk_test [delay [ms]]);
+
+/* FINSH swclk_jitter command
+   cpu cycles per swd word at the fast clock, interrupts off. a wide spread between
+   min and max is the bit engine waiting for code from qspi flash, see AT32_RAMFUNC */
+
+static void swclk_jitter(int argc, char **argv)
+{
+    int       count = 1000;
+    uint32_t  min, max, mean;
+    rt_base_t level;
+
+    if (argc >= 2)
+        count = atoi(argv[1]);
+    if (count <= 0)
+        count = 1;
+    if (!swd_arbiter_take(SWD_USER_DAP))
+    {
+        rt_kprintf("swd busy\r\n");
+        return;
+    }
+    level = rt_hw_interrupt_disable();
+    dap_clock_jitter(count, &min, &max, &mean);
+    rt_hw_interrupt_enable(level);
+    swd_arbiter_release(SWD_USER_DAP);
+    rt_kprintf("%d words: min %u max %u mean %u cycles, spread %u\r\n", count, min, max, mean, max - min);
+}
+
+MSH_CMD_EXPORT(swclk_jitter, cycles per swd word at the fast clock: swclk_jitter [words]);
+
+/* FINSH swd_clock command
+   requested versus achieved swclk frequency, after calibration against the cycle counter */
+
+static const int swd_clock_freq[] = {10000, 100000, 500000, 1000000, 2000000, 4000000, 8000000, 20000000};
+
+static void print_swd_clock(int freq)
+{
+    int delay;
+    int achieved = dap_clock_achieved(freq, &delay);
+    int measured = dap_clock_measure(freq);
+    int error    = (int)(((int64_t)measured - freq) * 1000 / freq); /* 0.1 % */
+
+    rt_kprintf("%9d %9d %9d %c%d.%d%% ", freq, achieved, measured, error < 0 ? '-' : '+', abs(error) / 10, abs(error) % 10);
+    if (delay < 0)
+        rt_kprintf("fast\r\n");
+    else
+        rt_kprintf("%d\r\n", delay);
+}
+
+static void swd_clock(int argc, char **argv)
+{
+    /* before taking the pins: measuring 0 Hz would run for minutes at the 1 Hz floor */
+    if (argc >= 2 && strcmp(argv[1], "cal"))
+        for (int i = 1; i < argc; i++)
+            if (atoi(argv[i]) <= 0)
+            {
+                rt_kprintf("swd_clock [cal | freq...], freq in Hz, above 0\r\n");
+                return;
+            }
+
+    /* calibrate and measure toggle swclk on the target pins */
+    if (!swd_arbiter_take(SWD_USER_DAP))
+    {
+        rt_kprintf("swd busy\r\n");
+        return;
+    }
+    if (argc == 2 && !strcmp(argv[1], "cal"))
+        dap_clock_calibrate();
+
+    rt_kprintf("requested    expect  measured  error delay\r\n");
+    if (argc >= 2 && strcmp(argv[1], "cal"))
+        for (int i = 1; i < argc; i++)
+            print_swd_clock(atoi(argv[i]));
+    else
+        for (int i = 0; i < sizeof(swd_clock_freq) / sizeof(swd_clock_freq[0]); i++)
+            print_swd_clock(swd_clock_freq[i]);
+    swd_arbiter_release(SWD_USER_DAP);
+}
+
+MSH_CMD_EXPORT(swd_clock, swclk requested vs achieved: swd_clock [cal | freq...]);
+
+/* calibrate the swclk delay loop at boot. nothing else has the pins yet, but the
+   arbiter is up (INIT_DEVICE_EXPORT) and the calibration toggles swclk */
+static int swclk_calibrate(void)
+{
+    if (!swd_arbiter_take(SWD_USER_DAP))
+        return -RT_EBUSY;
+    dap_clock_calibrate();
+    swd_arbiter_release(SWD_USER_DAP);
+    return RT_EOK;
+}
+
+INIT_APP_EXPORT(swclk_calibrate);
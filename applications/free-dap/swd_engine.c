@@ -0,0 +1,62 @@
+#include <rtthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "dap.h"
+
+/* FINSH swd_engine command
+   select the free-dap swd engine at fast clock, and show verify results */
+
+static const char *const engine_name[] = {"bit", "word", "verify"};
+
+static void swd_engine(int argc, char **argv)
+{
+    uint32_t checks, errors;
+    int      engine = -1;
+
+    if (argc == 2)
+        for (int i = 0; i < sizeof(engine_name) / sizeof(engine_name[0]); i++)
+            if (!strcmp(argv[1], engine_name[i]))
+                engine = i;
+
+    if (argc > 2 || (argc == 2 && engine < 0))
+    {
+        rt_kprintf("%s [bit|word|verify]\r\n", argv[0]);
+        return;
+    }
+
+    if (engine >= 0)
+    {
+        dap_swd_set_engine(engine);
+        dap_swd_verify_stats(&checks, &errors, true);
+    }
+
+    dap_swd_verify_stats(&checks, &errors, false);
+    rt_kprintf("engine %s checks %u errors %u\r\n", engine_name[dap_swd_get_engine()], checks, errors);
+}
+
+MSH_CMD_EXPORT(swd_engine, select swd engine: bit word verify);
+
+/* FINSH swd_stats command
+   transfer errors since the last DAP_Connect, and the time WAIT is retried */
+
+static void swd_stats(int argc, char **argv)
+{
+    struct dap_stats stats;
+    bool             clear = argc == 2 && !strcmp(argv[1], "clear");
+
+    if (argc == 3 && !strcmp(argv[1], "budget") && atoi(argv[2]) > 0)
+        dap_set_wait_budget(atoi(argv[2]));
+    else if (argc > 1 && !clear)
+    {
+        rt_kprintf("%s [clear | budget us]\r\n", argv[0]);
+        return;
+    }
+
+    dap_get_stats(&stats, clear);
+    rt_kprintf("wait %u retries %u timeouts %u longest %u us budget %u us\r\n", stats.wait, stats.retries,
+               stats.timeouts, stats.max_wait_us, dap_get_wait_budget());
+    rt_kprintf("fault %u parity %u no ack %u\r\n", stats.fault, stats.parity, stats.no_ack);
+}
+
+MSH_CMD_EXPORT(swd_stats, transfer errors and wait budget: swd_stats [clear | budget us]);
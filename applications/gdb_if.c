@@ -8,34 +8,182 @@
 #include "gdb_packet.h"
 #include "gdb_main.h"
 #include "gdb_if.h"
+#include "gdb_if_block.h"
 #include "gdb_task.h"
+#include "rtt.h"
+#include "swd_arbiter.h"
 #include <rtthread.h>
+#include <stdlib.h>
+#include <string.h>
 
-static uint8_t  gdb_write_buffer[CDC_MAX_MPS - 1];
+/* output buffer is a full usb packet. usb_cdc.c sends a zero-length packet if needed. */
+static uint8_t  gdb_write_buffer[CDC_MAX_MPS];
 static uint32_t gdb_write_idx = 0;
 
+/* input buffer holds the span of characters last taken from cdc0 */
+static uint8_t  gdb_read_buffer[CDC_MAX_MPS];
+static uint32_t gdb_read_idx = 0;
+static uint32_t gdb_read_len = 0;
+
+/* the gdb server holds the swd pins while it runs a packet or polls the target,
+ * and lets cmsis-dap have them while it waits for gdb. see swd_arbiter.h */
+static bool gdb_swd_held = false;
+
+static void gdb_if_swd_release()
+{
+    if (gdb_swd_held)
+        swd_arbiter_release(SWD_USER_BMD);
+    gdb_swd_held = false;
+}
+
+static void gdb_if_swd_take()
+{
+    if (!gdb_swd_held)
+        gdb_swd_held = swd_arbiter_take(SWD_USER_BMD);
+}
+
+/* while the target runs, the black magic poll loop calls gdb_if_getchar_to(0) between
+ * target polls. instead of returning at once, the gdb task sleeps on the cdc0 wait queue
+ * for one poll interval, with the swd pins released. a character from gdb ends the
+ * sleep at once. the interval is short after gdb resumes the target, and doubles
+ * each poll the target keeps running, up to gdb_poll_max_ms. black magic polls rtt in
+ * the same loop, so while rtt is on the sleep is also at most rtt_min_poll_ms. */
+#define GDB_POLL_MIN_MS 1
+#define GDB_POLL_MAX_MS 32
+
+static uint32_t gdb_poll_min_ms = GDB_POLL_MIN_MS;
+static uint32_t gdb_poll_max_ms = GDB_POLL_MAX_MS;
+static uint32_t gdb_poll_ms     = GDB_POLL_MIN_MS;
+
+static struct
+{
+    uint32_t  polls;   /* target polls while running */
+    uint32_t  wakeups; /* polls cut short by gdb */
+    rt_tick_t since;   /* tick of last clear */
+} gdb_poll_stats;
+
+static void gdb_if_reset()
+{
+    gdb_write_idx = 0;
+    gdb_read_idx  = 0;
+    gdb_read_len  = 0;
+    gdb_if_swd_release();
+}
+
+/* read from cdc0, waiting at most timeout_ticks, with the swd pins released.
+ * a wakeup without data waits again for the rest of the time */
+
+static uint32_t gdb_if_cdc0_read(uint8_t *buf, uint32_t len, uint32_t timeout_ticks)
+{
+    rt_tick_t start = rt_tick_get();
+    rt_tick_t waited;
+    uint32_t  count;
+
+    gdb_if_swd_release();
+    for (;;)
+    {
+        waited = rt_tick_get() - start;
+        if (timeout_ticks == RT_WAITING_FOREVER)
+            count = cdc0_read(buf, len, RT_WAITING_FOREVER);
+        else
+            count = cdc0_read(buf, len, waited < timeout_ticks ? timeout_ticks - waited : 0);
+        if (count != 0 || !cdc0_connected())
+            break;
+        if (timeout_ticks != RT_WAITING_FOREVER && rt_tick_get() - start >= timeout_ticks)
+            break;
+    }
+    gdb_if_swd_take();
+    return count;
+}
+
+/* refill input buffer from cdc0, waiting at most timeout_ticks */
+
+static bool gdb_if_fill(uint32_t timeout_ticks)
+{
+    gdb_read_idx = 0;
+    gdb_read_len = gdb_if_cdc0_read(gdb_read_buffer, sizeof(gdb_read_buffer), timeout_ticks);
+    if (gdb_read_len == 0)
+        return false;
+    /* gdb is talking. if this resumes the target, poll fast at first */
+    gdb_poll_ms = gdb_poll_min_ms;
+    return true;
+}
+
+/* longest sleep between target polls */
+
+static uint32_t gdb_if_poll_max()
+{
+    if (rtt_enabled && rtt_min_poll_ms < gdb_poll_max_ms)
+        return rtt_min_poll_ms > gdb_poll_min_ms ? rtt_min_poll_ms : gdb_poll_min_ms;
+    return gdb_poll_max_ms;
+}
+
+/* wait one poll interval for gdb. back off if gdb stays silent */
+
+static char gdb_if_poll()
+{
+    gdb_poll_stats.polls++;
+    if (gdb_if_fill(rt_tick_from_millisecond(gdb_poll_ms)))
+    {
+        gdb_poll_stats.wakeups++;
+        return gdb_read_buffer[gdb_read_idx++];
+    }
+    gdb_poll_ms *= 2;
+    if (gdb_poll_ms > gdb_if_poll_max())
+        gdb_poll_ms = gdb_if_poll_max();
+    return -1;
+}
+
 /* read one character from gdb port, no time-out */
 
 char gdb_if_getchar()
+{
+    return gdb_if_getchar_to(RT_WAITING_FOREVER);
+}
+
+/* read one character from gdb port with time-out */
+
+char gdb_if_getchar_to(uint32_t timeout_ms)
 {
     if (!cdc0_connected())
     {
-        gdb_write_idx = 0;
+        gdb_if_reset();
         return '\x04';
     }
-    return cdc0_getchar_timeout(RT_WAITING_FOREVER);
+    if (gdb_read_idx < gdb_read_len)
+        return gdb_read_buffer[gdb_read_idx++];
+    if (timeout_ms == 0 && gdb_target_running)
+        return gdb_if_poll();
+    if (gdb_if_fill(rt_tick_from_millisecond(timeout_ms)))
+        return gdb_read_buffer[gdb_read_idx++];
+    return -1;
 }
 
-/* read one character from gdb port with time-out */
+/* read the characters available from gdb port, up to len, and up to and including
+ * the first '#'. what follows the end of a packet stays for gdb_if_getchar().
+ * waits at most timeout_ms for the first character.
+ * returns number of characters read, 0 on time-out or disconnect. */
 
-char gdb_if_getchar_to(uint32_t timeout_ms)
+uint32_t gdb_if_read(uint8_t *buf, uint32_t len, uint32_t timeout_ms)
 {
+    uint8_t *end;
+    uint32_t count;
+
     if (!cdc0_connected())
     {
-        gdb_write_idx = 0;
-        return '\x04';
+        gdb_if_reset();
+        return 0;
     }
-    return cdc0_getchar_timeout(timeout_ms);
+    if (gdb_read_idx == gdb_read_len && !gdb_if_fill(rt_tick_from_millisecond(timeout_ms)))
+        return 0;
+    count = gdb_read_len - gdb_read_idx;
+    if (count > len) count = len;
+    end = memchr(&gdb_read_buffer[gdb_read_idx], '#', count);
+    if (end)
+        count = end - &gdb_read_buffer[gdb_read_idx] + 1;
+    memcpy(buf, &gdb_read_buffer[gdb_read_idx], count);
+    gdb_read_idx += count;
+    return count;
 }
 
 /* write one character to gdb server port. send usb packet if "flush" */
@@ -50,4 +198,79 @@ void gdb_if_putchar(char c, bool flush)
     }
 }
 
+/* write a block to gdb server port. send usb packet if "flush" */
+
+void gdb_if_write(const uint8_t *buf, uint32_t len, bool flush)
+{
+    uint32_t count;
+
+    while (len)
+    {
+        if (gdb_write_idx == 0 && len >= sizeof(gdb_write_buffer))
+        {
+            /* whole packets go out in a single usb transfer, without copying */
+            count = len - len % sizeof(gdb_write_buffer);
+            cdc0_write((uint8_t *)buf, count);
+        }
+        else
+        {
+            count = sizeof(gdb_write_buffer) - gdb_write_idx;
+            if (count > len) count = len;
+            memcpy(&gdb_write_buffer[gdb_write_idx], buf, count);
+            gdb_write_idx += count;
+            if (gdb_write_idx == sizeof(gdb_write_buffer))
+            {
+                cdc0_write(gdb_write_buffer, gdb_write_idx);
+                gdb_write_idx = 0;
+            }
+        }
+        buf += count;
+        len -= count;
+    }
+    if (flush && gdb_write_idx)
+    {
+        cdc0_write(gdb_write_buffer, gdb_write_idx);
+        gdb_write_idx = 0;
+    }
+}
+
+#ifdef RT_USING_FINSH
+static int cmd_gdb_poll(int argc, char **argv)
+{
+    rt_tick_t elapsed;
+
+    if (argc == 3)
+    {
+        gdb_poll_min_ms = atoi(argv[1]);
+        gdb_poll_max_ms = atoi(argv[2]);
+        if (gdb_poll_min_ms == 0)
+            gdb_poll_min_ms = 1;
+        if (gdb_poll_max_ms < gdb_poll_min_ms)
+            gdb_poll_max_ms = gdb_poll_min_ms;
+        gdb_poll_ms = gdb_poll_min_ms;
+        return RT_EOK;
+    }
+    if (argc != 1 && !(argc == 2 && !strcmp(argv[1], "clear")))
+    {
+        rt_kprintf("gdb_poll [clear | min_ms max_ms]\r\n");
+        return -RT_EINVAL;
+    }
+    elapsed = rt_tick_get() - gdb_poll_stats.since;
+    rt_kprintf("target %s poll interval %u ms (%u..%u ms%s)\r\n", gdb_target_running ? "running" : "halted",
+               gdb_poll_ms, gdb_poll_min_ms, gdb_if_poll_max(), gdb_if_poll_max() < gdb_poll_max_ms ? ", rtt" : "");
+    rt_kprintf("polls %u (%u/s) woken by gdb %u\r\n", gdb_poll_stats.polls,
+               elapsed ? (uint32_t)((uint64_t)gdb_poll_stats.polls * RT_TICK_PER_SECOND / elapsed) : 0,
+               gdb_poll_stats.wakeups);
+    if (argc == 2)
+    {
+        gdb_poll_stats.polls   = 0;
+        gdb_poll_stats.wakeups = 0;
+        gdb_poll_stats.since   = rt_tick_get();
+    }
+    return RT_EOK;
+}
+
+MSH_CMD_EXPORT_ALIAS(cmd_gdb_poll, gdb_poll, target poll rate while running: gdb_poll [clear | min_ms max_ms]);
+#endif
+
 #endif
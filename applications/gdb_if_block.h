@@ -0,0 +1,16 @@
+#ifndef _GDB_IF_BLOCK_H
+#define _GDB_IF_BLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * block i/o for the gdb server port.
+ * complements gdb_if_getchar() and gdb_if_putchar() from black magic debug,
+ * so the gdb packet layer can move a whole span or packet in one call.
+ */
+
+uint32_t gdb_if_read(uint8_t *buf, uint32_t len, uint32_t timeout_ms);
+void     gdb_if_write(const uint8_t *buf, uint32_t len, bool flush);
+
+#endif
@@ -0,0 +1,221 @@
+#include <rtthread.h>
+#include <string.h>
+#include <stdlib.h>
+#include "drv_common.h"
+#include "drv_gpio.h"
+#include "pins.h"
+#include "gpio_wave.h"
+
+/* waveform engine. see gpio_wave.h */
+
+/* dma2 channel 6 and 7 are free: patches/01_dma_config.patch moves uart7 rx to dma1
+ * channel 7 and removes the dma2 channel 6 and 7 entries, so no bsp uart or spi driver
+ * uses them. the uarts and spi2 with dma in rtconfig.h are on dma1 and dma2 channel 1..5 */
+#define WAVE_TMR          TMR1
+#define WAVE_TMR_CLOCK    CRM_TMR1_PERIPH_CLOCK
+#define WAVE_DMA          DMA2
+#define WAVE_DMA_CLOCK    CRM_DMA2_PERIPH_CLOCK
+#define WAVE_OUT_DMA      DMA2_CHANNEL6
+#define WAVE_OUT_DMAMUX   DMA2MUX_CHANNEL6
+#define WAVE_OUT_FDT_FLAG DMA2_FDT6_FLAG
+#define WAVE_IN_DMA       DMA2_CHANNEL7
+#define WAVE_IN_DMAMUX    DMA2MUX_CHANNEL7
+#define WAVE_IN_FDT_FLAG  DMA2_FDT7_FLAG
+
+#define WAVE_CLK_BIT (TARGET_SWCLK_PIN & 0xF)
+
+static uint32_t wave_out[2 * GPIO_WAVE_MAX_BITS];
+static uint16_t wave_in[2 * GPIO_WAVE_MAX_BITS];
+static bool     wave_enable = false;
+static bool     wave_init   = false;
+
+static uint32_t wave_runs;
+static uint32_t wave_bits;
+static uint32_t wave_timeouts;
+
+static void wave_hw_init()
+{
+    crm_periph_clock_enable(WAVE_TMR_CLOCK, TRUE);
+    crm_periph_clock_enable(WAVE_DMA_CLOCK, TRUE);
+    dmamux_enable(WAVE_DMA, TRUE);
+    dmamux_init(WAVE_OUT_DMAMUX, DMAMUX_DMAREQ_ID_TMR1_OVERFLOW);
+    dmamux_init(WAVE_IN_DMAMUX, DMAMUX_DMAREQ_ID_TMR1_CH1);
+    wave_init = true;
+}
+
+static void wave_dma_setup(dma_channel_type *channel, dma_dir_type dir, uint32_t periph, void *mem, bool halfword, uint32_t count)
+{
+    dma_init_type dma_init_struct;
+
+    dma_reset(channel);
+    dma_default_para_init(&dma_init_struct);
+    dma_init_struct.buffer_size           = count;
+    dma_init_struct.direction             = dir;
+    dma_init_struct.memory_base_addr      = (uint32_t)mem;
+    dma_init_struct.memory_data_width     = halfword ? DMA_MEMORY_DATA_WIDTH_HALFWORD : DMA_MEMORY_DATA_WIDTH_WORD;
+    dma_init_struct.memory_inc_enable     = TRUE;
+    dma_init_struct.peripheral_base_addr  = periph;
+    dma_init_struct.peripheral_data_width = DMA_PERIPHERAL_DATA_WIDTH_WORD;
+    dma_init_struct.peripheral_inc_enable = FALSE;
+    dma_init_struct.priority              = DMA_PRIORITY_VERY_HIGH;
+    dma_init_struct.loop_mode_enable      = FALSE;
+    dma_init(channel, &dma_init_struct);
+    dma_channel_enable(channel, TRUE);
+}
+
+/* timer clock is twice the apb clock if the apb divider is not 1 */
+static uint32_t wave_tmr_clock()
+{
+    crm_clocks_freq_type clocks;
+
+    crm_clocks_freq_get(&clocks);
+    if (clocks.apb2_freq == clocks.ahb_freq)
+        return clocks.apb2_freq;
+    return 2 * clocks.apb2_freq;
+}
+
+/* precompute set/clear words: clock low and data, clock high */
+static void wave_fill(int out_bit, const uint8_t *out, uint32_t bits)
+{
+    uint32_t clk_low  = 1U << (WAVE_CLK_BIT + 16);
+    uint32_t clk_high = 1U << WAVE_CLK_BIT;
+
+    for (uint32_t i = 0; i < bits; i++)
+    {
+        uint32_t word = clk_low;
+        if (out_bit != GPIO_WAVE_NONE)
+            word |= (out[i / 8] >> (i % 8)) & 1 ? 1U << out_bit : 1U << (out_bit + 16);
+        wave_out[2 * i]     = word;
+        wave_out[2 * i + 1] = clk_high;
+    }
+}
+
+/* capture n is halfway half-period n. bit i is sampled while the clock is low, capture 2i+1 */
+static void wave_unpack(int in_bit, uint8_t *in, uint32_t bits)
+{
+    memset(in, 0, (bits + 7) / 8);
+    for (uint32_t i = 0; i < bits; i++)
+        if (wave_in[2 * i + 1] & (1U << in_bit))
+            in[i / 8] |= 1 << (i % 8);
+}
+
+/* wait for the last clock high. in a thread, let other threads run meanwhile */
+static bool wave_wait(uint32_t loops)
+{
+    bool in_thread = rt_interrupt_get_nest() == 0;
+
+    while (dma_flag_get(WAVE_OUT_FDT_FLAG) == RESET)
+    {
+        if (loops-- == 0)
+            return false;
+        if (in_thread)
+            rt_thread_yield();
+    }
+    return true;
+}
+
+rt_err_t gpio_wave_run(int out_bit, const uint8_t *out, int in_bit, uint8_t *in, uint32_t bits, uint32_t freq)
+{
+    uint32_t period, div;
+    bool     ok;
+
+    if (!wave_enable)
+        return -RT_ENOSYS;
+    if (bits == 0 || bits > GPIO_WAVE_MAX_BITS || freq == 0 || freq > GPIO_WAVE_MAX_FREQ)
+        return -RT_EINVAL;
+    if (!wave_init)
+        wave_hw_init();
+
+    /* half a clock period, in timer ticks */
+    period = wave_tmr_clock() / (2 * freq);
+    div    = period / 0x10000 + 1;
+    period = period / div;
+
+    wave_fill(out_bit, out, bits);
+
+    tmr_counter_enable(WAVE_TMR, FALSE);
+    tmr_base_init(WAVE_TMR, period - 1, div - 1);
+    tmr_cnt_dir_set(WAVE_TMR, TMR_COUNT_UP);
+    tmr_channel_value_set(WAVE_TMR, TMR_SELECT_CHANNEL_1, period / 2);
+    /* load divider before dma requests are enabled */
+    tmr_event_sw_trigger(WAVE_TMR, TMR_OVERFLOW_SWTRIG);
+    tmr_counter_value_set(WAVE_TMR, 0);
+
+    dma_flag_clear(WAVE_OUT_FDT_FLAG);
+    dma_flag_clear(WAVE_IN_FDT_FLAG);
+    wave_dma_setup(WAVE_OUT_DMA, DMA_DIR_MEMORY_TO_PERIPHERAL, (uint32_t)&GPIOA->scr, wave_out, false, 2 * bits);
+    if (in_bit != GPIO_WAVE_NONE)
+        wave_dma_setup(WAVE_IN_DMA, DMA_DIR_PERIPHERAL_TO_MEMORY, (uint32_t)&GPIOA->idt, wave_in, true, 2 * bits);
+
+    tmr_dma_request_enable(WAVE_TMR, TMR_OVERFLOW_DMA_REQUEST, TRUE);
+    tmr_dma_request_enable(WAVE_TMR, TMR_C1_DMA_REQUEST, in_bit != GPIO_WAVE_NONE);
+    tmr_counter_enable(WAVE_TMR, TRUE);
+
+    /* generous timeout: at least one loop per timer tick */
+    ok = wave_wait(2 * bits * period * div + 100000);
+
+    tmr_counter_enable(WAVE_TMR, FALSE);
+    tmr_dma_request_enable(WAVE_TMR, TMR_OVERFLOW_DMA_REQUEST, FALSE);
+    tmr_dma_request_enable(WAVE_TMR, TMR_C1_DMA_REQUEST, FALSE);
+    dma_channel_enable(WAVE_OUT_DMA, FALSE);
+    dma_channel_enable(WAVE_IN_DMA, FALSE);
+
+    if (!ok)
+    {
+        wave_timeouts++;
+        return -RT_ETIMEOUT;
+    }
+
+    if (in_bit != GPIO_WAVE_NONE)
+        wave_unpack(in_bit, in, bits);
+
+    wave_runs++;
+    wave_bits += bits;
+    return RT_EOK;
+}
+
+#ifdef RT_USING_FINSH
+static void print_wave()
+{
+    rt_kprintf("%s runs %u bits %u timeouts %u\r\n", wave_enable ? "on" : "off", wave_runs, wave_bits, wave_timeouts);
+}
+
+/* line reset: 256 clocks with data high, and time it */
+static void wave_test(uint32_t freq)
+{
+    uint8_t   ones[GPIO_WAVE_MAX_BITS / 8];
+    rt_tick_t start;
+    rt_err_t  err;
+
+    memset(ones, 0xff, sizeof(ones));
+    start = rt_tick_get();
+    for (int i = 0; i < 1000; i++)
+        if ((err = gpio_wave_run(TARGET_SWDIO_PIN & 0xF, ones, GPIO_WAVE_NONE, RT_NULL, GPIO_WAVE_MAX_BITS, freq)) != RT_EOK)
+        {
+            rt_kprintf("error %d\r\n", err);
+            return;
+        }
+    rt_kprintf("1000 x %d bits at %u Hz: %u ms\r\n", GPIO_WAVE_MAX_BITS, freq, rt_tick_get() - start);
+}
+
+static int cmd_gpio_wave(int argc, char **argv)
+{
+    if (argc == 1)
+        print_wave();
+    else if (argc == 2 && !strcmp(argv[1], "on"))
+        wave_enable = true;
+    else if (argc == 2 && !strcmp(argv[1], "off"))
+        wave_enable = false;
+    else if (argc == 3 && !strcmp(argv[1], "test"))
+        wave_test(atoi(argv[2]));
+    else
+    {
+        rt_kprintf("%s            print status\r\n", argv[0]);
+        rt_kprintf("%s on|off     use dma for long swj, swd and jtag sequences\r\n", argv[0]);
+        rt_kprintf("%s test freq  time 1000 line resets, with the debugger connected\r\n", argv[0]);
+    }
+    return RT_EOK;
+}
+
+MSH_CMD_EXPORT_ALIAS(cmd_gpio_wave, gpio_wave, dma waveform engine);
+#endif
@@ -0,0 +1,25 @@
+#ifndef _GPIO_WAVE_H
+#define _GPIO_WAVE_H
+
+#include <stdint.h>
+#include <rtthread.h>
+
+/*
+   waveform engine for long swj, swd and jtag sequences.
+   a sequence is precomputed as GPIOA set/clear register words, two per clock cycle:
+   clock low with the new data bit, then clock high.
+   a timer triggers dma from the buffer to the set/clear register, at twice the clock frequency.
+   a second dma, triggered halfway between, captures the input register.
+   the clock is free of cpu jitter, and the cpu is free while the sequence plays.
+ */
+
+#define GPIO_WAVE_MAX_BITS 256
+#define GPIO_WAVE_MAX_FREQ 4000000 /* dma transfers to gpio at 8 MHz */
+#define GPIO_WAVE_NONE     (-1)
+
+/* out_bit, in_bit: GPIOA bit number, or GPIO_WAVE_NONE.
+   out, in: bits lsb first.
+   returns -RT_ENOSYS if disabled, -RT_EINVAL if bits or freq out of range. */
+rt_err_t gpio_wave_run(int out_bit, const uint8_t *out, int in_bit, uint8_t *in, uint32_t bits, uint32_t freq);
+
+#endif
@@ -9,6 +9,7 @@
 #define DBG_LVL DBG_INFO
 #include <rtdbg.h>
 #include "settings.h"
+#include "spsc_rb.h"
 
 /* usb serial cdc1 logging to sdcard */
 
@@ -20,7 +21,7 @@
 #define LOG_SYNC_BYTES      512
 #define LOG_NAME_MAX        128
 
-static struct rt_ringbuffer *log_rb        = RT_NULL;
+static struct spsc_rb       *log_rb        = RT_NULL; /* producers serialized in logger(), consumer log_sync_thread */
 static rt_sem_t              log_sync_sem  = RT_NULL;
 static rt_thread_t           log_thread_id = RT_NULL;
 static bool                  log_open      = false;
@@ -36,51 +37,27 @@ static bool is_dir(const char *path)
     return false;
 }
 
-/* write a ringbuffer to file. */
+/* write a ringbuffer to file.
+ * dfs_file_write() takes the data straight from the ringbuffer, without copying. */
 
-rt_size_t ringbuffer_write(struct dfs_file *fd, struct rt_ringbuffer *rb)
+rt_size_t ringbuffer_write(struct dfs_file *fd, struct spsc_rb *rb)
 {
-    /* this is rt_ringbuffer_get(), 
-     * modified to use dfs_file_write() instead of rt_memcpy() 
-     * avoids copying data. */
-
-    rt_uint32_t length;
+    rt_size_t total = 0;
+    uint8_t  *span;
+    uint32_t  len;
 
     RT_ASSERT(fd != RT_NULL);
     RT_ASSERT(rb != RT_NULL);
 
-    /* whether has enough data  */
-    length = rt_ringbuffer_data_len(rb);
-
-    /* no data */
-    if (length == 0)
-        return 0;
-
-    if (rb->buffer_size - rb->read_index > length)
+    /* at most two spans: up to the end of the buffer, and from the start */
+    while ((len = spsc_rb_peek(rb, &span)) != 0)
     {
-        /* write all of data */
-        dfs_file_write(fd,
-                       &rb->buffer_ptr[rb->read_index],
-                       length);
-
-        /* this should not cause overflow because there is enough space for
-         * length of data in current mirror */
-        rb->read_index += length;
-        return length;
+        dfs_file_write(fd, span, len);
+        spsc_rb_commit(rb, len);
+        total += len;
     }
 
-    dfs_file_write(fd,
-                   &rb->buffer_ptr[rb->read_index],
-                   rb->buffer_size - rb->read_index);
-    dfs_file_write(fd,
-                   &rb->buffer_ptr[0],
-                   length - (rb->buffer_size - rb->read_index));
-
-    /* we are going into the other side of the mirror */
-    rb->read_mirror = ~rb->read_mirror;
-    rb->read_index  = length - (rb->buffer_size - rb->read_index);
-
-    return length;
+    return total;
 }
 
 static void log_rotate()
@@ -133,8 +110,11 @@ void logger(char *buf, uint32_t len)
 
     if (log_rb == RT_NULL || buf == RT_NULL) return;
 
-    rt_ringbuffer_put(log_rb, (const rt_uint8_t *)buf, (rt_uint16_t)len);
+    /* logger() is called from several threads; one producer at a time */
+    rt_enter_critical();
+    spsc_rb_put(log_rb, (const uint8_t *)buf, len);
     bytes_written += len;
+    rt_exit_critical();
 
     if (log_sync_sem && bytes_written > LOG_SYNC_BYTES)
     {
@@ -148,7 +128,13 @@ static int logger_init(void)
     if (!settings.logging_enable)
         return RT_EOK;
 
-    log_rb        = rt_ringbuffer_create(LOG_BUF_SIZE);
+    log_rb        = rt_malloc(sizeof(struct spsc_rb) + LOG_BUF_SIZE);
+    if (log_rb == RT_NULL)
+    {
+        LOG_E("log buffer fail");
+        return -RT_ENOMEM;
+    }
+    spsc_rb_init(log_rb, (uint8_t *)(log_rb + 1), LOG_BUF_SIZE);
     log_sync_sem  = rt_sem_create("log sync", 0, RT_IPC_FLAG_FIFO);
     log_thread_id = rt_thread_create("log_sync", log_sync_thread, RT_NULL, 1024, 25, 10);
     log_index     = find_last_log(LOG_ELM_DIR, LOG_FILENAME_FORMAT);
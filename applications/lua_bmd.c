@@ -10,6 +10,8 @@
 #include "gdb_main.h"
 #include "target.h"
 #include "target_internal.h"
+#include "swd_arbiter.h"
+#include "attach_cache.h"
 
 /* lua bmd library
 
@@ -610,50 +612,18 @@ static int lua_bmd_breakwatch_clear(lua_State *L)
     return 1;
 }
 
+/* returns true and the time to attach in ms */
 static int lua_bmd_attach(lua_State *L)
 {
-    target_s *target;
-    char     *msg = NULL;
-    if (connect_assert_nrst)
-        platform_nrst_set_val(true); /* will be deasserted after attach */
-
-    bool scan_result = false;
-    TRY(EXCEPTION_ALL)
-    {
-        scan_result = adiv5_swd_scan(0);
-    }
-    CATCH()
-    {
-    case EXCEPTION_TIMEOUT:
-        msg = "Timeout during scan. Is target stuck in WFI?";
-        break;
-    case EXCEPTION_ERROR:
-        msg = (char *)exception_frame.msg;
-        break;
-    default:
-        break;
-    }
-
-    if (!scan_result)
-        msg = "swd scan failed";
-
+    struct attach_cache_stats stats;
+    const char               *msg = attach_cache_attach();
     if (msg)
-    {
-        platform_target_clk_output_enable(false);
-        platform_nrst_set_val(false);
         return push_error(L, msg);
-    }
-
-    platform_target_clk_output_enable(false);
-
-    /* Attach to remote target processor */
-    extern target_controller_s gdb_controller;
-    cur_target = target_attach_n(1, &gdb_controller);
-    if (!cur_target)
-        return push_error(L, "attach failed");
 
+    attach_cache_get_stats(&stats, false);
     lua_pushboolean(L, 1);
-    return 1;
+    lua_pushinteger(L, stats.last_ms);
+    return 2;
 }
 
 /* bmd library */
@@ -679,10 +649,35 @@ static const struct luaL_Reg bmd_lib[] = {
     {              NULL,                     NULL}
 };
 
+/* runs the library function in upvalue 1 with the swd pins held, see swd_arbiter.h.
+   bmd goes ahead if the wait times out. a lua error is raised again after the pins are released */
+static int lua_bmd_locked(lua_State *L)
+{
+    int  nargs = lua_gettop(L);
+    int  status;
+    bool held;
+
+    lua_pushvalue(L, lua_upvalueindex(1));
+    lua_insert(L, 1);
+    held   = swd_arbiter_take(SWD_USER_BMD);
+    status = lua_pcall(L, nargs, LUA_MULTRET, 0);
+    if (held)
+        swd_arbiter_release(SWD_USER_BMD);
+    if (status != LUA_OK)
+        return lua_error(L);
+    return lua_gettop(L);
+}
+
 /* called from lua init, registers bmd library */
 int luaopen_bmd(lua_State *L)
 {
     luaL_newlib(L, bmd_lib);
+    for (const luaL_Reg *reg = bmd_lib; reg->name; reg++)
+    {
+        lua_pushcfunction(L, reg->func);
+        lua_pushcclosure(L, lua_bmd_locked, 1);
+        lua_setfield(L, -2, reg->name);
+    }
     return 1;
 }
 
@@ -6,6 +6,7 @@
 #include <string.h>
 
 #include "free-dap/dap.h"
+#include "swd_arbiter.h"
 
 /* lua cmsis-dap library
 
@@ -36,7 +37,10 @@ static int l_dap_help(lua_State *L)
 /* lua version of dap init */
 static int l_dap_init(lua_State *L)
 {
+    if (!swd_arbiter_take(SWD_USER_DAP))
+        return luaL_error(L, "swd busy");
     dap_init();
+    swd_arbiter_release(SWD_USER_DAP);
     return 0;
 }
 
@@ -53,7 +57,10 @@ static int l_dap_process_request(lua_State *L)
         return luaL_error(L, "Expected 64-byte string");
     }
 
+    if (!swd_arbiter_take(SWD_USER_DAP))
+        return luaL_error(L, "swd busy");
     uint32_t retval = dap_process_request((uint8_t *)app_request_buffer, DAP_PACKET_SIZE, app_response_buffer, DAP_PACKET_SIZE);
+    swd_arbiter_release(SWD_USER_DAP);
     lua_pushlstring(L, app_response_buffer, retval);
 
     return 1;
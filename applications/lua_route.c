@@ -0,0 +1,82 @@
+#include <rtthread.h>
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+
+#include "route.h"
+
+/* lua stream routing library. reads the lua sink, see route.h
+
+Example:
+msh />route serial0 usb,lua
+msh />lua
+> route.sink(function(s) io.write(s) end)
+> while true do route.poll(100) end
+
+*/
+
+#define ROUTE_SINK_KEY "route.sink" /* registry key of the sink function */
+
+static const char l_route_help_str[] = "\n\
+route.help()\n\
+route.sink(function(str))\n\
+route.poll([ms])\
+";
+
+static int l_route_help(lua_State *L)
+{
+    lua_pushboolean(L, 1);
+    lua_pushstring(L, l_route_help_str);
+    return 2;
+}
+
+/* set the function that gets the data of the lua sink, or nil */
+static int l_route_sink(lua_State *L)
+{
+    if (!lua_isnoneornil(L, 1))
+        luaL_checktype(L, 1, LUA_TFUNCTION);
+    lua_settop(L, 1);
+    lua_setfield(L, LUA_REGISTRYINDEX, ROUTE_SINK_KEY);
+    return 0;
+}
+
+/* wait up to ms for data, default 0, or forever if negative.
+   the sink function is called with the data, on this thread. returns the byte count */
+static int l_route_poll(lua_State *L)
+{
+    lua_Integer ms      = luaL_optinteger(L, 1, 0);
+    int32_t     timeout = ms < 0 ? RT_WAITING_FOREVER : rt_tick_from_millisecond(ms);
+    uint8_t     buf[128];
+    uint32_t    len;
+    lua_Integer total = 0;
+
+    lua_getfield(L, LUA_REGISTRYINDEX, ROUTE_SINK_KEY);
+    if (!lua_isfunction(L, -1))
+        return luaL_error(L, "no sink function");
+    lua_pop(L, 1);
+
+    while ((len = route_lua_read(buf, sizeof(buf), total ? 0 : timeout)) != 0)
+    {
+        lua_getfield(L, LUA_REGISTRYINDEX, ROUTE_SINK_KEY);
+        lua_pushlstring(L, (const char *)buf, len);
+        lua_call(L, 1, 0);
+        total += len;
+    }
+    lua_pushinteger(L, total);
+    return 1;
+}
+
+/* route library */
+static const struct luaL_Reg route_lib[] = {
+    {"help", l_route_help},
+    {"sink", l_route_sink},
+    {"poll", l_route_poll},
+    {  NULL,         NULL}
+};
+
+/* called from lua init, registers route library */
+int luaopen_route(lua_State *L)
+{
+    luaL_newlib(L, route_lib);
+    return 1;
+}
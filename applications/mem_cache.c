@@ -0,0 +1,437 @@
+/* black magic debug includes */
+#include "general.h"
+#include "target.h"
+#include "target_internal.h"
+#include "mem_cache.h"
+#include <rtthread.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+   target memory cache.
+
+   while the target is halted, gdb reads the same stack, vector table and variables
+   again after every step. this write-through cache keeps the last pages read, so only
+   the first read goes over swd.
+
+   the cache sits between the gdb server and the target: the linker sends calls to
+   target_mem32_read() and friends to the __wrap_ functions below, and these call the
+   black magic functions as __real_. see SConscript.
+
+   the cache is valid while the target is halted. it is emptied when the target
+   resumes, is reset, attached or detached, when flash is erased or written, when
+   a breakpoint is set or cleared, and when cmsis-dap takes the swd pins. writes update the cache. only regions of the target
+   memory map are cached, so peripherals never are. "mon memcache" shows the map and
+   the hit rate, and switches caching per region.
+
+   memory written by the target driver with target_mem32_write32() and the like does
+   not pass through here. dma that keeps running while the core is halted is not seen
+   either; switch caching off for that region.
+ */
+
+#define MEM_CACHE_PAGE_SIZE 64 /* power of two */
+#define MEM_CACHE_PAGES     32
+#define MEM_CACHE_REGIONS   32 /* regions that can be switched off */
+
+struct mem_cache_page
+{
+    bool          valid;
+    target_addr_t addr;
+    uint32_t      used; /* for least recently used */
+    uint8_t       data[MEM_CACHE_PAGE_SIZE];
+};
+
+static struct
+{
+    target_s             *target;   /* target the cache is for */
+    bool                  halted;   /* target halted, cache valid */
+    bool                  flashing; /* between flash write and flash complete */
+    uint32_t              uncached; /* bitmask of regions not cached */
+    uint32_t              clock;
+    struct mem_cache_page page[MEM_CACHE_PAGES];
+} mem_cache;
+
+static struct
+{
+    uint32_t hits;   /* pages found in cache */
+    uint32_t misses; /* pages read from target */
+    uint32_t bypass; /* reads not cached */
+    uint32_t writes; /* writes to cached pages */
+    uint32_t flush;  /* times the cache was emptied */
+} mem_cache_stats;
+
+bool                 __real_target_mem32_read(target_s *target, void *dest, target_addr32_t src, size_t len);
+bool                 __real_target_mem64_read(target_s *target, void *dest, target_addr64_t src, size_t len);
+bool                 __real_target_mem32_write(target_s *target, target_addr32_t dest, const void *src, size_t len);
+bool                 __real_target_mem64_write(target_s *target, target_addr64_t dest, const void *src, size_t len);
+target_s            *__real_target_attach_n(size_t n, target_controller_s *controller);
+target_s            *__real_target_attach(target_s *target, target_controller_s *controller);
+void                 __real_target_detach(target_s *target);
+void                 __real_target_reset(target_s *target);
+target_halt_reason_e __real_target_halt_poll(target_s *target, target_addr64_t *watch);
+void                 __real_target_halt_resume(target_s *target, bool step);
+bool                 __real_target_flash_erase(target_s *target, target_addr_t addr, size_t len);
+bool                 __real_target_flash_write(target_s *target, target_addr_t dest, const void *src, size_t len);
+bool                 __real_target_flash_complete(target_s *target);
+bool                 __real_target_flash_mass_erase(target_s *target);
+int                  __real_target_breakwatch_set(target_s *target, target_breakwatch_e type, target_addr_t addr, size_t len);
+int                  __real_target_breakwatch_clear(target_s *target, target_breakwatch_e type, target_addr_t addr, size_t len);
+
+static void mem_cache_flush()
+{
+    for (int i = 0; i < MEM_CACHE_PAGES; i++)
+        mem_cache.page[i].valid = false;
+    mem_cache_stats.flush++;
+}
+
+/* target stopped running or started running */
+static void mem_cache_halted(target_s *target, bool halted)
+{
+    if (target != mem_cache.target)
+        return;
+    if (halted != mem_cache.halted)
+        mem_cache_flush();
+    mem_cache.halted = halted;
+}
+
+void mem_cache_invalidate(void)
+{
+    mem_cache_halted(mem_cache.target, false);
+}
+
+/* memory map, ram first, then flash. returns region number, or -1 if addr not in map */
+static int mem_cache_region(target_s *target, target_addr_t addr, target_addr_t *start, target_addr_t *end)
+{
+    int region = 0;
+
+    for (target_ram_s *r = target->ram; r; r = r->next, region++)
+        if (addr >= r->start && addr - r->start < r->length)
+        {
+            *start = r->start;
+            *end   = r->start + r->length;
+            return region;
+        }
+    for (target_flash_s *f = target->flash; f; f = f->next, region++)
+        if (addr >= f->start && addr - f->start < f->length)
+        {
+            *start = f->start;
+            *end   = f->start + f->length;
+            return region;
+        }
+    return -1;
+}
+
+/* true if [addr, addr+len) may be cached. *start and *end are the region around it */
+static bool mem_cache_usable(target_s *target, target_addr64_t addr, size_t len, target_addr_t *start, target_addr_t *end)
+{
+    int region;
+
+    if (target != mem_cache.target || !mem_cache.halted || mem_cache.flashing || len == 0)
+        return false;
+    if (addr > UINT32_MAX || len > UINT32_MAX - addr)
+        return false;
+    region = mem_cache_region(target, addr, start, end);
+    if (region < 0 || addr + len > *end)
+        return false;
+    if (region < MEM_CACHE_REGIONS && (mem_cache.uncached & (1u << region)))
+        return false;
+    return true;
+}
+
+static struct mem_cache_page *mem_cache_find(target_addr_t addr)
+{
+    for (int i = 0; i < MEM_CACHE_PAGES; i++)
+        if (mem_cache.page[i].valid && mem_cache.page[i].addr == addr)
+            return &mem_cache.page[i];
+    return NULL;
+}
+
+static struct mem_cache_page *mem_cache_victim()
+{
+    struct mem_cache_page *victim = &mem_cache.page[0];
+
+    for (int i = 0; i < MEM_CACHE_PAGES; i++)
+    {
+        if (!mem_cache.page[i].valid)
+            return &mem_cache.page[i];
+        if (mem_cache.page[i].used < victim->used)
+            victim = &mem_cache.page[i];
+    }
+    return victim;
+}
+
+/* read through the cache. pages that stick out of the region are read directly.
+ * returns true on error, like target_mem32_read() */
+static bool mem_cache_read(target_s *target, uint8_t *dest, target_addr_t src, size_t len, target_addr_t start,
+                           target_addr_t end)
+{
+    struct mem_cache_page *page;
+    target_addr_t          base;
+    size_t                 offset, count;
+
+    while (len)
+    {
+        base   = src & ~(target_addr_t)(MEM_CACHE_PAGE_SIZE - 1);
+        offset = src - base;
+        count  = MEM_CACHE_PAGE_SIZE - offset;
+        if (count > len)
+            count = len;
+        if (base < start || base + MEM_CACHE_PAGE_SIZE > end)
+        {
+            mem_cache_stats.bypass++;
+            if (__real_target_mem32_read(target, dest, src, count))
+                return true;
+        }
+        else
+        {
+            page = mem_cache_find(base);
+            if (page)
+                mem_cache_stats.hits++;
+            else
+            {
+                mem_cache_stats.misses++;
+                page        = mem_cache_victim();
+                page->valid = false;
+                if (__real_target_mem32_read(target, page->data, base, MEM_CACHE_PAGE_SIZE))
+                    return true;
+                page->addr  = base;
+                page->valid = true;
+            }
+            page->used = ++mem_cache.clock;
+            memcpy(dest, &page->data[offset], count);
+        }
+        dest += count;
+        src += count;
+        len -= count;
+    }
+    return false;
+}
+
+/* write-through: update the pages the write touches */
+static void mem_cache_write(target_s *target, target_addr64_t dest, const uint8_t *src, size_t len, bool error)
+{
+    struct mem_cache_page *page;
+
+    if (target != mem_cache.target)
+        return;
+    if (error)
+    {
+        /* unknown how much was written */
+        mem_cache_flush();
+        return;
+    }
+    for (int i = 0; i < MEM_CACHE_PAGES; i++)
+    {
+        page = &mem_cache.page[i];
+        if (!page->valid || dest >= page->addr + MEM_CACHE_PAGE_SIZE || dest + len <= page->addr)
+            continue;
+        if (dest >= page->addr)
+            memcpy(&page->data[dest - page->addr], src,
+                   MIN(len, (size_t)(page->addr + MEM_CACHE_PAGE_SIZE - dest)));
+        else
+            memcpy(page->data, src + (page->addr - dest), MIN(MEM_CACHE_PAGE_SIZE, (size_t)(dest + len - page->addr)));
+        mem_cache_stats.writes++;
+    }
+}
+
+/* memory access */
+
+bool __wrap_target_mem32_read(target_s *target, void *dest, target_addr32_t src, size_t len)
+{
+    target_addr_t start, end;
+
+    if (!mem_cache_usable(target, src, len, &start, &end))
+    {
+        mem_cache_stats.bypass++;
+        return __real_target_mem32_read(target, dest, src, len);
+    }
+    return mem_cache_read(target, dest, src, len, start, end);
+}
+
+bool __wrap_target_mem64_read(target_s *target, void *dest, target_addr64_t src, size_t len)
+{
+    target_addr_t start, end;
+
+    if (!mem_cache_usable(target, src, len, &start, &end))
+    {
+        mem_cache_stats.bypass++;
+        return __real_target_mem64_read(target, dest, src, len);
+    }
+    return mem_cache_read(target, dest, src, len, start, end);
+}
+
+bool __wrap_target_mem32_write(target_s *target, target_addr32_t dest, const void *src, size_t len)
+{
+    bool error = __real_target_mem32_write(target, dest, src, len);
+    mem_cache_write(target, dest, src, len, error);
+    return error;
+}
+
+bool __wrap_target_mem64_write(target_s *target, target_addr64_t dest, const void *src, size_t len)
+{
+    bool error = __real_target_mem64_write(target, dest, src, len);
+    mem_cache_write(target, dest, src, len, error);
+    return error;
+}
+
+/* mon memcache [clear | REGION on|off] */
+
+static bool mem_cache_cmd(target_s *target, int argc, const char **argv)
+{
+    uint32_t lookups;
+    int      region = 0;
+
+    if (argc == 3)
+    {
+        region = atoi(argv[1]);
+        if (region < 0 || region >= MEM_CACHE_REGIONS)
+            return false;
+        if (!strcmp(argv[2], "on"))
+            mem_cache.uncached &= ~(1u << region);
+        else if (!strcmp(argv[2], "off"))
+            mem_cache.uncached |= 1u << region;
+        else
+            return false;
+        mem_cache_flush();
+        return true;
+    }
+    if (argc == 2 && strcmp(argv[1], "clear"))
+        return false;
+
+    for (target_ram_s *r = target->ram; r; r = r->next, region++)
+        tc_printf(target, "%2d ram   0x%08" PRIx32 " 0x%08" PRIx32 " %s\n", region, (uint32_t)r->start,
+                  (uint32_t)r->length, mem_cache.uncached & (1u << region) ? "off" : "on");
+    for (target_flash_s *f = target->flash; f; f = f->next, region++)
+        tc_printf(target, "%2d flash 0x%08" PRIx32 " 0x%08" PRIx32 " %s\n", region, (uint32_t)f->start,
+                  (uint32_t)f->length, mem_cache.uncached & (1u << region) ? "off" : "on");
+    lookups = mem_cache_stats.hits + mem_cache_stats.misses;
+    tc_printf(target, "%s, %d pages of %d bytes\n", mem_cache.halted ? "halted" : "running", MEM_CACHE_PAGES,
+              MEM_CACHE_PAGE_SIZE);
+    tc_printf(target, "hits %" PRIu32 " misses %" PRIu32 " hit rate %" PRIu32 "%% not cached %" PRIu32
+                      " writes %" PRIu32 " flushes %" PRIu32 "\n",
+              mem_cache_stats.hits, mem_cache_stats.misses,
+              lookups ? (uint32_t)((uint64_t)mem_cache_stats.hits * 100 / lookups) : 0, mem_cache_stats.bypass,
+              mem_cache_stats.writes, mem_cache_stats.flush);
+    if (argc == 2)
+        memset(&mem_cache_stats, 0, sizeof(mem_cache_stats));
+    return true;
+}
+
+static const command_s mem_cache_cmd_list[] = {
+    {"memcache", mem_cache_cmd, "Memory cache while halted: [clear | REGION on|off]"},
+    {      NULL,          NULL,                                                 NULL},
+};
+
+/* target state */
+
+static void mem_cache_attached(target_s *target)
+{
+    if (!target)
+        return;
+    if (target != mem_cache.target)
+        mem_cache.uncached = 0;
+    mem_cache.target   = target;
+    mem_cache.flashing = false;
+    mem_cache.halted   = false;
+    mem_cache_halted(target, true);
+    /* add "mon memcache" once */
+    for (target_command_s *cmd = target->commands; cmd; cmd = cmd->next)
+        if (cmd->cmds == mem_cache_cmd_list)
+            return;
+    target_add_commands(target, mem_cache_cmd_list, "memory cache");
+}
+
+target_s *__wrap_target_attach_n(size_t n, target_controller_s *controller)
+{
+    target_s *target = __real_target_attach_n(n, controller);
+    mem_cache_attached(target);
+    return target;
+}
+
+target_s *__wrap_target_attach(target_s *target, target_controller_s *controller)
+{
+    target_s *attached = __real_target_attach(target, controller);
+    mem_cache_attached(attached);
+    return attached;
+}
+
+void __wrap_target_detach(target_s *target)
+{
+    mem_cache_halted(target, false);
+    if (target == mem_cache.target)
+    {
+        mem_cache.target   = NULL;
+        mem_cache.flashing = false;
+    }
+    __real_target_detach(target);
+}
+
+void __wrap_target_reset(target_s *target)
+{
+    mem_cache_halted(target, false);
+    __real_target_reset(target);
+}
+
+target_halt_reason_e __wrap_target_halt_poll(target_s *target, target_addr64_t *watch)
+{
+    target_halt_reason_e reason = __real_target_halt_poll(target, watch);
+    mem_cache_halted(target, reason != TARGET_HALT_RUNNING && reason != TARGET_HALT_ERROR);
+    return reason;
+}
+
+void __wrap_target_halt_resume(target_s *target, bool step)
+{
+    mem_cache_halted(target, false);
+    __real_target_halt_resume(target, step);
+}
+
+/* flash */
+
+bool __wrap_target_flash_erase(target_s *target, target_addr_t addr, size_t len)
+{
+    mem_cache_flush();
+    mem_cache.flashing = true;
+    return __real_target_flash_erase(target, addr, len);
+}
+
+bool __wrap_target_flash_write(target_s *target, target_addr_t dest, const void *src, size_t len)
+{
+    mem_cache_flush();
+    mem_cache.flashing = true;
+    return __real_target_flash_write(target, dest, src, len);
+}
+
+bool __wrap_target_flash_complete(target_s *target)
+{
+    bool result = __real_target_flash_complete(target);
+    mem_cache.flashing = false;
+    mem_cache_halted(target, false);
+    return result;
+}
+
+bool __wrap_target_flash_mass_erase(target_s *target)
+{
+    bool result;
+
+    mem_cache.flashing = true;
+    mem_cache_flush();
+    result             = __real_target_flash_mass_erase(target);
+    mem_cache.flashing = false;
+    mem_cache_halted(target, false);
+    return result;
+}
+
+/* software breakpoints patch memory */
+
+int __wrap_target_breakwatch_set(target_s *target, target_breakwatch_e type, target_addr_t addr, size_t len)
+{
+    mem_cache_flush();
+    return __real_target_breakwatch_set(target, type, addr, len);
+}
+
+int __wrap_target_breakwatch_clear(target_s *target, target_breakwatch_e type, target_addr_t addr, size_t len)
+{
+    mem_cache_flush();
+    return __real_target_breakwatch_clear(target, type, addr, len);
+}
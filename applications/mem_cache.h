@@ -0,0 +1,13 @@
+#ifndef _MEM_CACHE_H
+#define _MEM_CACHE_H
+
+/*
+   target memory cache for the black magic gdb server, see mem_cache.c.
+ */
+
+/* empty the cache and treat the target as running until it halts again. for when the
+   swd pins go to cmsis-dap, whose host may write memory or resume the core.
+   call with the swd pins held, see swd_arbiter.h */
+void mem_cache_invalidate(void);
+
+#endif
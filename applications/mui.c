@@ -107,6 +107,48 @@ uint8_t mui_serial2_enable(mui_t *ui, uint8_t msg)
     return retval;
 }
 
+/* stream routing. the menu edits an option index, which is mapped to the sink bits in settings.route[] */
+
+static const uint8_t cdc1_input_sinks[] = {ROUTE_SINK_SERIAL0, ROUTE_SINK_SERIAL1, ROUTE_SINK_RTT, ROUTE_SINK_SLCAN};
+static uint8_t       mui_cdc1_input;
+static uint8_t       mui_route_output[ROUTE_SRC_CDC1];
+
+uint8_t mui_cdc1_route(mui_t *ui, uint8_t msg)
+{
+    uint8_t opt = 0;
+    for (uint32_t i = 0; i < sizeof(cdc1_input_sinks); i++)
+        if (settings.route[ROUTE_SRC_CDC1] & cdc1_input_sinks[i])
+        {
+            opt = i;
+            break;
+        }
+    mui_cdc1_input = opt;
+    uint8_t retval = mui_u8g2_u8_opt_line_wa_mud_pi(ui, msg);
+    if (mui_cdc1_input != opt)
+        settings.route[ROUTE_SRC_CDC1] = cdc1_input_sinks[mui_cdc1_input];
+    return retval;
+}
+
+/* option bit 0 is usb cdc1, bit 1 is log file. other sinks are kept. */
+uint8_t mui_output_route(mui_t *ui, uint8_t msg)
+{
+    uint8_t *opt   = (uint8_t *)muif_get_data(ui->uif);
+    uint32_t src   = opt - mui_route_output;
+    uint8_t  sinks = settings.route[src];
+    uint8_t  prev  = ((sinks & ROUTE_SINK_CDC1) ? 1 : 0) | ((sinks & ROUTE_SINK_LOG) ? 2 : 0);
+
+    *opt           = prev;
+    uint8_t retval = mui_u8g2_u8_opt_line_wa_mud_pi(ui, msg);
+    if (*opt != prev)
+    {
+        sinks &= ~(ROUTE_SINK_CDC1 | ROUTE_SINK_LOG);
+        if (*opt & 1) sinks |= ROUTE_SINK_CDC1;
+        if (*opt & 2) sinks |= ROUTE_SINK_LOG;
+        settings.route[src] = sinks;
+    }
+    return retval;
+}
+
 uint8_t mui_serial0_swap_pins(mui_t *ui, uint8_t msg)
 {
     uint8_t retval = mui_u8g2_u8_chkbox_wm_pi(ui, msg);
@@ -233,6 +275,63 @@ uint8_t mui_memory_info(mui_t *ui, uint8_t msg)
     return 0;
 }
 
+/* stream monitor. the tail sink is read while the monitor form is shown */
+
+#define MUI_MONITOR_FORM  23
+#define MUI_MONITOR_LINES 6
+#define MUI_MONITOR_COLS  16 /* 8 pixel wide font */
+
+static char     mui_monitor_text[MUI_MONITOR_LINES][MUI_MONITOR_COLS + 1];
+static uint32_t mui_monitor_line; /* line being filled */
+static uint32_t mui_monitor_col;
+
+static void mui_monitor_newline()
+{
+    mui_monitor_line                      = (mui_monitor_line + 1) % MUI_MONITOR_LINES;
+    mui_monitor_col                       = 0;
+    mui_monitor_text[mui_monitor_line][0] = '\0';
+}
+
+/* true if there was new data */
+static bool mui_monitor_read()
+{
+    uint8_t  buf[64];
+    uint32_t len;
+    bool     changed = false;
+
+    while ((len = route_tail_read(buf, sizeof(buf))) != 0)
+    {
+        changed = true;
+        for (uint32_t i = 0; i < len; i++)
+        {
+            if (buf[i] == '\n')
+            {
+                mui_monitor_newline();
+                continue;
+            }
+            if (buf[i] == '\r')
+                continue;
+            if (mui_monitor_col == MUI_MONITOR_COLS)
+                mui_monitor_newline();
+            mui_monitor_text[mui_monitor_line][mui_monitor_col++] = (buf[i] >= ' ' && buf[i] < 0x7f) ? buf[i] : '.';
+            mui_monitor_text[mui_monitor_line][mui_monitor_col]   = '\0';
+        }
+    }
+    return changed;
+}
+
+/* oldest line at the top */
+uint8_t mui_monitor(mui_t *ui, uint8_t msg)
+{
+    if (msg == MUIF_MSG_DRAW)
+    {
+        for (uint32_t i = 0; i < MUI_MONITOR_LINES; i++)
+            u8g2_DrawStr(&u8g2, mui_get_x(ui), mui_get_y(ui) + 16 * i,
+                         mui_monitor_text[(mui_monitor_line + 1 + i) % MUI_MONITOR_LINES]);
+    }
+    return 0;
+}
+
 uint8_t mui_status(mui_t *ui, uint8_t msg)
 {
     if (msg == MUIF_MSG_DRAW)
@@ -285,13 +384,20 @@ muif_t muif_list[] = {
     /* canbus slcan output enable */
     MUIF_VARIABLE("C1", &settings.can1_slcan, mui_u8g2_u8_chkbox_wm_pi),
     /* from usb cdc1 to target */
-    MUIF_VARIABLE("U1", &settings.cdc1_output, mui_u8g2_u8_opt_line_wa_mud_pi),
+    MUIF_VARIABLE("U1", &mui_cdc1_input, mui_cdc1_route),
     /* from serial0 to usb cdc1 */
     MUIF_VARIABLE("U2", &settings.serial0_enable, mui_serial0_enable),
     /* from serial1 to usb cdc1 */
     MUIF_VARIABLE("U3", &settings.serial1_enable, mui_serial1_enable),
     /* from serial2 to usb cdc1 */
     MUIF_VARIABLE("U4", &settings.serial2_enable, mui_serial2_enable),
+    /* stream sources to usb cdc1 and log file */
+    MUIF_VARIABLE("R0", &mui_route_output[ROUTE_SRC_SERIAL0], mui_output_route),
+    MUIF_VARIABLE("R1", &mui_route_output[ROUTE_SRC_SERIAL1], mui_output_route),
+    MUIF_VARIABLE("R2", &mui_route_output[ROUTE_SRC_SERIAL2], mui_output_route),
+    MUIF_VARIABLE("R3", &mui_route_output[ROUTE_SRC_SWO], mui_output_route),
+    MUIF_VARIABLE("R4", &mui_route_output[ROUTE_SRC_RTT], mui_output_route),
+    MUIF_VARIABLE("R5", &mui_route_output[ROUTE_SRC_CAN], mui_output_route),
     /* user interface language */
     MUIF_VARIABLE("D0", &settings.language, mui_u8g2_u8_opt_line_wa_mud_pi),
     /* display brightness */
@@ -320,6 +426,8 @@ muif_t muif_list[] = {
     MUIF_RO("XE", mui_memory_info),
     /* print status line */
     MUIF_RO("XF", mui_status),
+    /* print tail sink */
+    MUIF_RO("XG", mui_monitor),
     /* date and time */
     MUIF_U8G2_U8_MIN_MAX("Y0", &mui_year, 0, 99, mui_u8g2_u8_min_max_wm_mud_pi),
     MUIF_U8G2_U8_MIN_MAX("Y1", &mui_month, 1, 12, mui_u8g2_u8_min_max_wm_mud_pi),
@@ -405,6 +513,8 @@ static void mui_loop()
     default:
         break;
     }
+    if (mui_GetCurrentFormId(&mui) == MUI_MONITOR_FORM && mui_monitor_read())
+        is_redraw = 1;
     /* check whether the menu is active */
     if (mui_IsFormActive(&mui))
     {
@@ -22,6 +22,8 @@
 
 #define USB_CDC1_INPUT "serial0|serial1|    rtt|   can1"
 
+#define ROUTE_OUTPUT " off| usb| log|both"
+
 /*
 8 lines per screen. 16 pixels per line.
 top line: title and status.
@@ -108,6 +110,7 @@ MUI_XYAT("S2", 63, 63, 0, SERIAL_SPEEDS)
 MUI_LABEL(0, 79, "serial2")
 MUI_XYAT("S3", 63, 79, 0, SERIAL_SPEEDS)
 MUI_GOTO(0, 95, 21, "Serial Enable")
+MUI_GOTO(0, 111, 22, "Routing")
 MUI_XYT("BK", 0, 127, "Back")
 
 /* serials enable */
@@ -124,6 +127,32 @@ MUI_LABEL(0, 79, "swo decode")
 MUI_XY("S4", 107, 79)
 MUI_LABEL(0, 95, "swap rxd txd")
 MUI_XY("S5", 107, 95)
+MUI_GOTO(0, 111, 23, "Monitor")
+MUI_XYT("BK", 0, 127, "Back")
+
+/* stream routing to usb cdc1 and log file */
+MUI_FORM(22)
+MUI_STYLE(0)
+MUI_LABEL(0, 15, "ROUTING")
+MUI_LABEL(0, 31, "serial0")
+MUI_XYAT("R0", 87, 31, 0, ROUTE_OUTPUT)
+MUI_LABEL(0, 47, "serial1")
+MUI_XYAT("R1", 87, 47, 0, ROUTE_OUTPUT)
+MUI_LABEL(0, 63, "serial2")
+MUI_XYAT("R2", 87, 63, 0, ROUTE_OUTPUT)
+MUI_LABEL(0, 79, "swo")
+MUI_XYAT("R3", 87, 79, 0, ROUTE_OUTPUT)
+MUI_LABEL(0, 95, "rtt")
+MUI_XYAT("R4", 87, 95, 0, ROUTE_OUTPUT)
+MUI_LABEL(0, 111, "can1")
+MUI_XYAT("R5", 87, 111, 0, ROUTE_OUTPUT)
+MUI_XYT("BK", 0, 127, "Back")
+
+/* stream monitor. shows the sources routed to the tail sink */
+MUI_FORM(23)
+MUI_STYLE(0)
+MUI_LABEL(0, 15, "MONITOR")
+MUI_XY("XG", 0, 31)
 MUI_XYT("BK", 0, 127, "Back")
 
 /* canbus */
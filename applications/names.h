@@ -0,0 +1,16 @@
+#ifndef _NAMES_H_
+#define _NAMES_H_
+
+#include <stdint.h>
+#include <string.h>
+
+/* index of name in names[0 .. num-1], or -1. for shell command arguments */
+static inline int32_t find_name(const char *const *names, uint32_t num, const char *name)
+{
+    for (uint32_t i = 0; i < num; i++)
+        if (!strcmp(names[i], name))
+            return i;
+    return -1;
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include "general.h"
 #include "platform.h"
+#include "adiv5.h"
 #include "settings.h"
 #include "serials.h"
 #include <rtthread.h>
@@ -9,6 +10,7 @@
 #include <rtdbg.h>
 
 #include "usb_cdc.h"
+#include "route.h"
 
 #define ADC_DEV_NAME    "adc1" /* ADC device name */
 #define ADC_VIO_CHANNEL 13     /* ADC target voltage channel */
@@ -202,7 +204,7 @@ uint8_t platform_spi_xfer(const spi_bus_e bus, const uint8_t value)
 
 void debug_serial_send_stdout(const uint8_t * const data, const size_t len)
 {
-    cdc1_write((uint8_t *)data, len);
+    route_write(ROUTE_SRC_SWO, (uint8_t *)data, len);
 }
 
 size_t debug_serial_debug_write(const char *buf, const size_t len)
@@ -230,6 +232,16 @@ void swdptap_platform_init()
     serial0_enable(settings.serial0_enable);
 }
 
+/* the swd pins are back from cmsis-dap, see swd_arbiter.c. swdptap drives swdio between
+ * transfers, and the line gets idle cycles before the next request. not a line reset: after
+ * one the dp only answers a DPIDR read, and bmd would not know to do that */
+void swdptap_platform_resume()
+{
+    SWDIO_MODE_DRIVE();
+    if (swd_proc.seq_out) /* set up by the first scan */
+        swd_proc.seq_out(0, 8);
+}
+
 void jtagtap_platform_init()
 {
     /* in jtag mode TDO and TDI are GPIO pins */
@@ -35,9 +35,10 @@ extern bool running_status;
  clock_test 14300 produces 1 kHz
 
  These are the speeds when using rt_pin_write().
- Higher speeds are possible writing to registers directly.
+ Unless USE_SLOW_GPIO is defined, platform_gpio.h replaces rt_pin_write() with single stores
+ to the GPIOA set/clear register, and free-dap writes clock low and data in one store.
+ Use "swclk_test" to measure the resulting SWCLK frequency and SWD word rate.
 
- TODO: writes to target by gpio register access.
  ? optimize writing to target using dma to gpio. (ST AN4666, Artery AN0123)
  */
 
@@ -163,6 +164,7 @@ extern bool running_status;
 #define JTAGTAP_PLATFORM_INIT
 
 void swdptap_platform_init();
+void swdptap_platform_resume();
 void jtagtap_platform_init();
 
 void target_power_enable(bool on_off);
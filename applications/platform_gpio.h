@@ -4,8 +4,7 @@
 /* speed optimized gpio, direct to hardware registers */
 
 /* GPIO Register Definitions */
-#define REG_GPIOA_CLEAR (*((volatile uint32_t *)0x4002001A)) /* Bit clear register */
-#define REG_GPIOA_SET   (*((volatile uint32_t *)0x40020018)) /* Bit set register */
+#define REG_GPIOA_SET   (*((volatile uint32_t *)0x40020018)) /* Bit set (bits 0-15) and clear (bits 16-31) */
 #define REG_GPIOA_IDT   (*((volatile uint32_t *)0x40020010)) /* Input status */
 #define REG_GPIOA_CFGR  (*((volatile uint32_t *)0x40020000)) /* Configuration low */
 
@@ -25,36 +24,33 @@
 
 /* GPIO Mode Configuration */
 /* Assumes the pin is in MODE_INPUT or MODE_OUTPUT */
-static inline void GPIOA_OUTPUT(uint32_t pin)
+__attribute__((always_inline)) static inline void GPIOA_OUTPUT(uint32_t pin)
 {
     REG_GPIOA_CFGR = REG_GPIOA_CFGR & ~((uint32_t)0x3 << (pin * 2)) | ((uint32_t)0x1 << (pin * 2));
 }
 
-static inline void GPIOA_INPUT(uint32_t pin)
+__attribute__((always_inline)) static inline void GPIOA_INPUT(uint32_t pin)
 {
     REG_GPIOA_CFGR &= ~((uint32_t)0x3 << (pin * 2));
 }
 
 /* GPIO Access Functions */
-static inline void GPIOA_SET(uint32_t pin)
+__attribute__((always_inline)) static inline void GPIOA_SET(uint32_t pin)
 {
     REG_GPIOA_SET = (1U << pin);
 }
 
-static inline void GPIOA_CLEAR(uint32_t pin)
+__attribute__((always_inline)) static inline void GPIOA_CLEAR(uint32_t pin)
 {
-    REG_GPIOA_CLEAR = (1U << pin);
+    REG_GPIOA_SET = (1U << (pin + 16));
 }
 
-static inline void GPIOA_WRITE(uint32_t pin, int value)
+__attribute__((always_inline)) static inline void GPIOA_WRITE(uint32_t pin, int value)
 {
-    if (value)
-        REG_GPIOA_SET = (1U << pin);
-    else
-        REG_GPIOA_CLEAR = (1U << pin);
+    REG_GPIOA_SET = value ? (1U << pin) : (1U << (pin + 16));
 }
 
-static inline int GPIOA_READ(uint32_t pin)
+__attribute__((always_inline)) static inline int GPIOA_READ(uint32_t pin)
 {
     return (REG_GPIOA_IDT & (1U << pin)) != 0;
 }
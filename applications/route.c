@@ -0,0 +1,304 @@
+#include <rtthread.h>
+#include <string.h>
+#include "route.h"
+#include "settings.h"
+#include "usb_cdc.h"
+#include "usb_slcan.h"
+#include "serials.h"
+#include "logger.h"
+#include "spsc_rb.h"
+#include "names.h"
+
+#define DBG_TAG "ROUTE"
+#define DBG_LVL DBG_INFO
+#include <rtdbg.h>
+
+#define ROUTE_TAIL_SIZE 1024 /* power of two */
+#define ROUTE_LUA_SIZE  1024 /* power of two */
+
+static uint32_t route_bytes[ROUTE_SRC_NUM];
+
+/* the source each sink feeds back into, through the target or slcan replies, or -1 */
+static const int8_t route_sink_src[ROUTE_SINK_NUM] = {
+    -1, -1, -1, ROUTE_SRC_SERIAL0, ROUTE_SRC_SERIAL1, ROUTE_SRC_RTT, ROUTE_SRC_CAN, -1};
+
+/* slcan_process() keeps parser state, and is reached from every source thread */
+static struct rt_mutex route_slcan_lock;
+static rt_thread_t     route_slcan_owner;
+
+/* tail sink. producers serialized in route_tail_write(), consumer route_tail_read() */
+static uint8_t        route_tail_buf[ROUTE_TAIL_SIZE];
+static struct spsc_rb route_tail_rb = {route_tail_buf, sizeof(route_tail_buf), 0, 0};
+
+/* lua sink. producers serialized in route_lua_write(), consumer route_lua_read() */
+static uint8_t             route_lua_buf[ROUTE_LUA_SIZE];
+static struct spsc_rb      route_lua_rb = {route_lua_buf, sizeof(route_lua_buf), 0, 0};
+static struct rt_semaphore route_lua_sem; /* released after each write */
+
+/* sinks **********************************************************************/
+
+static void route_log_write(uint8_t *buf, uint32_t len)
+{
+    if (settings.logging_enable)
+        logger((char *)buf, len);
+}
+
+/* bytes are dropped when the tail buffer is full, until it is read */
+static void route_tail_write(uint8_t *buf, uint32_t len)
+{
+    rt_enter_critical();
+    spsc_rb_put(&route_tail_rb, buf, len);
+    rt_exit_critical();
+}
+
+/* as the tail sink. wakes the lua thread waiting in route_lua_read() */
+static void route_lua_write(uint8_t *buf, uint32_t len)
+{
+    rt_enter_critical();
+    spsc_rb_put(&route_lua_rb, buf, len);
+    rt_exit_critical();
+    rt_sem_release(&route_lua_sem);
+}
+
+static void route_serial0_write(uint8_t *buf, uint32_t len)
+{
+    if (settings.serial0_enable)
+        serial0_write(buf, len);
+}
+
+static void route_serial1_write(uint8_t *buf, uint32_t len)
+{
+    if (settings.serial1_enable)
+        serial1_write(buf, len);
+}
+
+/* rtt_read() is the producer side of an spsc ring; serialized like the tail sink */
+static void route_rtt_write(uint8_t *buf, uint32_t len)
+{
+    if (!settings.rtt_enable)
+        return;
+    rt_enter_critical();
+    rtt_read(buf, len);
+    rt_exit_critical();
+}
+
+/* one source at a time. slcan replies go out as the can source; if that is routed
+ * back into slcan, the reply is dropped instead of parsed again */
+static void route_slcan_write(uint8_t *buf, uint32_t len)
+{
+    if (!settings.can1_slcan || route_slcan_owner == rt_thread_self())
+        return;
+    rt_mutex_take(&route_slcan_lock, RT_WAITING_FOREVER);
+    route_slcan_owner = rt_thread_self();
+    slcan_process(buf, len);
+    route_slcan_owner = RT_NULL;
+    rt_mutex_release(&route_slcan_lock);
+}
+
+/* in the same order as the ROUTE_SINK_* bits */
+static void (*const route_sink_fn[ROUTE_SINK_NUM])(uint8_t *buf, uint32_t len) = {
+    cdc1_write,
+    route_log_write,
+    route_tail_write,
+    route_serial0_write,
+    route_serial1_write,
+    route_rtt_write,
+    route_slcan_write,
+    route_lua_write,
+};
+
+static void route_dispatch(uint32_t sinks, uint8_t *buf, uint32_t len)
+{
+    for (uint32_t i = 0; sinks != 0; i++, sinks >>= 1)
+        if (sinks & 1)
+            route_sink_fn[i](buf, len);
+}
+
+/* api ************************************************************************/
+
+static int route_init()
+{
+    rt_mutex_init(&route_slcan_lock, "slcan", RT_IPC_FLAG_PRIO);
+    rt_sem_init(&route_lua_sem, "route", 0, RT_IPC_FLAG_PRIO);
+    return RT_EOK;
+}
+
+INIT_DEVICE_EXPORT(route_init);
+
+/* sources reachable in one step from the sources in srcs */
+static uint32_t route_next(const uint8_t *route, uint32_t srcs)
+{
+    uint32_t next = 0;
+
+    for (uint32_t src = 0; src < ROUTE_SRC_NUM; src++)
+        if (srcs & (1 << src))
+            for (uint32_t i = 0; i < ROUTE_SINK_NUM; i++)
+                if ((route[src] & (1 << i)) && route_sink_src[i] >= 0)
+                    next |= 1 << route_sink_src[i];
+    return next;
+}
+
+bool route_loop(const uint8_t *route)
+{
+    uint32_t reach, next;
+
+    for (uint32_t src = 0; src < ROUTE_SRC_NUM; src++)
+    {
+        reach = 0;
+        next  = route_next(route, 1 << src);
+        while (next & ~reach)
+        {
+            reach |= next;
+            next = route_next(route, reach);
+        }
+        if (reach & (1 << src))
+            return true;
+    }
+    return false;
+}
+
+void route_write(uint32_t src, uint8_t *buf, uint32_t len)
+{
+    if (src >= ROUTE_SRC_NUM || buf == RT_NULL || len == 0) return;
+    route_bytes[src] += len;
+    route_dispatch(settings.route[src], buf, len);
+}
+
+/* read from tail sink. one reader at a time. */
+uint32_t route_tail_read(uint8_t *buf, uint32_t len)
+{
+    return spsc_rb_get(&route_tail_rb, buf, len);
+}
+
+/* read from lua sink. one reader at a time. 0 if no data before the timeout */
+uint32_t route_lua_read(uint8_t *buf, uint32_t len, int32_t timeout)
+{
+    uint32_t n;
+
+    while ((n = spsc_rb_get(&route_lua_rb, buf, len)) == 0)
+        if (rt_sem_take(&route_lua_sem, timeout) != RT_EOK)
+            return 0;
+    return n;
+}
+
+#ifdef RT_USING_FINSH
+static const char *const route_src_name[ROUTE_SRC_NUM] = {
+    "serial0", "serial1", "serial2", "swo", "rtt", "can", "usb"};
+
+static const char *const route_sink_name[ROUTE_SINK_NUM] = {
+    "usb", "log", "tail", "serial0", "serial1", "rtt", "slcan", "lua"};
+
+static void print_routes()
+{
+    rt_kprintf("source  bytes      sinks\r\n");
+    for (uint32_t src = 0; src < ROUTE_SRC_NUM; src++)
+    {
+        rt_kprintf("%-7s %-10u", route_src_name[src], route_bytes[src]);
+        for (uint32_t i = 0; i < ROUTE_SINK_NUM; i++)
+            if (settings.route[src] & (1 << i))
+                rt_kprintf(" %s", route_sink_name[i]);
+        rt_kprintf("\r\n");
+    }
+}
+
+/* parse comma-separated list of sinks, or "none" */
+static int32_t parse_sinks(char *list)
+{
+    uint32_t sinks = 0;
+    char    *name;
+    char    *save;
+
+    if (!strcmp(list, "none")) return 0;
+    for (name = strtok_r(list, ",", &save); name; name = strtok_r(RT_NULL, ",", &save))
+    {
+        int32_t i = find_name(route_sink_name, ROUTE_SINK_NUM, name);
+        if (i < 0)
+        {
+            rt_kprintf("unknown sink %s\r\n", name);
+            return -1;
+        }
+        sinks |= 1 << i;
+    }
+    return sinks;
+}
+
+static void print_tail()
+{
+    uint8_t  buf[64];
+    uint32_t len;
+
+    while ((len = route_tail_read(buf, sizeof(buf))) != 0)
+        rt_kprintf("%.*s", len, buf);
+    rt_kprintf("\r\n");
+}
+
+/* time per route_write() call, with no sinks and with the tail sink */
+#define BENCH_CALLS 100000
+#define BENCH_LEN   64
+
+static uint32_t bench_dispatch(uint32_t sinks)
+{
+    uint8_t   buf[BENCH_LEN];
+    rt_tick_t start;
+
+    memset(buf, 'x', sizeof(buf));
+    start = rt_tick_get();
+    for (uint32_t i = 0; i < BENCH_CALLS; i++)
+    {
+        route_dispatch(sinks, buf, sizeof(buf));
+        if (sinks & ROUTE_SINK_TAIL)
+            route_tail_read(buf, sizeof(buf));
+    }
+    return rt_tick_get() - start;
+}
+
+static void print_bench(const char *name, uint32_t ticks)
+{
+    /* nanoseconds per call */
+    uint64_t ns = (uint64_t)ticks * 1000000000 / RT_TICK_PER_SECOND / BENCH_CALLS;
+    rt_kprintf("%-6s %6u ns per %d byte write\r\n", name, (uint32_t)ns, BENCH_LEN);
+}
+
+static int cmd_route(int argc, char **argv)
+{
+    int32_t src, sinks;
+
+    if (argc == 1)
+        print_routes();
+    else if (argc == 2 && !strcmp(argv[1], "tail"))
+        print_tail();
+    else if (argc == 2 && !strcmp(argv[1], "bench"))
+    {
+        print_bench("none", bench_dispatch(0));
+        print_bench("tail", bench_dispatch(ROUTE_SINK_TAIL));
+    }
+    else if (argc == 3 && (src = find_name(route_src_name, ROUTE_SRC_NUM, argv[1])) >= 0)
+    {
+        uint8_t route[ROUTE_SRC_NUM];
+
+        sinks = parse_sinks(argv[2]);
+        if (sinks < 0) return -RT_ERROR;
+        memcpy(route, settings.route, sizeof(route));
+        route[src] = sinks;
+        if (route_loop(route))
+        {
+            rt_kprintf("%s would loop back into %s\r\n", argv[2], argv[1]);
+            return -RT_ERROR;
+        }
+        settings.route[src] = sinks;
+        print_routes();
+    }
+    else
+    {
+        rt_kprintf("%s                    print routes\r\n", argv[0]);
+        rt_kprintf("%s source sink[,sink] set route, or none. settings write to save\r\n", argv[0]);
+        rt_kprintf("%s tail               print tail buffer\r\n", argv[0]);
+        rt_kprintf("%s bench              time per write\r\n", argv[0]);
+        rt_kprintf("sources: serial0 serial1 serial2 swo rtt can usb\r\n");
+        rt_kprintf("sinks: usb log tail serial0 serial1 rtt slcan lua\r\n");
+    }
+    return RT_EOK;
+}
+
+MSH_CMD_EXPORT_ALIAS(cmd_route, route, stream routing);
+#endif
@@ -0,0 +1,50 @@
+#ifndef _ROUTE_H_
+#define _ROUTE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * stream routing matrix.
+ * every source has a bitmask of sinks, stored in settings.route[].
+ * route_write() passes the source buffer to each sink in turn, without copying.
+ * all sinks consume the data before returning, so the buffer stays owned by the source.
+ * sinks that keep state are serialized, as sources run in different threads.
+ * the display monitor reads the tail sink with route_tail_read().
+ * lua scripts read the lua sink with route.poll(), which calls the function set with
+ * route.sink() on the lua thread. see lua_route.c
+ */
+
+/* sources */
+#define ROUTE_SRC_SERIAL0 0 /* target serial0 receive */
+#define ROUTE_SRC_SERIAL1 1 /* target serial1 receive */
+#define ROUTE_SRC_SERIAL2 2 /* target serial2 receive, if not swo decoding */
+#define ROUTE_SRC_SWO     3 /* swo decoder and semihosting output */
+#define ROUTE_SRC_RTT     4 /* rtt target to host */
+#define ROUTE_SRC_CAN     5 /* slcan replies */
+#define ROUTE_SRC_CDC1    6 /* usb cdc1 host to target */
+#define ROUTE_SRC_NUM     7
+
+/* sinks */
+#define ROUTE_SINK_CDC1    (1 << 0) /* usb cdc1 to host */
+#define ROUTE_SINK_LOG     (1 << 1) /* log file on sd card */
+#define ROUTE_SINK_TAIL    (1 << 2) /* memory buffer, for the display monitor */
+#define ROUTE_SINK_SERIAL0 (1 << 3) /* target serial0 transmit */
+#define ROUTE_SINK_SERIAL1 (1 << 4) /* target serial1 transmit */
+#define ROUTE_SINK_RTT     (1 << 5) /* rtt host to target */
+#define ROUTE_SINK_SLCAN   (1 << 6) /* slcan commands */
+#define ROUTE_SINK_LUA     (1 << 7) /* memory buffer, for lua scripts */
+#define ROUTE_SINK_NUM     8
+
+#define ROUTE_DEFAULT_OUTPUT (ROUTE_SINK_CDC1 | ROUTE_SINK_LOG)
+#define ROUTE_DEFAULT_INPUT  ROUTE_SINK_SERIAL0
+
+void     route_write(uint32_t src, uint8_t *buf, uint32_t len);
+/* true if a source feeds back into itself: routed to its own serial or rtt sink,
+ * can routed to slcan, or a longer loop through the target */
+bool     route_loop(const uint8_t *route);
+uint32_t route_tail_read(uint8_t *buf, uint32_t len);
+/* waits up to timeout ticks for data */
+uint32_t route_lua_read(uint8_t *buf, uint32_t len, int32_t timeout);
+
+#endif
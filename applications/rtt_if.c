@@ -15,26 +15,27 @@
 #include "rtt_if.h"
 #include "usb_desc.h"
 #include "usb_cdc.h"
+#include "spsc_rb.h"
+#include "route.h"
 
-#define RTT_READ_BUF_SIZE 80
+#define RTT_READ_BUF_SIZE 128 /* power of two */
 
-static struct rt_ringbuffer *rtt_read_rb = RT_NULL;
+/* producer cdc1_out_thread, consumer gdb server rtt poll */
+static uint8_t        rtt_read_buf[RTT_READ_BUF_SIZE];
+static struct spsc_rb rtt_read_rb = {rtt_read_buf, sizeof(rtt_read_buf), 0, 0};
 
 /* from usb to rtt */
 int32_t rtt_read(uint8_t *buf, uint32_t len)
 {
-    if (rtt_read_rb == RT_NULL)
-        rtt_read_rb = rt_ringbuffer_create(RTT_READ_BUF_SIZE);
-
-    return rt_ringbuffer_put(rtt_read_rb, buf, len);
+    return spsc_rb_put(&rtt_read_rb, buf, len);
 }
 
 /* rtt host to target: read one character */
 int32_t rtt_getchar(const uint32_t channel)
 {
-    char ch;
+    uint8_t ch;
 
-    if (channel == 0 && rtt_read_rb && rt_ringbuffer_getchar(rtt_read_rb, &ch))
+    if (channel == 0 && spsc_rb_getchar(&rtt_read_rb, &ch))
         return ch;
     return -1;
 }
@@ -42,14 +43,14 @@ int32_t rtt_getchar(const uint32_t channel)
 /* rtt host to target: true if no characters available for reading */
 bool rtt_nodata(const uint32_t channel)
 {
-    if (channel == 0 && rtt_read_rb)
-        return rt_ringbuffer_data_len(rtt_read_rb) == 0;
+    if (channel == 0)
+        return spsc_rb_data_len(&rtt_read_rb) == 0;
     return true;
 }
 
 /* rtt target to host: write string */
 uint32_t rtt_write(const uint32_t channel, const char *buf, uint32_t len)
 {
-    cdc1_write((uint8_t *)buf, len);
+    route_write(ROUTE_SRC_RTT, (uint8_t *)buf, len);
     return len;
 }
@@ -1,18 +1,17 @@
 #include <rtthread.h>
+#include <board.h>
 #include "platform.h"
 #include "usb_cdc.h"
 #include "serials.h"
 #include "settings.h"
 #include "swo.h"
+#include "route.h"
+#include "swo_capture.h"
 
 #define DBG_TAG "UART"
 #define DBG_LVL DBG_INFO
 #include <rtdbg.h>
 
-/* uart will run at any baud rate between 1647 bit/s and 6750000 bit/s */
-#define BAUD_MIN 1647
-#define BAUD_MAX 6750000
-
 #define SERIAL_RX_STACK    1024
 #define SERIAL_RX_PRIORITY 25
 
@@ -159,6 +158,7 @@ void serial0_swap_pins(bool swap_pins)
 }
 
 /* serial0 receive interrupt handler */
+AT32_RAMFUNC
 static rt_err_t serial0_rx_cb(rt_device_t dev, rt_size_t size)
 {
     if (serial0_rx_sem)
@@ -167,6 +167,7 @@ static rt_err_t serial0_rx_cb(rt_device_t dev, rt_size_t size)
 }
 
 /* serial1 receive interrupt handler */
+AT32_RAMFUNC
 static rt_err_t serial1_rx_cb(rt_device_t dev, rt_size_t size)
 {
     if (serial1_rx_sem)
@@ -175,6 +176,7 @@ static rt_err_t serial1_rx_cb(rt_device_t dev, rt_size_t size)
 }
 
 /* serial2 receive interrupt handler */
+AT32_RAMFUNC
 static rt_err_t serial2_rx_cb(rt_device_t dev, rt_size_t size)
 {
     if (serial2_rx_sem)
@@ -182,7 +184,7 @@ static rt_err_t serial2_rx_cb(rt_device_t dev, rt_size_t size)
     return RT_EOK;
 }
 
-/* input from serial0 to usb cdc1 */
+/* input from serial0, routed to usb cdc1 by default */
 static void serial0_rx_thread(void *parameter)
 {
     (void)parameter;
@@ -196,7 +198,7 @@ static void serial0_rx_thread(void *parameter)
             while (len = rt_device_read(serial0_dev, 0, serial0_rx_buf, sizeof(serial0_rx_buf)))
             {
                 LOG_D("serial0 rx %*.s", len, serial0_rx_buf);
-                cdc1_write(serial0_rx_buf, len);
+                route_write(ROUTE_SRC_SERIAL0, serial0_rx_buf, len);
 #if 0
                 serial0_write(serial0_rx_buf, len); /* echo for debugging */
 #endif
@@ -205,7 +207,7 @@ static void serial0_rx_thread(void *parameter)
     }
 }
 
-/* input from serial1 to usb cdc1 */
+/* input from serial1, routed to usb cdc1 by default */
 static void serial1_rx_thread(void *parameter)
 {
     (void)parameter;
@@ -219,7 +221,7 @@ static void serial1_rx_thread(void *parameter)
             while (len = rt_device_read(serial1_dev, 0, serial1_rx_buf, sizeof(serial1_rx_buf)))
             {
                 LOG_D("serial1 rx %*.s", len, serial1_rx_buf);
-                cdc1_write(serial1_rx_buf, len);
+                route_write(ROUTE_SRC_SERIAL1, serial1_rx_buf, len);
 #if 0
                 serial1_write(serial1_rx_buf, len); /* echo for debugging */
 #endif
@@ -228,7 +230,7 @@ static void serial1_rx_thread(void *parameter)
     }
 }
 
-/* input from serial2 to usb cdc1 */
+/* input from serial2, routed to usb cdc1 by default, or captured for cmsis-dap swo */
 static void serial2_rx_thread(void *parameter)
 {
     (void)parameter;
@@ -242,10 +244,12 @@ static void serial2_rx_thread(void *parameter)
             while (len = rt_device_read(serial2_dev, 0, serial2_rx_buf, sizeof(serial2_rx_buf)))
             {
                 LOG_D("serial2 rx %*.s", len, serial2_rx_buf);
-                if (settings.swo_decode)
+                if (swo_capture_active())
+                    swo_capture_write(serial2_rx_buf, len);
+                else if (settings.swo_decode)
                     swo_itm_decode(serial2_rx_buf, len);
                 else
-                    cdc1_write(serial2_rx_buf, len);
+                    route_write(ROUTE_SRC_SERIAL2, serial2_rx_buf, len);
 #if 0
                 serial1_write(serial2_rx_buf, len); /* echo for debugging */
 #endif
@@ -3,6 +3,10 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+/* uart will run at any baud rate between 1647 bit/s and 6750000 bit/s */
+#define BAUD_MIN 1647
+#define BAUD_MAX 6750000
+
 extern const uint32_t serial_speeds[];
 
 int32_t serial0_write(uint8_t *buf, uint32_t len);
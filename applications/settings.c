@@ -41,7 +41,15 @@ static const settings_struct default_settings =
         .can1_speed         = 0,
         .can1_slcan         = true,
         .can1_hw_filter     = {0},
-        .cdc1_output        = CDC1_SERIAL0,
+        .route              = {
+            [ROUTE_SRC_SERIAL0] = ROUTE_DEFAULT_OUTPUT,
+            [ROUTE_SRC_SERIAL1] = ROUTE_DEFAULT_OUTPUT,
+            [ROUTE_SRC_SERIAL2] = ROUTE_DEFAULT_OUTPUT,
+            [ROUTE_SRC_SWO]     = ROUTE_DEFAULT_OUTPUT,
+            [ROUTE_SRC_RTT]     = ROUTE_DEFAULT_OUTPUT,
+            [ROUTE_SRC_CAN]     = ROUTE_DEFAULT_OUTPUT,
+            [ROUTE_SRC_CDC1]    = ROUTE_DEFAULT_INPUT,
+        },
         .screen_brightness  = 192,
         .screen_sleep_time  = 1,
         .screen_rotation    = 3,
@@ -133,7 +141,8 @@ void print_settings()
     rt_kprintf("serial2_enable    : %d\r\n", settings.serial2_enable);
     rt_kprintf("can1_speed        : %d\r\n", settings.can1_speed);
     rt_kprintf("can1_slcan        : %d\r\n", settings.can1_slcan);
-    rt_kprintf("cdc1_output       : %d\r\n", settings.cdc1_output);
+    for (uint32_t i = 0; i < ROUTE_SRC_NUM; i++)
+        rt_kprintf("route[%d]          : 0x%02x\r\n", i, settings.route[i]);
     rt_kprintf("screen_brightness : %d\r\n", settings.screen_brightness);
     rt_kprintf("screen_sleep_time : %d\r\n", settings.screen_sleep_time);
     rt_kprintf("screen_rotation   : %d\r\n", settings.screen_rotation);
@@ -5,13 +5,10 @@
 #include <stdbool.h>
 #include <memwatch.h>
 #include <canbus.h>
+#include "route.h"
 
-#define SETTINGS_VERSION 1
+#define SETTINGS_VERSION 2
 #define LANG_EN          0
-#define CDC1_SERIAL0     0
-#define CDC1_SERIAL1     1
-#define CDC1_RTT         2
-#define CDC1_CAN         3
 
 typedef struct
 {
@@ -37,7 +34,7 @@ typedef struct
     uint8_t              can1_speed;                   /* canbus speed, in Hz */
     bool                 can1_slcan;                   /* canbus slcan output enable */
     can_hw_filter_bank_t can1_hw_filter;               /* canbus hardware filter */
-    uint8_t              cdc1_output;                  /* from usb cdc1 to target */
+    uint8_t              route[ROUTE_SRC_NUM];         /* sinks for each stream source */
     uint8_t              screen_brightness;            /* brightness, 0 .. 255 */
     uint8_t              screen_sleep_time;            /* sleep time in minutes */
     uint8_t              screen_rotation;              /* 0 = 0, 1 = 90, 2 = 180, 3 = 270 */
@@ -9,6 +9,7 @@
 #include "usb_slcan.h"
 #include "slcan.h"
 #include "canbus.h"
+#include "timestamp.h"
 
 #define DBG_TAG "SLCAN"
 #define DBG_LVL DBG_INFO
@@ -18,6 +19,9 @@
 #define SLCAN_STD_ID_LEN 3
 #define SLCAN_EXT_ID_LEN 8
 
+// Z1: append a timestamp in ms, 0 to 59999, to received frames
+static rt_bool_t slcan_timestamp = RT_FALSE;
+
 // Parse an incoming CAN frame into an outgoing slcan message
 rt_err_t slcan_parse_frame(struct rt_can_msg *msg)
 {
@@ -72,6 +76,14 @@ rt_err_t slcan_parse_frame(struct rt_can_msg *msg)
         buf[msg_position++] = (msg->data[j] & 0x0F);
     }
 
+    // Add timestamp, from the timer shared with cmsis-dap and swo
+    if (slcan_timestamp)
+    {
+        uint16_t ms = (timestamp_get() / (TIMESTAMP_FREQ / 1000)) % 60000;
+        for (int8_t j = 12; j >= 0; j -= 4)
+            buf[msg_position++] = (ms >> j) & 0xF;
+    }
+
     // Convert to ASCII (2nd character to end)
     for (uint8_t j = 1; j < msg_position; j++)
     {
@@ -196,6 +208,13 @@ rt_err_t slcan_parse_str(uint8_t *buf, uint8_t len)
         }
         return RT_EOK;
 
+    case 'z':
+    case 'Z':
+        // Set timestamp command
+        if (len < 2) return -RT_EINVAL;
+        slcan_timestamp = buf[1] == 1;
+        return RT_EOK;
+
     case 'V': {
         // Report firmware version
         char *fw_id = "RT-Thread SLCAN v1.0\r";
@@ -0,0 +1,281 @@
+#include <rtthread.h>
+#include <string.h>
+#include <board.h>
+#include "spsc_rb.h"
+
+/* lock-free single-producer single-consumer ring buffer. see spsc_rb.h */
+
+/* the producer publishes head after writing data; the consumer publishes tail after reading data. */
+#define LOAD_ACQUIRE(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+void spsc_rb_init(struct spsc_rb *rb, uint8_t *buffer, uint32_t size)
+{
+    RT_ASSERT(rb != RT_NULL);
+    RT_ASSERT(buffer != RT_NULL);
+    /* size must be a power of two */
+    RT_ASSERT(size != 0 && (size & (size - 1)) == 0);
+
+    rb->buffer = buffer;
+    rb->size   = size;
+    rb->head   = 0;
+    rb->tail   = 0;
+}
+
+void spsc_rb_reset(struct spsc_rb *rb)
+{
+    rb->head = 0;
+    rb->tail = 0;
+}
+
+AT32_RAMFUNC
+uint32_t spsc_rb_data_len(struct spsc_rb *rb)
+{
+    return LOAD_ACQUIRE(&rb->head) - LOAD_ACQUIRE(&rb->tail);
+}
+
+AT32_RAMFUNC
+uint32_t spsc_rb_space_len(struct spsc_rb *rb)
+{
+    return rb->size - spsc_rb_data_len(rb);
+}
+
+/* producer ********************************************************************/
+
+/* contiguous free space at head. returns length of span. */
+AT32_RAMFUNC
+uint32_t spsc_rb_reserve(struct spsc_rb *rb, uint8_t **span)
+{
+    uint32_t head  = rb->head;
+    uint32_t space = rb->size - (head - LOAD_ACQUIRE(&rb->tail));
+    uint32_t idx   = head & (rb->size - 1);
+
+    if (space > rb->size - idx)
+        space = rb->size - idx;
+    *span = &rb->buffer[idx];
+    return space;
+}
+
+/* make len bytes written into the reserved span visible to the consumer */
+AT32_RAMFUNC
+void spsc_rb_produce(struct spsc_rb *rb, uint32_t len)
+{
+    STORE_RELEASE(&rb->head, rb->head + len);
+}
+
+/* copy data into ring buffer. returns number of bytes written. */
+AT32_RAMFUNC
+uint32_t spsc_rb_put(struct spsc_rb *rb, const uint8_t *data, uint32_t len)
+{
+    uint32_t head  = rb->head;
+    uint32_t space = rb->size - (head - LOAD_ACQUIRE(&rb->tail));
+    uint32_t idx   = head & (rb->size - 1);
+    uint32_t first;
+
+    if (len > space) len = space;
+    first = rb->size - idx;
+    if (first > len) first = len;
+    memcpy(&rb->buffer[idx], data, first);
+    memcpy(&rb->buffer[0], data + first, len - first);
+    STORE_RELEASE(&rb->head, head + len);
+    return len;
+}
+
+/* consumer ********************************************************************/
+
+/* contiguous data at tail. returns length of span. */
+AT32_RAMFUNC
+uint32_t spsc_rb_peek(struct spsc_rb *rb, uint8_t **span)
+{
+    uint32_t tail = rb->tail;
+    uint32_t len  = LOAD_ACQUIRE(&rb->head) - tail;
+    uint32_t idx  = tail & (rb->size - 1);
+
+    if (len > rb->size - idx)
+        len = rb->size - idx;
+    *span = &rb->buffer[idx];
+    return len;
+}
+
+/* release len bytes of the peeked span to the producer */
+AT32_RAMFUNC
+void spsc_rb_commit(struct spsc_rb *rb, uint32_t len)
+{
+    STORE_RELEASE(&rb->tail, rb->tail + len);
+}
+
+/* copy data out of ring buffer. returns number of bytes read. */
+AT32_RAMFUNC
+uint32_t spsc_rb_get(struct spsc_rb *rb, uint8_t *data, uint32_t len)
+{
+    uint32_t tail  = rb->tail;
+    uint32_t avail = LOAD_ACQUIRE(&rb->head) - tail;
+    uint32_t idx   = tail & (rb->size - 1);
+    uint32_t first;
+
+    if (len > avail) len = avail;
+    first = rb->size - idx;
+    if (first > len) first = len;
+    memcpy(data, &rb->buffer[idx], first);
+    memcpy(data + first, &rb->buffer[0], len - first);
+    STORE_RELEASE(&rb->tail, tail + len);
+    return len;
+}
+
+AT32_RAMFUNC
+bool spsc_rb_getchar(struct spsc_rb *rb, uint8_t *ch)
+{
+    uint32_t tail = rb->tail;
+
+    if (LOAD_ACQUIRE(&rb->head) == tail)
+        return false;
+    *ch = rb->buffer[tail & (rb->size - 1)];
+    STORE_RELEASE(&rb->tail, tail + 1);
+    return true;
+}
+
+#ifdef RT_USING_FINSH
+#include <rtdevice.h>
+#include <stdlib.h>
+
+/* stress test: producer and consumer thread pass a byte sequence, consumer checks order.
+   benchmark: bytes per second through spsc_rb and through rt_ringbuffer. */
+
+#define TEST_RB_SIZE 2048
+#define TEST_CHUNK   512
+#define TEST_BYTES   (4 * 1024 * 1024)
+
+static struct spsc_rb test_rb;
+static rt_sem_t       test_done_sem;
+static uint32_t       test_errors;
+
+static void test_producer(void *parameter)
+{
+    uint8_t  chunk[TEST_CHUNK];
+    uint8_t  seq = 0;
+    uint32_t sent = 0, len, i;
+
+    while (sent < TEST_BYTES)
+    {
+        len = 1 + rand() % TEST_CHUNK;
+        if (len > TEST_BYTES - sent) len = TEST_BYTES - sent;
+        for (i = 0; i < len; i++)
+            chunk[i] = seq + i;
+        i = 0;
+        while (i < len)
+        {
+            uint32_t n = spsc_rb_put(&test_rb, chunk + i, len - i);
+            if (n == 0) rt_thread_yield();
+            i += n;
+        }
+        seq  += len;
+        sent += len;
+    }
+    rt_sem_release(test_done_sem);
+}
+
+static void test_consumer(void *parameter)
+{
+    uint8_t *span;
+    uint8_t  seq = 0;
+    uint32_t received = 0, len, i;
+
+    while (received < TEST_BYTES)
+    {
+        len = spsc_rb_peek(&test_rb, &span);
+        if (len == 0)
+        {
+            rt_thread_yield();
+            continue;
+        }
+        for (i = 0; i < len; i++)
+            if (span[i] != seq++) test_errors++;
+        spsc_rb_commit(&test_rb, len);
+        received += len;
+    }
+    rt_sem_release(test_done_sem);
+}
+
+static uint32_t bench_spsc(uint8_t *pool)
+{
+    uint8_t   chunk[TEST_CHUNK];
+    rt_tick_t start = rt_tick_get();
+
+    spsc_rb_init(&test_rb, pool, TEST_RB_SIZE);
+    for (uint32_t i = 0; i < TEST_BYTES; i += TEST_CHUNK)
+    {
+        spsc_rb_put(&test_rb, chunk, TEST_CHUNK);
+        spsc_rb_get(&test_rb, chunk, TEST_CHUNK);
+    }
+    return rt_tick_get() - start;
+}
+
+static uint32_t bench_rt_ringbuffer(uint8_t *pool)
+{
+    uint8_t              chunk[TEST_CHUNK];
+    struct rt_ringbuffer rb;
+    rt_tick_t            start = rt_tick_get();
+
+    rt_ringbuffer_init(&rb, pool, TEST_RB_SIZE);
+    for (uint32_t i = 0; i < TEST_BYTES; i += TEST_CHUNK)
+    {
+        rt_ringbuffer_put(&rb, chunk, TEST_CHUNK);
+        rt_ringbuffer_get(&rb, chunk, TEST_CHUNK);
+    }
+    return rt_tick_get() - start;
+}
+
+static void print_rate(const char *name, uint32_t ticks)
+{
+    if (ticks == 0) ticks = 1;
+    rt_kprintf("%-14s %6d ms %6d kbyte/s\r\n", name, ticks * 1000 / RT_TICK_PER_SECOND,
+               (uint32_t)((uint64_t)TEST_BYTES * RT_TICK_PER_SECOND / ticks / 1024));
+}
+
+static int cmd_spsc_test(int argc, char **argv)
+{
+    uint8_t    *pool;
+    rt_thread_t producer, consumer;
+    rt_tick_t   start;
+
+    pool = rt_malloc(TEST_RB_SIZE);
+    if (pool == RT_NULL)
+    {
+        rt_kprintf("no memory\r\n");
+        return -RT_ENOMEM;
+    }
+
+    /* two-thread stress test */
+    spsc_rb_init(&test_rb, pool, TEST_RB_SIZE);
+    test_errors   = 0;
+    test_done_sem = rt_sem_create("spsc", 0, RT_IPC_FLAG_FIFO);
+    producer      = rt_thread_create("spsc_p", test_producer, RT_NULL, 1024, 26, 1);
+    consumer      = rt_thread_create("spsc_c", test_consumer, RT_NULL, 1024, 26, 1);
+    if (test_done_sem && producer && consumer)
+    {
+        start = rt_tick_get();
+        rt_thread_startup(producer);
+        rt_thread_startup(consumer);
+        rt_sem_take(test_done_sem, RT_WAITING_FOREVER);
+        rt_sem_take(test_done_sem, RT_WAITING_FOREVER);
+        print_rate("spsc threads", rt_tick_get() - start);
+        rt_kprintf("errors: %d\r\n", test_errors);
+    }
+    else
+    {
+        rt_kprintf("thread create fail\r\n");
+        if (producer) rt_thread_delete(producer);
+        if (consumer) rt_thread_delete(consumer);
+    }
+    if (test_done_sem) rt_sem_delete(test_done_sem);
+
+    /* single-thread throughput */
+    print_rate("spsc_rb", bench_spsc(pool));
+    print_rate("rt_ringbuffer", bench_rt_ringbuffer(pool));
+
+    rt_free(pool);
+    return RT_EOK;
+}
+
+MSH_CMD_EXPORT_ALIAS(cmd_spsc_test, spsc_test, ring buffer stress test and benchmark);
+#endif
@@ -0,0 +1,47 @@
+#ifndef _SPSC_RB_H
+#define _SPSC_RB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * lock-free single-producer single-consumer ring buffer.
+ *
+ * concurrency contract:
+ * - exactly one producer context (thread or interrupt) calls
+ *   spsc_rb_put(), spsc_rb_reserve() and spsc_rb_produce().
+ * - exactly one consumer context calls
+ *   spsc_rb_get(), spsc_rb_getchar(), spsc_rb_peek() and spsc_rb_commit().
+ * - spsc_rb_data_len() and spsc_rb_space_len() may be called from either side.
+ * - spsc_rb_reset() only when neither side is active, e.g. on usb reset.
+ *
+ * head and tail are free-running counters; size must be a power of two.
+ * spsc_rb_peek() and spsc_rb_reserve() return contiguous spans,
+ * so data can be passed to dfs_file_write() or usbd_ep_start_write() without copying.
+ */
+
+struct spsc_rb
+{
+    uint8_t          *buffer;
+    uint32_t          size;
+    volatile uint32_t head; /* written by producer only */
+    volatile uint32_t tail; /* written by consumer only */
+};
+
+void     spsc_rb_init(struct spsc_rb *rb, uint8_t *buffer, uint32_t size);
+void     spsc_rb_reset(struct spsc_rb *rb);
+uint32_t spsc_rb_data_len(struct spsc_rb *rb);
+uint32_t spsc_rb_space_len(struct spsc_rb *rb);
+
+/* producer */
+uint32_t spsc_rb_put(struct spsc_rb *rb, const uint8_t *data, uint32_t len);
+uint32_t spsc_rb_reserve(struct spsc_rb *rb, uint8_t **span);
+void     spsc_rb_produce(struct spsc_rb *rb, uint32_t len);
+
+/* consumer */
+uint32_t spsc_rb_get(struct spsc_rb *rb, uint8_t *data, uint32_t len);
+bool     spsc_rb_getchar(struct spsc_rb *rb, uint8_t *ch);
+uint32_t spsc_rb_peek(struct spsc_rb *rb, uint8_t **span);
+void     spsc_rb_commit(struct spsc_rb *rb, uint32_t len);
+
+#endif
@@ -8,6 +8,8 @@
 #include "memwatch.h"
 #include "platform.h"
 #include "settings.h"
+#include "swd_arbiter.h"
+#include "attach_cache.h"
 
 #define DBG_TAG "STARTUP"
 #define DBG_LVL DBG_INFO
@@ -15,51 +17,12 @@
 
 static bool startup_attach()
 {
-    target_s *target;
-    char     *msg = NULL;
-    if (connect_assert_nrst)
-        platform_nrst_set_val(true); /* will be deasserted after attach */
-
-    bool scan_result = false;
-    TRY(EXCEPTION_ALL)
-    {
-        scan_result = adiv5_swd_scan(0);
-    }
-    CATCH()
-    {
-    case EXCEPTION_TIMEOUT:
-        msg = "Timeout during scan. Is target stuck in WFI?";
-        break;
-    case EXCEPTION_ERROR:
-        msg = (char *)exception_frame.msg;
-        break;
-    default:
-        break;
-    }
-
-    if (!scan_result)
-        msg = "swd scan failed";
-
+    const char *msg = attach_cache_attach();
     if (msg)
     {
-        platform_target_clk_output_enable(false);
-        platform_nrst_set_val(false);
         LOG_E("%s", msg);
         return false;
     }
-
-    platform_target_clk_output_enable(false);
-
-    /* Attach to remote target processor */
-    extern target_controller_s gdb_controller;
-    cur_target = target_attach_n(1, &gdb_controller);
-    if (!cur_target)
-    {
-        LOG_E("attach failed");
-        return false;
-    }
-
-    LOG_I("attached");
     return true;
 }
 
@@ -87,7 +50,12 @@ int startup(void)
     }
     /* attach gdb server */
     if (settings.attach_enable)
+    {
+        bool held = swd_arbiter_take(SWD_USER_BMD);
         startup_attach();
+        if (held)
+            swd_arbiter_release(SWD_USER_BMD);
+    }
     /* setup rtt */
     if (settings.rtt_enable)
         startup_rtt();
@@ -0,0 +1,135 @@
+#include <rtthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dap.h"
+#include "swd_arbiter.h"
+#ifdef PKG_USING_BLACKMAGIC
+#include "general.h"
+#include "platform.h"
+#include "mem_cache.h"
+#endif
+
+#define DBG_TAG "SWD"
+#define DBG_LVL DBG_INFO
+#include <rtdbg.h>
+
+/* swd pin arbitration. see swd_arbiter.h */
+
+#define SWD_ACK_OK 1 /* DAP_TRANSFER_OK */
+
+static struct rt_mutex          swd_lock;
+static enum swd_user            swd_last = SWD_USER_COUNT; /* user that had the pins last */
+static rt_int32_t               swd_timeout[SWD_USER_COUNT] = {SWD_ARBITER_DAP_TIMEOUT, SWD_ARBITER_BMD_TIMEOUT};
+static struct swd_arbiter_stats swd_stats[SWD_USER_COUNT];
+static const char *const        swd_user_name[SWD_USER_COUNT] = {"dap", "bmd"};
+
+static int swd_arbiter_init()
+{
+    rt_mutex_init(&swd_lock, "swd", RT_IPC_FLAG_PRIO);
+    return RT_EOK;
+}
+
+INIT_DEVICE_EXPORT(swd_arbiter_init);
+
+/* the pins move from swd_last to user. the lock is held */
+static void swd_handover(enum swd_user user)
+{
+    int ack = SWD_ACK_OK;
+
+    if (swd_last == SWD_USER_DAP)
+        ack = dap_suspend();
+    if (user == SWD_USER_DAP && dap_resume() != SWD_ACK_OK)
+        ack = !SWD_ACK_OK;
+#ifdef PKG_USING_BLACKMAGIC
+    if (user == SWD_USER_BMD)
+        swdptap_platform_resume();
+    else
+        mem_cache_invalidate(); /* the host may write memory or resume the core */
+#endif
+    swd_stats[user].handovers++;
+    if (ack != SWD_ACK_OK)
+        swd_stats[user].resync_err++;
+}
+
+bool swd_arbiter_take(enum swd_user user)
+{
+    struct swd_arbiter_stats *s = &swd_stats[user];
+    rt_int32_t                timeout;
+    rt_tick_t                 start, wait;
+    rt_err_t                  err;
+
+    err = rt_mutex_take(&swd_lock, 0);
+    if (err != RT_EOK)
+    {
+        s->contended++;
+        timeout = swd_timeout[user] < 0 ? RT_WAITING_FOREVER : rt_tick_from_millisecond(swd_timeout[user]);
+        start   = rt_tick_get();
+        err     = rt_mutex_take(&swd_lock, timeout);
+        wait    = (rt_tick_get() - start) * 1000 / RT_TICK_PER_SECOND;
+        if (wait > s->max_wait)
+            s->max_wait = wait;
+        if (err != RT_EOK)
+        {
+            s->timeouts++;
+            return false;
+        }
+    }
+    s->taken++;
+    if (swd_last != user)
+    {
+        if (swd_last != SWD_USER_COUNT)
+            swd_handover(user);
+        swd_last = user;
+    }
+    return true;
+}
+
+void swd_arbiter_release(enum swd_user user)
+{
+    (void)user;
+    rt_mutex_release(&swd_lock);
+}
+
+void swd_arbiter_get_stats(enum swd_user user, struct swd_arbiter_stats *stats, bool clear)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+
+    *stats = swd_stats[user];
+    if (clear)
+        memset(&swd_stats[user], 0, sizeof(swd_stats[user]));
+    rt_hw_interrupt_enable(level);
+}
+
+#ifdef RT_USING_FINSH
+static int cmd_swd_arbiter(int argc, char **argv)
+{
+    struct swd_arbiter_stats stats;
+    bool                     clear = argc == 2 && !strcmp(argv[1], "clear");
+
+    if (argc == 4 && !strcmp(argv[1], "timeout"))
+    {
+        for (int i = 0; i < SWD_USER_COUNT; i++)
+            if (!strcmp(argv[2], swd_user_name[i]))
+            {
+                swd_timeout[i] = atoi(argv[3]);
+                return RT_EOK;
+            }
+    }
+    if (argc != 1 && !clear)
+    {
+        rt_kprintf("swd_arbiter [clear | timeout dap|bmd ms]\r\n");
+        return -RT_EINVAL;
+    }
+    rt_kprintf("owner %s\r\n", swd_last == SWD_USER_COUNT ? "none" : swd_user_name[swd_last]);
+    for (int i = 0; i < SWD_USER_COUNT; i++)
+    {
+        swd_arbiter_get_stats(i, &stats, clear);
+        rt_kprintf("%s: taken %u contended %u timeouts %u max wait %u ms handovers %u resync errors %u timeout %d ms\r\n",
+                   swd_user_name[i], stats.taken, stats.contended, stats.timeouts, stats.max_wait, stats.handovers,
+                   stats.resync_err, swd_timeout[i]);
+    }
+    return RT_EOK;
+}
+
+MSH_CMD_EXPORT_ALIAS(cmd_swd_arbiter, swd_arbiter, swd pin sharing between cmsis-dap and bmd: swd_arbiter [clear | timeout dap|bmd ms]);
+#endif
@@ -0,0 +1,43 @@
+#ifndef _SWD_ARBITER_H
+#define _SWD_ARBITER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+   the cmsis-dap engine and the black magic gdb server share the swd pins.
+   a user takes the pins for one cmsis-dap request, or one gdb packet or lua bmd call,
+   and gives them back after. a waiting thread of higher rt-thread priority goes first,
+   and a lower priority holder runs at the waiter's priority until it lets go.
+   when the pins change hands, the dap side saves and restores the SELECT, CSW and TAR
+   its host has cached, see dap_suspend(). both users must speak the same wire protocol.
+ */
+
+enum swd_user
+{
+    SWD_USER_DAP,
+    SWD_USER_BMD,
+    SWD_USER_COUNT,
+};
+
+/* default wait for the pins, in ms. RT_WAITING_FOREVER (-1) waits forever */
+#define SWD_ARBITER_DAP_TIMEOUT 2000
+#define SWD_ARBITER_BMD_TIMEOUT -1
+
+struct swd_arbiter_stats
+{
+    uint32_t taken;      /* times the pins were taken */
+    uint32_t contended;  /* times the other user had them */
+    uint32_t timeouts;   /* times the wait ran out */
+    uint32_t max_wait;   /* longest wait, in ms */
+    uint32_t handovers;  /* times the pins came from the other user */
+    uint32_t resync_err; /* handovers where state could not be saved or restored */
+};
+
+/* false if the pins stay busy past the user's timeout */
+bool swd_arbiter_take(enum swd_user user);
+void swd_arbiter_release(enum swd_user user);
+
+void swd_arbiter_get_stats(enum swd_user user, struct swd_arbiter_stats *stats, bool clear);
+
+#endif
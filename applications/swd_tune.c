@@ -0,0 +1,163 @@
+#include <rtthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "at24c256.h"
+#include "dap.h"
+#include "swd_tune.h"
+#include "swd_arbiter.h"
+#ifdef PKG_USING_BLACKMAGIC
+#include "general.h"
+#endif
+
+#define DBG_TAG "TUNE"
+#define DBG_LVL DBG_INFO
+#include <rtdbg.h>
+
+/* swclk auto-tune cache. see swd_tune.h */
+
+#define SWD_TUNE_MAGIC 0x54445753 /* "SWDT" */
+
+struct swd_tune_entry
+{
+    uint32_t idcode;
+    uint32_t freq;
+};
+
+static struct
+{
+    uint32_t              magic;
+    uint32_t              count;
+    struct swd_tune_entry entry[SWD_TUNE_ENTRIES];
+} swd_tune_table;
+
+static bool swd_tune_loaded;
+
+static void swd_tune_load()
+{
+    if (swd_tune_loaded)
+        return;
+    at24_read(SWD_TUNE_EEPROM_ADDR, (uint8_t *)&swd_tune_table, sizeof(swd_tune_table));
+    if (swd_tune_table.magic != SWD_TUNE_MAGIC || swd_tune_table.count > SWD_TUNE_ENTRIES)
+    {
+        memset(&swd_tune_table, 0, sizeof(swd_tune_table));
+        swd_tune_table.magic = SWD_TUNE_MAGIC;
+    }
+    swd_tune_loaded = true;
+}
+
+static void swd_tune_save()
+{
+    if (at24_write(SWD_TUNE_EEPROM_ADDR, (uint8_t *)&swd_tune_table, sizeof(swd_tune_table)) != sizeof(swd_tune_table))
+        LOG_E("eeprom write failed");
+}
+
+/* bmd tops out at a lower frequency, see platform.h */
+static void swd_tune_bmd(uint32_t freq)
+{
+#ifdef PKG_USING_BLACKMAGIC
+    platform_max_frequency_set(freq);
+#endif
+}
+
+uint32_t swd_tune_lookup(uint32_t idcode)
+{
+    swd_tune_load();
+    for (uint32_t i = 0; i < swd_tune_table.count; i++)
+        if (swd_tune_table.entry[i].idcode == idcode)
+        {
+            swd_tune_bmd(swd_tune_table.entry[i].freq);
+            return swd_tune_table.entry[i].freq;
+        }
+    return 0;
+}
+
+void swd_tune_store(uint32_t idcode, uint32_t freq)
+{
+    uint32_t i;
+
+    swd_tune_load();
+    swd_tune_bmd(freq);
+    for (i = 0; i < swd_tune_table.count && swd_tune_table.entry[i].idcode != idcode; i++)
+        ;
+    if (i < swd_tune_table.count && swd_tune_table.entry[i].freq == freq)
+        return;
+    if (i == SWD_TUNE_ENTRIES)
+    {
+        memmove(&swd_tune_table.entry[0], &swd_tune_table.entry[1], sizeof(swd_tune_table.entry[0]) * (SWD_TUNE_ENTRIES - 1));
+        i--;
+    }
+    else if (i == swd_tune_table.count)
+        swd_tune_table.count++;
+    swd_tune_table.entry[i].idcode = idcode;
+    swd_tune_table.entry[i].freq   = freq;
+    swd_tune_save();
+}
+
+#ifdef RT_USING_FINSH
+/* connect, power up the debug domain, tune, disconnect. see dap_probe_begin().
+ * a cmsis-dap host keeps its session and swclk; the tuned frequency is cached */
+static void swd_tune_target(uint32_t addr, bool retune)
+{
+    struct dap_tune tune;
+    uint32_t        idcode;
+    int             ack;
+
+    if (dap_probe_begin(&idcode) != 1)
+    {
+        rt_kprintf("no target\r\n");
+        dap_probe_end();
+        return;
+    }
+    ack = dap_clock_tune(addr, retune, &tune);
+    dap_probe_end();
+
+    rt_kprintf("idcode %08x swclk %d Hz%s", tune.idcode, tune.freq, tune.cached ? " cached" : "");
+    if (!tune.cached)
+        rt_kprintf(" fastest %d Hz failed %d Hz", tune.fastest, tune.failed);
+    rt_kprintf(ack == 1 ? "\r\n" : " ack %d\r\n", ack);
+}
+
+static int cmd_swd_tune(int argc, char **argv)
+{
+    bool     retune = false;
+    uint32_t addr   = 0;
+    int      i      = 1;
+
+    if (argc == 2 && !strcmp(argv[1], "list"))
+    {
+        swd_tune_load();
+        for (uint32_t n = 0; n < swd_tune_table.count; n++)
+            rt_kprintf("idcode %08x swclk %u Hz\r\n", swd_tune_table.entry[n].idcode, swd_tune_table.entry[n].freq);
+        return RT_EOK;
+    }
+    if (argc == 2 && !strcmp(argv[1], "clear"))
+    {
+        swd_tune_load();
+        swd_tune_table.count = 0;
+        swd_tune_save();
+        return RT_EOK;
+    }
+    if (i < argc && !strcmp(argv[i], "retune"))
+    {
+        retune = true;
+        i++;
+    }
+    if (i < argc)
+        addr = strtoul(argv[i++], NULL, 0);
+    if (i < argc || (addr & 3))
+    {
+        rt_kprintf("%s [retune] [address] | list | clear\r\n", argv[0]);
+        return RT_EOK;
+    }
+    if (!swd_arbiter_take(SWD_USER_DAP))
+    {
+        rt_kprintf("swd busy\r\n");
+        return RT_EOK;
+    }
+    swd_tune_target(addr, retune);
+    swd_arbiter_release(SWD_USER_DAP);
+    return RT_EOK;
+}
+
+MSH_CMD_EXPORT_ALIAS(cmd_swd_tune, swd_tune, fastest reliable swclk: swd_tune [retune] [address] | list | clear);
+#endif
@@ -0,0 +1,18 @@
+#ifndef _SWD_TUNE_H
+#define _SWD_TUNE_H
+
+#include <stdint.h>
+
+/*
+   swclk frequencies found by dap_clock_tune(), cached in eeprom per target DP IDCODE,
+   after the settings. holds SWD_TUNE_ENTRIES targets; the oldest entry makes room.
+   a frequency looked up or stored is also set as the bmd swd frequency.
+ */
+
+#define SWD_TUNE_EEPROM_ADDR 0x7f00
+#define SWD_TUNE_ENTRIES     16
+
+uint32_t swd_tune_lookup(uint32_t idcode);
+void     swd_tune_store(uint32_t idcode, uint32_t freq);
+
+#endif
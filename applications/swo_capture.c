@@ -0,0 +1,195 @@
+#include <rtthread.h>
+#include <board.h>
+#include "usbd_core.h"
+#include "usb_desc.h"
+#include "serials.h"
+#include "spsc_rb.h"
+#include "swo_capture.h"
+#include "timestamp.h"
+
+/* swo trace capture. see swo_capture.h */
+
+#define SWO_EP_TIMEOUT 100 /* ms to wait for the host to read the last endpoint transfer */
+
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX static uint8_t swo_buf[SWO_CAPTURE_BUF_SIZE];
+
+/* producer serial2 thread. consumer DAP_SWO_Data, or the swo endpoint with interrupts disabled */
+static struct spsc_rb swo_rb = {swo_buf, sizeof(swo_buf), 0, 0};
+
+static uint8_t           swo_transport = SWO_TRANSPORT_NONE;
+static uint8_t           swo_mode      = SWO_MODE_OFF;
+static uint32_t          swo_baudrate;
+static volatile bool     swo_active;
+static volatile uint8_t  swo_errors; /* SWO_STATUS_ERROR, SWO_STATUS_OVERRUN */
+static volatile uint32_t swo_index;  /* bytes captured since start */
+static volatile uint32_t swo_time;   /* timestamp of the byte before swo_index */
+
+static bool              swo_configured;
+static uint8_t           swo_busid;
+static volatile bool     swo_ep_busy;
+static uint32_t          swo_ep_len;
+
+/* swo bulk endpoint **********************************************************/
+
+/* send the next span of the trace buffer. zero-length packet after a full packet */
+AT32_RAMFUNC
+static void swo_ep_next_write(uint32_t last)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+    uint8_t  *span  = RT_NULL;
+    uint32_t  len;
+
+    if (!swo_ep_busy && swo_configured && swo_transport == SWO_TRANSPORT_ENDPOINT)
+    {
+        len = spsc_rb_peek(&swo_rb, &span);
+        if (len > DAP_SWO_MPS)
+            len = DAP_SWO_MPS;
+        if (len != 0 || (last != 0 && last % DAP_SWO_MPS == 0))
+        {
+            swo_ep_busy = true;
+            swo_ep_len  = len;
+            usbd_ep_start_write(swo_busid, DAP_SWO_EP, span, len);
+        }
+    }
+    rt_hw_interrupt_enable(level);
+}
+
+void swo_capture_configured(uint8_t busid)
+{
+    swo_busid      = busid;
+    swo_ep_busy    = false;
+    swo_configured = true;
+    swo_ep_next_write(0);
+}
+
+AT32_RAMFUNC
+void swo_capture_in_callback(uint8_t busid, uint8_t ep, uint32_t nbytes)
+{
+    spsc_rb_commit(&swo_rb, swo_ep_len);
+    swo_ep_len  = 0;
+    swo_ep_busy = false;
+    swo_ep_next_write(nbytes);
+}
+
+/* serial2 input **************************************************************/
+
+bool swo_capture_active()
+{
+    return swo_active;
+}
+
+AT32_RAMFUNC
+void swo_capture_write(uint8_t *buf, uint32_t len)
+{
+    uint32_t n;
+
+    if (!swo_active) return;
+    swo_time = timestamp_get();
+    n        = spsc_rb_put(&swo_rb, buf, len);
+    if (n != len)
+        swo_errors |= SWO_STATUS_OVERRUN;
+    swo_index += n;
+    swo_ep_next_write(0);
+}
+
+/* DAP_SWO_* commands *********************************************************/
+
+bool swo_capture_transport(uint8_t transport)
+{
+    if (swo_active || transport > SWO_TRANSPORT_ENDPOINT)
+        return false;
+    swo_transport = transport;
+    return true;
+}
+
+/* uart (nrz) only */
+bool swo_capture_mode(uint8_t mode)
+{
+    if (swo_active || (mode != SWO_MODE_OFF && mode != SWO_MODE_UART))
+        return false;
+    swo_mode = mode;
+    return true;
+}
+
+/* returns the baud rate set, or 0 if out of range */
+uint32_t swo_capture_baudrate(uint32_t baudrate)
+{
+    if (swo_active || swo_mode != SWO_MODE_UART || baudrate < BAUD_MIN)
+        return 0;
+    if (baudrate > BAUD_MAX)
+        baudrate = BAUD_MAX;
+    serial2_set_speed(baudrate);
+    swo_baudrate = baudrate;
+    return baudrate;
+}
+
+bool swo_capture_control(bool start)
+{
+    if (!start)
+    {
+        swo_active = false;
+        return true;
+    }
+    if (swo_mode != SWO_MODE_UART || swo_baudrate == 0 || swo_transport == SWO_TRANSPORT_NONE)
+        return false;
+    if (swo_active)
+        return true;
+    /* neither side is active: capture stopped, endpoint idle. the host may have
+       stopped reading the endpoint; DAP_ERROR then, rather than hang the dap thread */
+    for (uint32_t ms = 0; swo_ep_busy; ms++)
+    {
+        if (ms == SWO_EP_TIMEOUT)
+            return false;
+        rt_thread_mdelay(1);
+    }
+    spsc_rb_reset(&swo_rb);
+    swo_errors = 0;
+    swo_index  = 0;
+    swo_time   = timestamp_get();
+    swo_active = true;
+    return true;
+}
+
+uint8_t swo_capture_status()
+{
+    return (swo_active ? SWO_STATUS_ACTIVE : 0) | swo_errors;
+}
+
+uint32_t swo_capture_count()
+{
+    return spsc_rb_data_len(&swo_rb);
+}
+
+uint32_t swo_capture_index()
+{
+    return swo_index;
+}
+
+/* time the trace at swo_capture_index() was received, see timestamp.h */
+uint32_t swo_capture_timestamp()
+{
+    return swo_time;
+}
+
+/* DAP_SWO_Data. the endpoint transport does not use this */
+uint32_t swo_capture_read(uint8_t *buf, uint32_t len)
+{
+    if (swo_transport != SWO_TRANSPORT_COMMAND)
+        return 0;
+    return spsc_rb_get(&swo_rb, buf, len);
+}
+
+#ifdef RT_USING_FINSH
+static const char *const swo_transport_name[] = {"none", "command", "endpoint"};
+
+static int cmd_swo_capture(int argc, char **argv)
+{
+    rt_kprintf("transport %s mode %s baud %u %s\r\n", swo_transport_name[swo_transport],
+               swo_mode == SWO_MODE_UART ? "uart" : "off", swo_baudrate, swo_active ? "active" : "stopped");
+    rt_kprintf("captured %u buffered %u%s\r\n", swo_index, spsc_rb_data_len(&swo_rb),
+               swo_errors & SWO_STATUS_OVERRUN ? " overrun" : "");
+    return RT_EOK;
+}
+
+MSH_CMD_EXPORT_ALIAS(cmd_swo_capture, swo_capture, cmsis-dap swo trace status);
+#endif
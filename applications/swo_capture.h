@@ -0,0 +1,47 @@
+#ifndef _SWO_CAPTURE_H
+#define _SWO_CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+   swo trace capture for the cmsis-dap DAP_SWO_* commands.
+   while capture is active, serial2 input goes to the trace buffer instead of
+   the swo decoder and the router. the host reads the trace buffer with
+   DAP_SWO_Data, or it streams on the swo bulk endpoint.
+ */
+
+#define SWO_CAPTURE_BUF_SIZE 4096 /* power of two */
+
+#define SWO_TRANSPORT_NONE     0
+#define SWO_TRANSPORT_COMMAND  1 /* DAP_SWO_Data */
+#define SWO_TRANSPORT_ENDPOINT 2 /* swo bulk endpoint */
+
+#define SWO_MODE_OFF        0
+#define SWO_MODE_UART       1
+#define SWO_MODE_MANCHESTER 2
+
+/* trace status */
+#define SWO_STATUS_ACTIVE  (1 << 0)
+#define SWO_STATUS_ERROR   (1 << 6)
+#define SWO_STATUS_OVERRUN (1 << 7)
+
+bool     swo_capture_transport(uint8_t transport);
+bool     swo_capture_mode(uint8_t mode);
+uint32_t swo_capture_baudrate(uint32_t baudrate);
+bool     swo_capture_control(bool start);
+uint8_t  swo_capture_status();
+uint32_t swo_capture_count();
+uint32_t swo_capture_index();
+uint32_t swo_capture_timestamp();
+uint32_t swo_capture_read(uint8_t *buf, uint32_t len);
+
+/* serial2 input */
+bool swo_capture_active();
+void swo_capture_write(uint8_t *buf, uint32_t len);
+
+/* swo bulk endpoint */
+void swo_capture_configured(uint8_t busid);
+void swo_capture_in_callback(uint8_t busid, uint8_t ep, uint32_t nbytes);
+
+#endif
@@ -0,0 +1,58 @@
+#include <rtthread.h>
+#include "drv_common.h"
+#include "timestamp.h"
+
+#define DBG_TAG "TIME"
+#define DBG_LVL DBG_INFO
+#include <rtdbg.h>
+
+/* timestamp timer. see timestamp.h */
+
+#define TIMESTAMP_TMR       TMR2
+#define TIMESTAMP_TMR_CLOCK CRM_TMR2_PERIPH_CLOCK
+
+/* timer clock is twice the apb clock if the apb divider is not 1 */
+static uint32_t timestamp_tmr_clock()
+{
+    crm_clocks_freq_type clocks;
+
+    crm_clocks_freq_get(&clocks);
+    if (clocks.apb1_freq == clocks.ahb_freq)
+        return clocks.apb1_freq;
+    return 2 * clocks.apb1_freq;
+}
+
+uint32_t timestamp_get()
+{
+    return TIMESTAMP_TMR->cval;
+}
+
+static int timestamp_init()
+{
+    uint32_t div = timestamp_tmr_clock() / TIMESTAMP_FREQ;
+
+    crm_periph_clock_enable(TIMESTAMP_TMR_CLOCK, TRUE);
+    tmr_32_bit_function_enable(TIMESTAMP_TMR, TRUE);
+    tmr_base_init(TIMESTAMP_TMR, 0xffffffff, div - 1);
+    tmr_cnt_dir_set(TIMESTAMP_TMR, TMR_COUNT_UP);
+    /* load the prescaler now, not at the first overflow */
+    tmr_event_sw_trigger(TIMESTAMP_TMR, TMR_OVERFLOW_SWTRIG);
+    tmr_counter_value_set(TIMESTAMP_TMR, 0);
+    tmr_counter_enable(TIMESTAMP_TMR, TRUE);
+    LOG_D("timestamp %d MHz", TIMESTAMP_FREQ / 1000000);
+    return RT_EOK;
+}
+INIT_DEVICE_EXPORT(timestamp_init);
+
+#ifdef RT_USING_FINSH
+static int cmd_timestamp(int argc, char **argv)
+{
+    uint32_t t0 = timestamp_get();
+
+    rt_thread_mdelay(1000);
+    rt_kprintf("timestamp %u, 1000 ms of rt-thread ticks is %u us\r\n", timestamp_get(), timestamp_get() - t0);
+    return RT_EOK;
+}
+
+MSH_CMD_EXPORT_ALIAS(cmd_timestamp, timestamp, print timestamp and check it against the tick);
+#endif
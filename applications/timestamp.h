@@ -0,0 +1,16 @@
+#ifndef _TIMESTAMP_H
+#define _TIMESTAMP_H
+
+#include <stdint.h>
+
+/*
+   free-running 32-bit timestamp, shared by cmsis-dap transfers, swo trace and slcan,
+   so their traces can be lined up. TMR2 in 32-bit mode, counting at TIMESTAMP_FREQ.
+   wraps after 71 minutes.
+ */
+
+#define TIMESTAMP_FREQ 1000000
+
+uint32_t timestamp_get();
+
+#endif
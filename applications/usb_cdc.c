@@ -1,13 +1,18 @@
 #include "rtthread.h"
 #include "rtdevice.h"
+#include "board.h"
 #include "usbd_core.h"
 #include "usbd_cdc.h"
 #include "usb_desc.h"
 #include "usb_cdc.h"
 #include "usb_slcan.h"
 #include "serials.h"
-#include "logger.h"
 #include "settings.h"
+#include "spsc_rb.h"
+#include "route.h"
+#include "usb_test.h"
+#include <stdlib.h>
+#include <string.h>
 
 /*
    implements two serial ports, cdc0 and cdc1.
@@ -28,7 +33,7 @@ static bool                   cdc1_dtr          = false;
 static rt_sem_t               ep_write_sem      = RT_NULL;
 static rt_sem_t               cdc_tx_busy_sem   = RT_NULL;
 static rt_wqueue_t            cdc0_wqueue;
-static struct rt_ringbuffer   cdc0_read_rb;
+static struct spsc_rb         cdc0_read_rb; /* producer usb interrupt, consumer gdb server */
 static uint8_t                cdc0_ring_buffer[4 * CDC_MAX_MPS];
 static bool                   cdc0_read_busy = false;
 static rt_sem_t               cdc1_out_sem   = RT_NULL;
@@ -38,6 +43,9 @@ static struct cdc_line_coding cdc_line[2];
 static void cdc0_next_read();
 static void cdc1_next_read();
 static void cdc1_out_thread(void *parameter);
+static void cdc_in_init();
+static bool cdc_test_in(uint32_t port, uint32_t nbytes);
+static bool cdc_test_out(uint32_t port, uint8_t *buf, uint32_t nbytes);
 
 void cdc_init()
 {
@@ -46,7 +54,8 @@ void cdc_init()
     cdc_tx_busy_sem = rt_sem_create("cdc_tx", 0, RT_IPC_FLAG_FIFO);
     cdc1_out_sem    = rt_sem_create("cdc1_out", 0, RT_IPC_FLAG_FIFO);
     rt_wqueue_init(&cdc0_wqueue);
-    rt_ringbuffer_init(&cdc0_read_rb, cdc0_ring_buffer, sizeof(cdc0_ring_buffer));
+    spsc_rb_init(&cdc0_read_rb, cdc0_ring_buffer, sizeof(cdc0_ring_buffer));
+    cdc_in_init();
     rt_thread_t thread = rt_thread_create("cdc1_out", cdc1_out_thread, RT_NULL, 1024, 25, 10);
     if (thread != RT_NULL)
         rt_thread_startup(thread);
@@ -69,7 +78,7 @@ void cdc_reset(uint8_t busid)
 {
     (void)busid;
     cdc0_read_busy = false;
-    rt_ringbuffer_reset(&cdc0_read_rb);
+    spsc_rb_reset(&cdc0_read_rb);
 }
 
 void cdc_connected(uint8_t busid)
@@ -178,11 +187,79 @@ bool cdc1_connected()
 
 /* write to host **************************************************************/
 
-/* cdc0 writing to host */
+/*
+   flush policy for usb in streams.
+   immediate: every write is sent at once. for gdb.
+   deadline:  full packets are sent at once, the rest when the oldest byte is deadline ms old.
+   threshold: data is sent when threshold bytes are queued, the rest after deadline ms.
+   queued data is sent by the cdc_in thread, woken by writers and by a 1 ms timer.
+   the cmsis-dap in endpoint has no policy: each request gets one response, which the host
+   waits for. the swo endpoint sends all that is queued when the previous transfer is done,
+   so it fills packets under load without adding latency.
+ */
+
+#define CDC_IN_BUF_SIZE (4 * CDC_MAX_MPS) /* power of two */
+#define CDC_IN_TIMEOUT  10                /* ticks a writer waits for buffer space */
+
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX static uint8_t cdc0_in_buffer[CDC_IN_BUF_SIZE];
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX static uint8_t cdc1_in_buffer[CDC_IN_BUF_SIZE];
+
+static const char *const cdc_flush_name[] = {"immediate", "deadline", "threshold"};
 
+struct cdc_in_stream
+{
+    const char     *name;
+    uint8_t         ep;
+    bool           *dtr;
+    uint8_t         policy;
+    uint32_t        threshold;     /* bytes */
+    rt_tick_t       deadline;      /* ticks */
+    struct spsc_rb  rb;            /* producers serialized by lock, consumer cdc_in thread */
+    struct rt_mutex lock;
+    rt_tick_t       pending_since; /* time the oldest queued byte was written */
+    /* statistics */
+    uint32_t        bytes;
+    uint32_t        transfers;
+    uint32_t        packets;
+    uint32_t        latency_sum; /* ticks */
+    uint32_t        latency_max; /* ticks */
+};
+
+static struct cdc_in_stream cdc_in[] = {
+    {
+        .name      = "cdc0",
+        .ep        = CDC0_IN_EP,
+        .dtr       = &cdc0_dtr,
+        .policy    = CDC_FLUSH_IMMEDIATE,
+        .threshold = 1,
+        .deadline  = 0,
+        .rb        = {cdc0_in_buffer, sizeof(cdc0_in_buffer), 0, 0},
+    },
+    {
+        .name      = "cdc1",
+        .ep        = CDC1_IN_EP,
+        .dtr       = &cdc1_dtr,
+        .policy    = CDC_FLUSH_DEADLINE,
+        .threshold = CDC_MAX_MPS,
+        .deadline  = 2,
+        .rb        = {cdc1_in_buffer, sizeof(cdc1_in_buffer), 0, 0},
+    },
+};
+
+#define CDC_IN_NUM (sizeof(cdc_in) / sizeof(cdc_in[0]))
+
+static rt_sem_t        cdc_in_sem = RT_NULL;
+static rt_wqueue_t     cdc_in_wqueue; /* writers waiting for buffer space */
+static struct rt_timer cdc_in_timer;
+
+AT32_RAMFUNC
 void usbd_cdc0_acm_bulk_in(uint8_t busid, uint8_t ep, uint32_t nbytes)
 {
     USB_LOG_RAW("cdc0 actual in len %d", nbytes);
+    if (cdc_test_in(0, nbytes))
+    {
+        return;
+    }
     if ((nbytes != 0) && (nbytes % CDC_MAX_MPS == 0))
     {
         usbd_ep_start_write(BUSID0, CDC0_IN_EP, NULL, 0); /* zero-length packet */
@@ -193,51 +270,303 @@ void usbd_cdc0_acm_bulk_in(uint8_t busid, uint8_t ep, uint32_t nbytes)
     }
 }
 
-void cdc0_write(uint8_t *buf, uint32_t nbytes)
+AT32_RAMFUNC
+void usbd_cdc1_acm_bulk_in(uint8_t busid, uint8_t ep, uint32_t nbytes)
+{
+    USB_LOG_RAW("cdc1 actual in len %d", nbytes);
+    if (cdc_test_in(1, nbytes))
+    {
+        return;
+    }
+    if ((nbytes != 0) && (nbytes % CDC_MAX_MPS == 0))
+    {
+        usbd_ep_start_write(BUSID0, CDC1_IN_EP, NULL, 0); /* zero-length packet */
+    }
+    else
+    {
+        rt_sem_release(cdc_tx_busy_sem);
+    }
+}
+
+static volatile uint8_t cdc_test_busy[CDC_IN_NUM]; /* usb test write in flight */
+
+/* send one usb transfer and wait until finished. false if not sent */
+static bool cdc_ep_write(struct cdc_in_stream *s, uint8_t *buf, uint32_t nbytes)
 {
-    if (!(cdc_is_configured && cdc0_dtr)) return;
     // wait until usb transmit available
     rt_sem_take(ep_write_sem, RT_WAITING_FOREVER);
-    usbd_ep_start_write(BUSID0, CDC0_IN_EP, buf, nbytes);
+    if (usb_test_mode[s - cdc_in] != USB_TEST_OFF || cdc_test_busy[s - cdc_in])
+    {
+        /* endpoint in use by usb test */
+        rt_sem_release(ep_write_sem);
+        return false;
+    }
+    usbd_ep_start_write(BUSID0, s->ep, buf, nbytes);
     // wait until usb write finished
     rt_sem_take(cdc_tx_busy_sem, RT_WAITING_FOREVER);
     rt_sem_release(ep_write_sem);
+    return true;
 }
 
-/* cdc1 writing to host */
+static void cdc_in_account(struct cdc_in_stream *s, uint32_t nbytes, rt_tick_t latency)
+{
+    s->bytes       += nbytes;
+    s->transfers   += 1;
+    s->packets     += (nbytes + CDC_MAX_MPS - 1) / CDC_MAX_MPS;
+    s->latency_sum += latency;
+    if (latency > s->latency_max)
+        s->latency_max = latency;
+}
 
-void usbd_cdc1_acm_bulk_in(uint8_t busid, uint8_t ep, uint32_t nbytes)
+static void cdc_in_write(struct cdc_in_stream *s, uint8_t *buf, uint32_t nbytes)
 {
-    USB_LOG_RAW("cdc1 actual in len %d", nbytes);
-    if ((nbytes != 0) && (nbytes % CDC_MAX_MPS == 0))
+    uint32_t len;
+
+    if (!(cdc_is_configured && *s->dtr) || nbytes == 0) return;
+    rt_mutex_take(&s->lock, RT_WAITING_FOREVER);
+    if (s->policy == CDC_FLUSH_IMMEDIATE && spsc_rb_data_len(&s->rb) == 0)
     {
-        usbd_ep_start_write(BUSID0, CDC1_IN_EP, NULL, 0); /* zero-length packet */
+        /* send from caller buffer */
+        if (cdc_ep_write(s, buf, nbytes))
+            cdc_in_account(s, nbytes, 0);
     }
     else
     {
-        rt_sem_release(cdc_tx_busy_sem);
+        while (nbytes != 0)
+        {
+            if (spsc_rb_data_len(&s->rb) == 0)
+                s->pending_since = rt_tick_get();
+            len     = spsc_rb_put(&s->rb, buf, nbytes);
+            buf    += len;
+            nbytes -= len;
+            if (nbytes != 0 || s->policy == CDC_FLUSH_IMMEDIATE || spsc_rb_data_len(&s->rb) >= s->threshold)
+                rt_sem_release(cdc_in_sem);
+            if (nbytes != 0)
+            {
+                /* buffer full. wait for cdc_in thread, drop if host went away */
+                rt_wqueue_wait(&cdc_in_wqueue, 0, CDC_IN_TIMEOUT);
+                if (!(cdc_is_configured && *s->dtr)) break;
+            }
+        }
     }
+    rt_mutex_release(&s->lock);
 }
 
-void cdc1_write(uint8_t *buf, uint32_t nbytes)
+static bool cdc_in_expired(struct cdc_in_stream *s)
 {
-    /* log all cdc1 output to file */
-    if (settings.logging_enable)
-        logger(buf, nbytes);
+    return rt_tick_get() - s->pending_since >= s->deadline;
+}
 
-    if (!(cdc_is_configured && cdc1_dtr)) return;
-    // wait until usb transmit available
+static bool cdc_in_due(struct cdc_in_stream *s)
+{
+    uint32_t len = spsc_rb_data_len(&s->rb);
+    if (len == 0) return false;
+    return s->policy == CDC_FLUSH_IMMEDIATE || len >= s->threshold || cdc_in_expired(s);
+}
+
+/* send queued data, straight from the ring buffer */
+static void cdc_in_flush(struct cdc_in_stream *s)
+{
+    uint8_t  *span;
+    uint32_t  len;
+    rt_tick_t latency;
+
+    while (cdc_in_due(s))
+    {
+        len     = spsc_rb_peek(&s->rb, &span);
+        latency = rt_tick_get() - s->pending_since;
+        /* before the deadline, only send full packets */
+        if (s->policy != CDC_FLUSH_IMMEDIATE && !cdc_in_expired(s) && len > CDC_MAX_MPS)
+            len -= len % CDC_MAX_MPS;
+        if (cdc_is_configured && *s->dtr && cdc_ep_write(s, span, len))
+            cdc_in_account(s, len, latency);
+        /* pending_since stays at the oldest byte; cdc_write() sets it again once the buffer is empty */
+        spsc_rb_commit(&s->rb, len);
+        rt_wqueue_wakeup_all(&cdc_in_wqueue, 0);
+    }
+}
+
+static void cdc_in_thread(void *parameter)
+{
+    while (1)
+    {
+        rt_sem_take(cdc_in_sem, RT_WAITING_FOREVER);
+        for (uint32_t i = 0; i < CDC_IN_NUM; i++)
+            cdc_in_flush(&cdc_in[i]);
+    }
+}
+
+/* 1 ms tick, in interrupt context. wake cdc_in thread when a deadline expires */
+static void cdc_in_timeout(void *parameter)
+{
+    for (uint32_t i = 0; i < CDC_IN_NUM; i++)
+    {
+        struct cdc_in_stream *s = &cdc_in[i];
+        if (s->policy != CDC_FLUSH_IMMEDIATE && spsc_rb_data_len(&s->rb) != 0 && cdc_in_expired(s))
+        {
+            rt_sem_release(cdc_in_sem);
+            return;
+        }
+    }
+}
+
+static void cdc_in_init()
+{
+    cdc_in_sem = rt_sem_create("cdc_in", 0, RT_IPC_FLAG_FIFO);
+    rt_wqueue_init(&cdc_in_wqueue);
+    rt_mutex_init(&cdc_in[0].lock, "cdc0_in", RT_IPC_FLAG_PRIO);
+    rt_mutex_init(&cdc_in[1].lock, "cdc1_in", RT_IPC_FLAG_PRIO);
+    rt_thread_t thread = rt_thread_create("cdc_in", cdc_in_thread, RT_NULL, 1024, 25, 10);
+    if (thread != RT_NULL)
+        rt_thread_startup(thread);
+    else
+        LOG_E("cdc_in thread fail");
+    rt_timer_init(&cdc_in_timer, "cdc_in", cdc_in_timeout, RT_NULL, 1, RT_TIMER_FLAG_PERIODIC | RT_TIMER_FLAG_HARD_TIMER);
+    rt_timer_start(&cdc_in_timer);
+}
+
+/* set flush policy. threshold in bytes, deadline in ms */
+void cdc_set_flush(uint32_t cdc_number, uint8_t policy, uint32_t threshold, uint32_t deadline_ms)
+{
+    struct cdc_in_stream *s;
+
+    if (cdc_number >= CDC_IN_NUM) return;
+    s = &cdc_in[cdc_number];
+    switch (policy)
+    {
+    case CDC_FLUSH_IMMEDIATE:
+        threshold = 1;
+        break;
+    case CDC_FLUSH_DEADLINE:
+        threshold = CDC_MAX_MPS;
+        break;
+    case CDC_FLUSH_THRESHOLD:
+        if (threshold < 1) threshold = 1;
+        if (threshold > CDC_IN_BUF_SIZE) threshold = CDC_IN_BUF_SIZE;
+        break;
+    default:
+        return;
+    }
+    rt_mutex_take(&s->lock, RT_WAITING_FOREVER);
+    s->policy    = policy;
+    s->threshold = threshold;
+    s->deadline  = rt_tick_from_millisecond(deadline_ms);
+    rt_mutex_release(&s->lock);
+    /* send what is queued under the new policy */
+    rt_sem_release(cdc_in_sem);
+}
+
+/* usb test ******************************************************************/
+
+/* usb loopback and throughput test, in usb interrupt. see usb_test.c */
+
+#define CDC_TEST_IDLE      0
+#define CDC_TEST_SOURCE    1 /* pattern write in flight */
+#define CDC_TEST_ECHO      2 /* echo write in flight, next read after write */
+#define CDC_TEST_ABANDONED 3 /* host stopped reading during test */
+
+static void cdc_test_next_read(uint32_t port)
+{
+    if (port == 0)
+        cdc0_next_read();
+    else
+        cdc1_next_read();
+}
+
+/* in transfer finished. returns true if transfer belonged to usb test */
+static bool cdc_test_in(uint32_t port, uint32_t nbytes)
+{
+    uint8_t busy = cdc_test_busy[port];
+
+    if (busy == CDC_TEST_IDLE) return false;
+    usb_test_tx(port, nbytes);
+    if (busy == CDC_TEST_SOURCE && usb_test_mode[port] == USB_TEST_SOURCE)
+    {
+        usbd_ep_start_write(BUSID0, cdc_in[port].ep, usb_test_pattern, USB_TEST_PATTERN_SIZE);
+    }
+    else if (busy == CDC_TEST_ECHO && nbytes != 0 && nbytes % CDC_MAX_MPS == 0)
+    {
+        usbd_ep_start_write(BUSID0, cdc_in[port].ep, NULL, 0); /* zero-length packet */
+    }
+    else
+    {
+        cdc_test_busy[port] = CDC_TEST_IDLE;
+        if (busy == CDC_TEST_ECHO)
+            cdc_test_next_read(port);
+    }
+    return true;
+}
+
+/* out transfer received. returns true if transfer belonged to usb test */
+static bool cdc_test_out(uint32_t port, uint8_t *buf, uint32_t nbytes)
+{
+    uint8_t mode = usb_test_mode[port];
+
+    if (mode == USB_TEST_OFF) return false;
+    usb_test_rx(port, nbytes);
+    if (mode == USB_TEST_ECHO && nbytes != 0 && cdc_test_busy[port] == CDC_TEST_IDLE)
+    {
+        cdc_test_busy[port] = CDC_TEST_ECHO;
+        usbd_ep_start_write(BUSID0, cdc_in[port].ep, buf, nbytes);
+    }
+    else
+    {
+        cdc_test_next_read(port);
+    }
+    return true;
+}
+
+/* start or stop usb test on cdc0 or cdc1. regular writes are dropped while the test runs. */
+void cdc_test_set(uint32_t port, uint8_t mode)
+{
+    struct cdc_in_stream *s;
+
+    if (port >= CDC_IN_NUM) return;
+    s = &cdc_in[port];
+    rt_mutex_take(&s->lock, RT_WAITING_FOREVER);
+    /* no regular write in flight */
     rt_sem_take(ep_write_sem, RT_WAITING_FOREVER);
-    usbd_ep_start_write(BUSID0, CDC1_IN_EP, buf, nbytes);
-    // wait until usb write finished
-    rt_sem_take(cdc_tx_busy_sem, RT_WAITING_FOREVER);
+    /* stop running test */
+    usb_test_mode[port] = USB_TEST_OFF;
+    for (uint32_t i = 0; i < 100 && cdc_test_busy[port] != CDC_TEST_IDLE; i++)
+        rt_thread_mdelay(1);
+    if (cdc_test_busy[port] != CDC_TEST_IDLE)
+    {
+        LOG_E("%s test write not finished", s->name);
+        cdc_test_busy[port] = CDC_TEST_ABANDONED;
+    }
+    /* start new test */
+    usb_test_mode[port] = mode;
+    if (mode == USB_TEST_SOURCE && cdc_is_configured && *s->dtr && cdc_test_busy[port] == CDC_TEST_IDLE)
+    {
+        cdc_test_busy[port] = CDC_TEST_SOURCE;
+        usbd_ep_start_write(BUSID0, s->ep, usb_test_pattern, USB_TEST_PATTERN_SIZE);
+    }
+    if (port == 0 && !cdc0_read_busy)
+        cdc0_next_read();
     rt_sem_release(ep_write_sem);
+    rt_mutex_release(&s->lock);
+}
+
+/* cdc0 writing to host */
+
+void cdc0_write(uint8_t *buf, uint32_t nbytes)
+{
+    cdc_in_write(&cdc_in[0], buf, nbytes);
+}
+
+/* cdc1 writing to host */
+
+void cdc1_write(uint8_t *buf, uint32_t nbytes)
+{
+    cdc_in_write(&cdc_in[1], buf, nbytes);
 }
 
 /* read from host *************************************************************/
 
 /* cdc0 reading from host */
 
+AT32_RAMFUNC
 static void cdc0_next_read()
 {
     USB_LOG_RAW("cdc0 next read");
@@ -245,13 +574,16 @@ static void cdc0_next_read()
     cdc0_read_busy = true;
 }
 
+AT32_RAMFUNC
 void usbd_cdc0_acm_bulk_out(uint8_t busid, uint8_t ep, uint32_t nbytes)
 {
     USB_LOG_RAW("cdc0 actual out len %d", nbytes);
-    rt_ringbuffer_put(&cdc0_read_rb, cdc0_read_buffer, nbytes);
+    if (cdc_test_out(0, cdc0_read_buffer, nbytes))
+        return;
+    spsc_rb_put(&cdc0_read_rb, cdc0_read_buffer, nbytes);
     if (nbytes > 0)
         rt_wqueue_wakeup_all(&cdc0_wqueue, 0);
-    if (rt_ringbuffer_space_len(&cdc0_read_rb) >= CDC_MAX_MPS)
+    if (spsc_rb_space_len(&cdc0_read_rb) >= CDC_MAX_MPS)
         cdc0_next_read();
     else
         cdc0_read_busy = false;
@@ -260,8 +592,8 @@ void usbd_cdc0_acm_bulk_out(uint8_t busid, uint8_t ep, uint32_t nbytes)
 uint32_t cdc0_get(uint8_t *buf, uint16_t length)
 {
     rt_size_t len;
-    len = rt_ringbuffer_get(&cdc0_read_rb, buf, length);
-    if (!cdc0_read_busy && rt_ringbuffer_space_len(&cdc0_read_rb) >= CDC_MAX_MPS)
+    len = spsc_rb_get(&cdc0_read_rb, buf, length);
+    if (!cdc0_read_busy && spsc_rb_space_len(&cdc0_read_rb) >= CDC_MAX_MPS)
     {
         cdc0_next_read();
     }
@@ -272,8 +604,8 @@ char cdc0_getchar()
 {
     char      ch;
     rt_size_t len;
-    len = rt_ringbuffer_getchar(&cdc0_read_rb, &ch);
-    if (!cdc0_read_busy && rt_ringbuffer_space_len(&cdc0_read_rb) >= CDC_MAX_MPS)
+    len = spsc_rb_getchar(&cdc0_read_rb, (uint8_t *)&ch);
+    if (!cdc0_read_busy && spsc_rb_space_len(&cdc0_read_rb) >= CDC_MAX_MPS)
     {
         cdc0_next_read();
     }
@@ -289,9 +621,9 @@ char cdc0_getchar_timeout(uint32_t timeout_ticks)
     rt_size_t len = 0;
 
     /* take character from ringbuffer */
-    len = rt_ringbuffer_getchar(&cdc0_read_rb, &ch);
+    len = spsc_rb_getchar(&cdc0_read_rb, (uint8_t *)&ch);
     /* schedule next usb read */
-    if (!cdc0_read_busy && rt_ringbuffer_space_len(&cdc0_read_rb) >= CDC_MAX_MPS)
+    if (!cdc0_read_busy && spsc_rb_space_len(&cdc0_read_rb) >= CDC_MAX_MPS)
     {
         cdc0_next_read();
     }
@@ -301,8 +633,8 @@ char cdc0_getchar_timeout(uint32_t timeout_ticks)
     /* no characters in ringbuffer, wait until next character is available */
     rt_wqueue_wait(&cdc0_wqueue, 0, timeout_ticks);
     /* take character from ringbuffer */
-    len = rt_ringbuffer_getchar(&cdc0_read_rb, &ch);
-    if (!cdc0_read_busy && rt_ringbuffer_space_len(&cdc0_read_rb) >= CDC_MAX_MPS)
+    len = spsc_rb_getchar(&cdc0_read_rb, (uint8_t *)&ch);
+    if (!cdc0_read_busy && spsc_rb_space_len(&cdc0_read_rb) >= CDC_MAX_MPS)
     {
         cdc0_next_read();
     }
@@ -313,22 +645,46 @@ char cdc0_getchar_timeout(uint32_t timeout_ticks)
     return -1;
 }
 
+/* read all available characters, up to length.
+   if no characters are available, wait at most timeout_ticks for the next usb packet. */
+uint32_t cdc0_read(uint8_t *buf, uint32_t length, uint32_t timeout_ticks)
+{
+    rt_size_t len;
+
+    len = spsc_rb_get(&cdc0_read_rb, buf, length);
+    if (len == 0 && timeout_ticks != 0)
+    {
+        rt_wqueue_wait(&cdc0_wqueue, 0, timeout_ticks);
+        len = spsc_rb_get(&cdc0_read_rb, buf, length);
+    }
+    /* schedule next usb read */
+    if (!cdc0_read_busy && spsc_rb_space_len(&cdc0_read_rb) >= CDC_MAX_MPS)
+    {
+        cdc0_next_read();
+    }
+    return len;
+}
+
 bool cdc0_recv_empty()
 {
-    return rt_ringbuffer_data_len(&cdc0_read_rb) == 0;
+    return spsc_rb_data_len(&cdc0_read_rb) == 0;
 }
 
 /* cdc1 reading from host */
 
+AT32_RAMFUNC
 static void cdc1_next_read()
 {
     USB_LOG_RAW("cdc1 next read");
     usbd_ep_start_read(BUSID0, CDC1_OUT_EP, cdc1_read_buffer, sizeof(cdc1_read_buffer));
 }
 
+AT32_RAMFUNC
 void usbd_cdc1_acm_bulk_out(uint8_t busid, uint8_t ep, uint32_t nbytes)
 {
     USB_LOG_RAW("cdc1 actual out len %d", nbytes);
+    if (cdc_test_out(1, cdc1_read_buffer, nbytes))
+        return;
     cdc1_out_nbytes = nbytes;
     rt_sem_release(cdc1_out_sem);
 }
@@ -347,33 +703,63 @@ static void cdc1_out_thread(void *parameter)
             continue;
         }
 #endif
-        switch (settings.cdc1_output)
+        route_write(ROUTE_SRC_CDC1, cdc1_read_buffer, cdc1_out_nbytes);
+        cdc1_next_read();
+    }
+}
+
+
+#ifdef RT_USING_FINSH
+static void print_cdc_in()
+{
+    rt_kprintf("port policy    thresh deadline bytes      transfers  packets    fill%% latency avg/max ms\r\n");
+    for (uint32_t i = 0; i < CDC_IN_NUM; i++)
+    {
+        struct cdc_in_stream *s    = &cdc_in[i];
+        uint32_t              fill = s->packets ? (uint64_t)s->bytes * 100 / ((uint64_t)s->packets * CDC_MAX_MPS) : 0;
+        uint32_t              avg  = s->transfers ? s->latency_sum / s->transfers : 0;
+        rt_kprintf("%-4s %-9s %6d %8d %-10u %-10u %-10u %5d %7d/%d\r\n", s->name, cdc_flush_name[s->policy],
+                   s->threshold, s->deadline * 1000 / RT_TICK_PER_SECOND, s->bytes, s->transfers, s->packets,
+                   fill, avg * 1000 / RT_TICK_PER_SECOND, s->latency_max * 1000 / RT_TICK_PER_SECOND);
+    }
+}
+
+static int cmd_cdc(int argc, char **argv)
+{
+    uint32_t cdc_number = 0;
+
+    if (argc >= 2)
+        cdc_number = !strcmp(argv[1], "cdc0") ? 0 : !strcmp(argv[1], "cdc1") ? 1 : CDC_IN_NUM;
+
+    if (argc == 1)
+        print_cdc_in();
+    else if (argc == 2 && !strcmp(argv[1], "clear"))
+    {
+        for (uint32_t i = 0; i < CDC_IN_NUM; i++)
         {
-        case CDC1_SERIAL0:
-            USB_LOG_RAW("cdc1 out serial0 %d", cdc1_out_nbytes);
-            if (settings.serial0_enable)
-                serial0_write(cdc1_read_buffer, cdc1_out_nbytes);
-            break;
-        case CDC1_SERIAL1:
-            USB_LOG_RAW("cdc1 out serial1 %d", cdc1_out_nbytes);
-            if (settings.serial1_enable)
-                serial1_write(cdc1_read_buffer, cdc1_out_nbytes);
-            break;
-        case CDC1_RTT:
-            USB_LOG_RAW("cdc1 out rtt %d", cdc1_out_nbytes);
-            if (settings.rtt_enable)
-                rtt_read(cdc1_read_buffer, cdc1_out_nbytes);
-            break;
-        case CDC1_CAN:
-            USB_LOG_RAW("cdc1 out can %d", cdc1_out_nbytes);
-            if (settings.can1_slcan)
-                slcan_process(cdc1_read_buffer, cdc1_out_nbytes);
-            break;
-        default:
-            USB_LOG_RAW("cdc1 out unknown port %d", settings.cdc1_output);
-            break;
+            cdc_in[i].bytes       = 0;
+            cdc_in[i].transfers   = 0;
+            cdc_in[i].packets     = 0;
+            cdc_in[i].latency_sum = 0;
+            cdc_in[i].latency_max = 0;
         }
-        cdc1_next_read();
     }
+    else if (argc == 3 && cdc_number < CDC_IN_NUM && !strcmp(argv[2], "immediate"))
+        cdc_set_flush(cdc_number, CDC_FLUSH_IMMEDIATE, 0, 0);
+    else if (argc == 4 && cdc_number < CDC_IN_NUM && !strcmp(argv[2], "deadline"))
+        cdc_set_flush(cdc_number, CDC_FLUSH_DEADLINE, 0, atoi(argv[3]));
+    else if (argc == 5 && cdc_number < CDC_IN_NUM && !strcmp(argv[2], "threshold"))
+        cdc_set_flush(cdc_number, CDC_FLUSH_THRESHOLD, atoi(argv[3]), atoi(argv[4]));
+    else
+    {
+        rt_kprintf("%s                                  print usb in statistics\r\n", argv[0]);
+        rt_kprintf("%s clear                            clear statistics\r\n", argv[0]);
+        rt_kprintf("%s cdc0|cdc1 immediate              send every write at once\r\n", argv[0]);
+        rt_kprintf("%s cdc0|cdc1 deadline ms            send full packets, rest after ms\r\n", argv[0]);
+        rt_kprintf("%s cdc0|cdc1 threshold bytes ms     send from bytes queued, rest after ms\r\n", argv[0]);
+    }
+    return RT_EOK;
 }
 
+MSH_CMD_EXPORT_ALIAS(cmd_cdc, cdc, usb serial flush policy);
+#endif
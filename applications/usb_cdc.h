@@ -4,7 +4,14 @@
 #include <rtthread.h>
 #include <stdbool.h>
 
+/* usb in flush policy */
+#define CDC_FLUSH_IMMEDIATE 0
+#define CDC_FLUSH_DEADLINE  1
+#define CDC_FLUSH_THRESHOLD 2
+
 void cdc_init();
+void cdc_set_flush(uint32_t cdc_number, uint8_t policy, uint32_t threshold, uint32_t deadline_ms);
+void cdc_test_set(uint32_t port, uint8_t mode);
 
 bool     cdc0_connected();
 void     cdc0_set_speed(uint32_t speed);
@@ -13,6 +20,7 @@ bool     cdc0_recv_empty();
 void     cdc0_wait_for_char();
 uint32_t cdc0_get(uint8_t *buf, uint16_t length);
 char     cdc0_getchar_timeout(uint32_t timeout_ticks);
+uint32_t cdc0_read(uint8_t *buf, uint32_t length, uint32_t timeout_ticks);
 void     cdc0_write(uint8_t *buf, uint32_t nbytes);
 
 void     cdc1_wait_for_dtr();
@@ -225,11 +225,12 @@
 #define CONFIG_USB_DWC2_TX0_FIFO_SIZE (512 / 4)
 #define CONFIG_USB_DWC2_TX1_FIFO_SIZE (512 / 4)
 #define CONFIG_USB_DWC2_TX2_FIFO_SIZE (512 / 4)
-#define CONFIG_USB_DWC2_TX3_FIFO_SIZE (512 / 4)
+/* 3 and 5 are cdc interrupt endpoints, 7 is cmsis-dap swo */
+#define CONFIG_USB_DWC2_TX3_FIFO_SIZE (64 / 4)
 #define CONFIG_USB_DWC2_TX4_FIFO_SIZE (512 / 4)
-#define CONFIG_USB_DWC2_TX5_FIFO_SIZE (256 / 4)
+#define CONFIG_USB_DWC2_TX5_FIFO_SIZE (64 / 4)
 // #define CONFIG_USB_DWC2_TX6_FIFO_SIZE (0 / 4)
-// #define CONFIG_USB_DWC2_TX7_FIFO_SIZE (0 / 4)
+#define CONFIG_USB_DWC2_TX7_FIFO_SIZE (512 / 4)
 // #define CONFIG_USB_DWC2_TX8_FIFO_SIZE (0 / 4)
 
 /* ---------------- MUSB Configuration ---------------- */
@@ -3,30 +3,203 @@
 #include "usb_desc.h"
 #include "dap_config.h"
 #include "dap.h"
+#include "usb_test.h"
+#include "swd_arbiter.h"
+
+#define DBG_TAG "DAP"
+#define DBG_LVL DBG_INFO
+#include <rtdbg.h>
+
+/*
+   cmsis-dap requests are processed in a worker thread, not in the usb interrupt.
+   request n and its response use slot n % DAP_PACKET_COUNT of the ring.
+   the next request is received while the worker processes the previous ones.
+   DAP_TransferAbort is handled in the interrupt, and sets a flag the worker polls.
+   the worker holds the swd pins for one request at a time, see swd_arbiter.h. if the
+   black magic gdb server keeps them past the timeout, the request answers DAP_ERROR.
+ */
 
 #define DAP_PACKET_COUNT DAP_CONFIG_PACKET_COUNT
 #define DAP_PACKET_SIZE  DAP_CONFIG_PACKET_SIZE
+#define DAP_STACK        2048
+#define DAP_PRIORITY     25
+
+#define ID_DAP_QUEUE_COMMANDS 0x7e
+#define DAP_ERROR             0xff
+
+static uint8_t  USB_Request[DAP_PACKET_COUNT][DAP_PACKET_SIZE];  // Request  Buffers
+static uint8_t  USB_Response[DAP_PACKET_COUNT][DAP_PACKET_SIZE]; // Response Buffers
+static uint32_t USB_ResponseSize[DAP_PACKET_COUNT];
+
+/* counters, slot is counter % DAP_PACKET_COUNT. sent <= ready <= processed <= received */
+static volatile uint32_t dap_received;  // requests received
+static volatile uint32_t dap_processed; // requests processed
+static volatile uint32_t dap_ready;     // responses that may be sent. queued responses wait
+static volatile uint32_t dap_sent;      // responses sent
+static volatile bool     dap_rx_busy;   // out transfer started
+static volatile bool     dap_tx_busy;   // in transfer started
+static volatile bool     dap_reset;     // dap_init() pending
+static uint8_t           dap_busid;
+static rt_sem_t          dap_sem = RT_NULL;
+
+// Start receiving the next request, if a slot is free. Interrupts disabled.
+AT32_RAMFUNC
+static void dap_next_read()
+{
+    if (dap_rx_busy || dap_received - dap_sent >= DAP_PACKET_COUNT)
+        return;
+    dap_rx_busy = true;
+    usbd_ep_start_read(dap_busid, DAP_OUT_EP, USB_Request[dap_received % DAP_PACKET_COUNT], DAP_PACKET_SIZE);
+}
+
+// Start sending the next response, if any. Interrupts disabled.
+AT32_RAMFUNC
+static void dap_next_write()
+{
+    uint32_t slot = dap_sent % DAP_PACKET_COUNT;
 
-static uint8_t USB_Request[DAP_PACKET_SIZE];  // Request  Buffer
-static uint8_t USB_Response[DAP_PACKET_SIZE]; // Response Buffer
+    if (dap_tx_busy || dap_sent == dap_ready)
+        return;
+    dap_tx_busy = true;
+    usbd_ep_start_write(dap_busid, DAP_IN_EP, USB_Response[slot], USB_ResponseSize[slot]);
+}
 
 // Receive first DAP request.
 void dap_configured(uint8_t busid)
 {
-    dap_init();
-    usbd_ep_start_read(busid, DAP_OUT_EP, USB_Request, DAP_PACKET_SIZE);
+    rt_base_t level = rt_hw_interrupt_disable();
+
+    dap_busid     = busid;
+    dap_received  = 0;
+    dap_processed = 0;
+    dap_ready     = 0;
+    dap_sent      = 0;
+    dap_rx_busy   = false;
+    dap_tx_busy   = false;
+    dap_reset     = true;
+    if (dap_sem != RT_NULL)
+        rt_sem_release(dap_sem);
+    dap_next_read();
+    rt_hw_interrupt_enable(level);
 }
 
-// DAP request received. Send DAP response.
+// USB loopback and throughput test. See usb_test.c
+static void dap_test_out(uint8_t busid, uint32_t nbytes)
+{
+    uint8_t *buf = USB_Request[dap_received % DAP_PACKET_COUNT];
+
+    usb_test_rx(USB_TEST_DAP, nbytes);
+    switch (usb_test_mode[USB_TEST_DAP])
+    {
+    case USB_TEST_ECHO:
+        usbd_ep_start_write(busid, DAP_IN_EP, buf, nbytes);
+        break;
+    case USB_TEST_SOURCE:
+        usbd_ep_start_write(busid, DAP_IN_EP, usb_test_pattern, DAP_PACKET_SIZE);
+        break;
+    default:
+        usbd_ep_start_read(busid, DAP_OUT_EP, buf, DAP_PACKET_SIZE);
+        break;
+    }
+}
+
+// DAP request received. Pass it to the worker thread, and receive the next request.
+AT32_RAMFUNC
 void dap_out_callback(uint8_t busid, uint8_t ep, uint32_t nbytes)
 {
-    uint32_t size = dap_process_request(USB_Request, DAP_PACKET_SIZE, USB_Response, DAP_PACKET_SIZE);
-    usbd_ep_start_write(busid, DAP_IN_EP, USB_Response, size);
+    uint8_t *req = USB_Request[dap_received % DAP_PACKET_COUNT];
+
+    if (usb_test_mode[USB_TEST_DAP] != USB_TEST_OFF)
+    {
+        dap_test_out(busid, nbytes);
+        return;
+    }
+    dap_rx_busy = false;
+    /* DAP_TransferAbort takes no slot, and has no response */
+    if (nbytes != 0 && dap_filter_request(req))
+    {
+        dap_received++;
+        rt_sem_release(dap_sem);
+    }
+    dap_next_read();
 }
 
-// DAP response sent. Receive next DAP request.
+// DAP response sent. Send the next response, and receive the next request if a slot came free.
+AT32_RAMFUNC
 void dap_in_callback(uint8_t busid, uint8_t ep, uint32_t nbytes)
 {
-    usbd_ep_start_read(busid, DAP_OUT_EP, USB_Request, DAP_PACKET_SIZE);
+    if (usb_test_mode[USB_TEST_DAP] != USB_TEST_OFF)
+    {
+        usb_test_tx(USB_TEST_DAP, nbytes);
+        usbd_ep_start_read(busid, DAP_OUT_EP, USB_Request[dap_received % DAP_PACKET_COUNT], DAP_PACKET_SIZE);
+        return;
+    }
+    dap_tx_busy = false;
+    dap_sent++;
+    dap_next_write();
+    dap_next_read();
 }
 
+/* worker thread **************************************************************/
+
+// Responses to QueueCommands requests are held back until a request that is not
+// queued is processed, or until all slots hold queued requests.
+static void dap_thread(void *parameter)
+{
+    rt_base_t level;
+    uint32_t  slot;
+    bool      queued, held;
+
+    (void)parameter;
+    while (1)
+    {
+        rt_sem_take(dap_sem, RT_WAITING_FOREVER);
+        if (dap_reset)
+        {
+            dap_reset = false;
+            held      = swd_arbiter_take(SWD_USER_DAP);
+            dap_init();
+            if (held)
+                swd_arbiter_release(SWD_USER_DAP);
+        }
+        if (dap_processed == dap_received)
+            continue;
+
+        slot   = dap_processed % DAP_PACKET_COUNT;
+        queued = USB_Request[slot][0] == ID_DAP_QUEUE_COMMANDS;
+        if (swd_arbiter_take(SWD_USER_DAP))
+        {
+            USB_ResponseSize[slot] = dap_process_request(USB_Request[slot], DAP_PACKET_SIZE, USB_Response[slot], DAP_PACKET_SIZE);
+            swd_arbiter_release(SWD_USER_DAP);
+        }
+        else
+        {
+            USB_Response[slot][0]  = USB_Request[slot][0];
+            USB_Response[slot][1]  = DAP_ERROR;
+            USB_ResponseSize[slot] = 2;
+        }
+
+        level = rt_hw_interrupt_disable();
+        /* a usb reset while processing discards the response */
+        if (!dap_reset)
+        {
+            dap_processed++;
+            if (!queued || dap_processed - dap_sent >= DAP_PACKET_COUNT)
+                dap_ready = dap_processed;
+            dap_next_write();
+        }
+        rt_hw_interrupt_enable(level);
+    }
+}
+
+void dap_usb_init()
+{
+    rt_thread_t thread;
+
+    dap_sem = rt_sem_create("dap", 0, RT_IPC_FLAG_FIFO);
+    thread  = rt_thread_create("dap", dap_thread, RT_NULL, DAP_STACK, DAP_PRIORITY, 10);
+    if (thread != RT_NULL)
+        rt_thread_startup(thread);
+    else
+        LOG_E("dap thread fail");
+}
@@ -9,6 +9,7 @@
 #include "usbd_cdc_acm.h"
 #include "dap_config.h"
 #include "usb_desc.h"
+#include "swo_capture.h"
 
 // logging
 #if 1
@@ -22,7 +23,7 @@
 #define USBD_LANGID_STRING 1033
 
 /*!< config descriptor size */
-#define CMSIS_DAP_INTERFACE_SIZE (9 + 7 + 7)
+#define CMSIS_DAP_INTERFACE_SIZE (9 + 7 + 7 + 7)
 #define USB_CONFIG_SIZE          (9 + CMSIS_DAP_INTERFACE_SIZE + CDC_ACM_DESCRIPTOR_LEN * 2)
 #define INTF_NUM                 (1 + 2 * 2)
 #define DAP_PACKET_SIZE          DAP_CONFIG_PACKET_SIZE
@@ -159,18 +160,20 @@ static const uint8_t device_descriptor[] = {
 
 static const uint8_t config_descriptor[] = {
     USB_CONFIG_DESCRIPTOR_INIT(USB_CONFIG_SIZE, INTF_NUM, 0x01, USB_CONFIG_BUS_POWERED, USBD_MAX_POWER),
-    USB_INTERFACE_DESCRIPTOR_INIT(DAP_INTF, 0x00, 0x02, 0xFF, 0x00, 0x00, 0x05),
+    USB_INTERFACE_DESCRIPTOR_INIT(DAP_INTF, 0x00, 0x03, 0xFF, 0x00, 0x00, 0x05),
     USB_ENDPOINT_DESCRIPTOR_INIT(DAP_OUT_EP, USB_ENDPOINT_TYPE_BULK, DAP_PACKET_SIZE, 0x00),
     USB_ENDPOINT_DESCRIPTOR_INIT(DAP_IN_EP, USB_ENDPOINT_TYPE_BULK, DAP_PACKET_SIZE, 0x00),
+    USB_ENDPOINT_DESCRIPTOR_INIT(DAP_SWO_EP, USB_ENDPOINT_TYPE_BULK, DAP_SWO_MPS, 0x00),
     CDC_ACM_DESCRIPTOR_INIT(CDC0_INTF, CDC0_INT_EP, CDC0_OUT_EP, CDC0_IN_EP, CDC_MAX_MPS, 0x06),
     CDC_ACM_DESCRIPTOR_INIT(CDC1_INTF, CDC1_INT_EP, CDC1_OUT_EP, CDC1_IN_EP, CDC_MAX_MPS, 0x07),
 };
 
 static const uint8_t other_speed_config_descriptor[] = {
     USB_CONFIG_DESCRIPTOR_INIT(USB_CONFIG_SIZE, INTF_NUM, 0x01, USB_CONFIG_BUS_POWERED, USBD_MAX_POWER),
-    USB_INTERFACE_DESCRIPTOR_INIT(DAP_INTF, 0x00, 0x02, 0xFF, 0x00, 0x00, 0x05),
+    USB_INTERFACE_DESCRIPTOR_INIT(DAP_INTF, 0x00, 0x03, 0xFF, 0x00, 0x00, 0x05),
     USB_ENDPOINT_DESCRIPTOR_INIT(DAP_OUT_EP, USB_ENDPOINT_TYPE_BULK, DAP_PACKET_SIZE, 0x00),
     USB_ENDPOINT_DESCRIPTOR_INIT(DAP_IN_EP, USB_ENDPOINT_TYPE_BULK, DAP_PACKET_SIZE, 0x00),
+    USB_ENDPOINT_DESCRIPTOR_INIT(DAP_SWO_EP, USB_ENDPOINT_TYPE_BULK, DAP_SWO_MPS, 0x00),
     CDC_ACM_DESCRIPTOR_INIT(CDC0_INTF, CDC0_INT_EP, CDC0_OUT_EP, CDC0_IN_EP, CDC_MAX_MPS, 0x06),
     CDC_ACM_DESCRIPTOR_INIT(CDC1_INTF, CDC1_INT_EP, CDC1_OUT_EP, CDC1_IN_EP, CDC_MAX_MPS, 0x07),
 };
@@ -263,6 +266,7 @@ static void usbd_event_handler(uint8_t busid, uint8_t event)
         break;
     case USBD_EVENT_CONFIGURED:
         dap_configured(busid);
+        swo_capture_configured(busid);
         cdc_configured(busid);
         break;
     case USBD_EVENT_SET_REMOTE_WAKEUP:
@@ -285,6 +289,10 @@ static struct usbd_endpoint dap_in_ep = {
     .ep_addr = DAP_IN_EP,
     .ep_cb   = dap_in_callback};
 
+static struct usbd_endpoint dap_swo_ep = {
+    .ep_addr = DAP_SWO_EP,
+    .ep_cb   = swo_capture_in_callback};
+
 struct usbd_endpoint cdc0_out_ep = {
     .ep_addr = CDC0_OUT_EP,
     .ep_cb   = usbd_cdc0_acm_bulk_out};
@@ -314,6 +322,7 @@ void cdc_acm_init(uint8_t busid, uintptr_t reg_base)
     usbd_add_interface(busid, &dap_intf);
     usbd_add_endpoint(busid, &dap_out_ep);
     usbd_add_endpoint(busid, &dap_in_ep);
+    usbd_add_endpoint(busid, &dap_swo_ep);
 
     usbd_add_interface(busid, usbd_cdc_acm_init_intf(busid, &cdc0_intf0));
     usbd_add_interface(busid, usbd_cdc_acm_init_intf(busid, &cdc0_intf1));
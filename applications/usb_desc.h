@@ -13,6 +13,9 @@
 #define CDC_MAX_MPS 64
 #endif
 
+/*!< swo trace endpoint packet size */
+#define DAP_SWO_MPS CDC_MAX_MPS
+
 /*!< usb bus number */
 #define BUSID0 0
 
@@ -26,6 +29,7 @@
 #define CDC1_OUT_EP 0x04
 #define CDC1_INT_EP 0x85
 #define MSC_IN_EP   0x86
+#define DAP_SWO_EP  0x87
 #define MSC_OUT_EP  0x06
 
 /*!< interface number */
@@ -36,6 +40,7 @@
 
 void cdc_acm_init(uint8_t busid, uintptr_t reg_base);
 
+void dap_usb_init();
 void dap_configured(uint8_t busid);
 void dap_out_callback(uint8_t busid, uint8_t ep, uint32_t nbytes);
 void dap_in_callback(uint8_t busid, uint8_t ep, uint32_t nbytes);
@@ -1,5 +1,6 @@
 #include <rtthread.h>
 #include <rtdevice.h>
+#include <board.h>
 
 #include "drv_common.h"
 #include "at32_msp.h"
@@ -26,6 +27,7 @@ void usb_dc_low_level_init(void)
     nvic_irq_enable(OTGHS_IRQn, 0, 0);
 }
 
+AT32_RAMFUNC
 void OTGHS_IRQHandler(void)
 {
     extern void USBD_IRQHandler(uint8_t busid);
@@ -34,6 +36,7 @@ void OTGHS_IRQHandler(void)
 
 int usbd_app_init(void)
 {
+    dap_usb_init();
     cdc_init();
     cdc_acm_init(0, OTGHS_BASE);
     return 0;
@@ -0,0 +1,104 @@
+#include <rtthread.h>
+#include <string.h>
+#include "usbd_core.h"
+#include "usb_cdc.h"
+#include "usb_test.h"
+#include "names.h"
+
+/* usb loopback and throughput test. see usb_test.h */
+
+struct usb_test_count
+{
+    uint32_t rx_bytes;
+    uint32_t rx_packets;
+    uint32_t tx_bytes;
+    uint32_t tx_packets;
+    uint32_t stalls; /* milliseconds without traffic, after the first packet */
+    uint32_t last_bytes;
+};
+
+static const char *const usb_test_port_name[USB_TEST_PORT_NUM] = {"cdc0", "cdc1", "dap"};
+static const char *const usb_test_mode_name[]                  = {"off", "echo", "sink", "source"};
+
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t usb_test_pattern[USB_TEST_PATTERN_SIZE];
+volatile uint8_t                               usb_test_mode[USB_TEST_PORT_NUM];
+static struct usb_test_count                   usb_test_count[USB_TEST_PORT_NUM];
+static struct rt_timer                         usb_test_timer;
+static bool                                    usb_test_timer_init = false;
+
+void usb_test_rx(uint32_t port, uint32_t nbytes)
+{
+    usb_test_count[port].rx_bytes   += nbytes;
+    usb_test_count[port].rx_packets += 1;
+}
+
+void usb_test_tx(uint32_t port, uint32_t nbytes)
+{
+    usb_test_count[port].tx_bytes   += nbytes;
+    usb_test_count[port].tx_packets += 1;
+}
+
+/* 1 ms tick, in interrupt context. count milliseconds without traffic */
+static void usb_test_timeout(void *parameter)
+{
+    for (uint32_t i = 0; i < USB_TEST_PORT_NUM; i++)
+    {
+        struct usb_test_count *c     = &usb_test_count[i];
+        uint32_t               bytes = c->rx_bytes + c->tx_bytes;
+        if (usb_test_mode[i] == USB_TEST_OFF) continue;
+        if (bytes != 0 && bytes == c->last_bytes)
+            c->stalls++;
+        c->last_bytes = bytes;
+    }
+}
+
+static void usb_test_set(uint32_t port, uint8_t mode)
+{
+    if (!usb_test_timer_init)
+    {
+        for (uint32_t i = 0; i < sizeof(usb_test_pattern); i++)
+            usb_test_pattern[i] = i;
+        rt_timer_init(&usb_test_timer, "usbtest", usb_test_timeout, RT_NULL, 1, RT_TIMER_FLAG_PERIODIC | RT_TIMER_FLAG_HARD_TIMER);
+        rt_timer_start(&usb_test_timer);
+        usb_test_timer_init = true;
+    }
+    memset(&usb_test_count[port], 0, sizeof(usb_test_count[port]));
+    if (port == USB_TEST_DAP)
+        usb_test_mode[port] = mode; /* takes effect with the next dap request */
+    else
+        cdc_test_set(port, mode);
+}
+
+#ifdef RT_USING_FINSH
+static void print_usb_test()
+{
+    rt_kprintf("port mode   rx bytes   rx packets tx bytes   tx packets stalls\r\n");
+    for (uint32_t i = 0; i < USB_TEST_PORT_NUM; i++)
+    {
+        struct usb_test_count *c = &usb_test_count[i];
+        rt_kprintf("%-4s %-6s %-10u %-10u %-10u %-10u %u\r\n", usb_test_port_name[i], usb_test_mode_name[usb_test_mode[i]],
+                   c->rx_bytes, c->rx_packets, c->tx_bytes, c->tx_packets, c->stalls);
+    }
+}
+
+static int cmd_usbtest(int argc, char **argv)
+{
+    int32_t port, mode;
+
+    if (argc == 1)
+        print_usb_test();
+    else if (argc == 3 &&
+             (port = find_name(usb_test_port_name, USB_TEST_PORT_NUM, argv[1])) >= 0 &&
+             (mode = find_name(usb_test_mode_name, sizeof(usb_test_mode_name) / sizeof(usb_test_mode_name[0]), argv[2])) >= 0)
+        usb_test_set(port, mode);
+    else
+    {
+        rt_kprintf("%s                                    print counters\r\n", argv[0]);
+        rt_kprintf("%s cdc0|cdc1|dap off|echo|sink|source start or stop test, clear counters\r\n", argv[0]);
+        rt_kprintf("run tools/usb_bench on the host\r\n");
+    }
+    return RT_EOK;
+}
+
+MSH_CMD_EXPORT_ALIAS(cmd_usbtest, usbtest, usb loopback and throughput test);
+#endif
@@ -0,0 +1,32 @@
+#ifndef _USB_TEST_H
+#define _USB_TEST_H
+
+#include <stdint.h>
+
+/*
+   usb loopback and throughput test.
+   echo:   packets from the host are sent back.
+   sink:   packets from the host are discarded.
+   source: a byte pattern is sent to the host. on dap, every packet from the host is answered with a full packet.
+ */
+
+#define USB_TEST_OFF    0
+#define USB_TEST_ECHO   1
+#define USB_TEST_SINK   2
+#define USB_TEST_SOURCE 3
+
+#define USB_TEST_CDC0     0
+#define USB_TEST_CDC1     1
+#define USB_TEST_DAP      2
+#define USB_TEST_PORT_NUM 3
+
+#define USB_TEST_PATTERN_SIZE 2048
+
+extern uint8_t          usb_test_pattern[USB_TEST_PATTERN_SIZE];
+extern volatile uint8_t usb_test_mode[USB_TEST_PORT_NUM];
+
+/* called from usb interrupt */
+void usb_test_rx(uint32_t port, uint32_t nbytes);
+void usb_test_tx(uint32_t port, uint32_t nbytes);
+
+#endif
@@ -45,6 +45,15 @@ extern int __bss_end;
 
 #define HEAP_END                        AT32_SRAM_END
 
+/* code runs in place from qspi flash, and stalls on cache misses. functions marked
+   AT32_RAMFUNC run from sram instead: link.lds puts them in .data, and the startup
+   code copies them with the initialized data. */
+#ifdef BSP_USING_RAMFUNC
+#define AT32_RAMFUNC                    __attribute__((section(".ramfunc"), noinline))
+#else
+#define AT32_RAMFUNC
+#endif
+
 void system_clock_config(void);
 
 #ifdef __cplusplus
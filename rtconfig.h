@@ -542,6 +542,7 @@
 /* On-chip Peripheral Drivers */
 
 #define BSP_USING_GPIO
+#define BSP_USING_RAMFUNC
 #define BSP_USING_RTC
 #define BSP_RTC_USING_LEXT
 #define BSP_USING_UART
@@ -0,0 +1,147 @@
+// dap_config.h for running free-dap dap.c on the host, against a simulated target.
+// The pin functions drive the swd target model in swd_target.c.
+
+#ifndef _DAP_CONFIG_H_
+#define _DAP_CONFIG_H_
+
+#define DAP_CONFIG_ENABLE_JTAG 1
+#define DAP_CONFIG_ENABLE_TIMESTAMP 1
+
+/*- Includes ----------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+#include "swd_target.h"
+#include "jtag_target.h"
+
+/*- Definitions -------------------------------------------------------------*/
+#define DAP_CONFIG_DEFAULT_PORT        DAP_PORT_SWD
+#define DAP_CONFIG_DEFAULT_CLOCK       1000000 // Hz
+
+#define DAP_CONFIG_PACKET_SIZE         512
+#define DAP_CONFIG_PACKET_COUNT        4
+
+#define DAP_CONFIG_JTAG_DEV_COUNT      8
+
+// 1 us is 100 swclk edges, see DAP_CONFIG_CYCLES()
+#define DAP_CONFIG_WAIT_BUDGET_US      20000
+
+#define DAP_CONFIG_VENDOR_STR          "Alex Taradov"
+#define DAP_CONFIG_PRODUCT_STR         "Generic CMSIS-DAP Adapter"
+#define DAP_CONFIG_SER_NUM_STR         "dap_sim"
+#define DAP_CONFIG_CMSIS_DAP_VER_STR   "2.0.0"
+
+#define DAP_CONFIG_PERFORMANCE_ATTR
+
+#define DAP_CONFIG_DELAY_CONSTANT      14300
+#define DAP_CONFIG_FAST_CLOCK          910000
+
+#define DAP_CONFIG_VENDOR_FN           dap_vendor_command
+
+// swclk auto-tune cache, in dap_sim.c
+uint32_t tune_lookup(uint32_t idcode);
+void tune_store(uint32_t idcode, uint32_t freq);
+#define DAP_CONFIG_TUNE_LOOKUP(idcode)       tune_lookup(idcode)
+#define DAP_CONFIG_TUNE_STORE(idcode, freq)  tune_store(idcode, freq)
+
+// Transfer timestamps count swclk edges
+#define DAP_CONFIG_TIMESTAMP_CLOCK     DAP_CONFIG_DEFAULT_CLOCK
+#define DAP_CONFIG_TIMESTAMP()         swd_target_edges
+
+/*- Implementations ---------------------------------------------------------*/
+
+// swclk, swdio and the swdio direction are modelled; tck, tms, tdi and tdo
+// clock the jtag model after a jtag connect. the other pins read high.
+// While a benchmark plays back recorded target input, the model is bypassed.
+static inline void DAP_CONFIG_SWCLK_TCK_set(void)
+{
+  if (swd_target_playback)
+    swd_target_edges++;
+  else
+    swd_target_clock_high();
+}
+
+static inline void DAP_CONFIG_SWCLK_TCK_clr(void)
+{
+  if (!swd_target_playback)
+    swd_target_clock_low();
+}
+
+static inline void DAP_CONFIG_SWCLK_TCK_write(int value)
+{
+  if (value)
+    DAP_CONFIG_SWCLK_TCK_set();
+  else
+    DAP_CONFIG_SWCLK_TCK_clr();
+}
+
+static inline void DAP_CONFIG_SWDIO_TMS_write(int value)
+{
+  swd_host_swdio = value ? 1 : 0;
+}
+
+static inline void DAP_CONFIG_SWCLK_TCK_clr_SWDIO_TMS_write(int value)
+{
+  DAP_CONFIG_SWCLK_TCK_clr();
+  swd_host_swdio = value ? 1 : 0;
+}
+
+static inline void DAP_CONFIG_SWCLK_TCK_clr_TDI_write(int value)
+{
+  DAP_CONFIG_SWCLK_TCK_clr();
+  jtag_host_tdi = value ? 1 : 0;
+}
+
+static inline void DAP_CONFIG_TDI_write(int value)   { jtag_host_tdi = value ? 1 : 0; }
+static inline void DAP_CONFIG_TDO_write(int value)   { (void)value; }
+static inline void DAP_CONFIG_nTRST_write(int value) { (void)value; }
+static inline void DAP_CONFIG_nRESET_write(int value){ (void)value; }
+
+static inline int DAP_CONFIG_SWCLK_TCK_read(void)    { return swd_target_clock_read(); }
+// the host misreads target bits above swd_target_config.max_freq
+int dap_clock_get(void);
+
+static inline int DAP_CONFIG_SWDIO_TMS_read(void)
+{
+  if (swd_target_playback && !swd_host_swdio_out)
+    return *swd_target_playback++;
+  if (!swd_host_swdio_out)
+    return swd_target_swdio_read() ^ swd_target_misread(dap_clock_get());
+  return swd_target_swdio_read();
+}
+
+static inline int DAP_CONFIG_TDO_read(void)          { return jtag_target_tdo(); }
+static inline int DAP_CONFIG_TDI_read(void)          { return 1; }
+static inline int DAP_CONFIG_nTRST_read(void)        { return 1; }
+static inline int DAP_CONFIG_nRESET_read(void)       { return 1; }
+
+static inline void DAP_CONFIG_SWDIO_TMS_in(void)     { swd_host_swdio_out = false; }
+static inline void DAP_CONFIG_SWDIO_TMS_out(void)    { swd_host_swdio_out = true; }
+
+static inline void DAP_CONFIG_SETUP(void)            { swd_host_swdio_out = false; }
+static inline void DAP_CONFIG_DISCONNECT(void)       { swd_host_swdio_out = false; }
+static inline void DAP_CONFIG_CONNECT_SWD(void)      { swd_target_jtag = false; swd_host_swdio_out = true; swd_host_swdio = 1; swd_target_clock_high(); }
+static inline void DAP_CONFIG_CONNECT_JTAG(void)     { swd_target_jtag = true; swd_host_swdio_out = true; swd_host_swdio = 1; jtag_host_tdi = 1; swd_target_clock_high(); }
+static inline void DAP_CONFIG_LED(int index, int state) { (void)index; (void)state; }
+
+// no dma waveform engine; sequences are clocked bit by bit
+#define DAP_CONFIG_WAVE_NONE           (-1)
+#define DAP_CONFIG_WAVE_MIN_BITS       16
+#define DAP_CONFIG_WAVE_SWDIO_TMS      0
+#define DAP_CONFIG_WAVE_TDI            0
+#define DAP_CONFIG_WAVE_TDO            0
+
+static inline bool DAP_CONFIG_WAVE(int out_pin, uint8_t *out, int in_pin, uint8_t *in, int bits, int freq)
+{
+  (void)out_pin; (void)out; (void)in_pin; (void)in; (void)bits; (void)freq;
+  return false;
+}
+
+// time is counted in swclk edges: one "cycle" per rising edge
+#define DAP_CONFIG_CPU_HZ              100000000
+
+static inline void DAP_CONFIG_CYCLES_INIT(void) {}
+static inline uint32_t DAP_CONFIG_CYCLES(void)  { return swd_target_edges; }
+static inline uint32_t DAP_CONFIG_MILLISECONDS(void) { return swd_target_edges / 1000; }
+static inline void DAP_CONFIG_DELAY(uint32_t cycles) { (void)cycles; }
+
+#endif // _DAP_CONFIG_H_
@@ -0,0 +1,1800 @@
+// run free-dap against a simulated swd target, on the host.
+// usage: dap_sim [-e bit|word|verify] [-w every] [-W count] [pages | blocks [kbytes] | dump [kbytes] | jtag [requests] | replay file | check]
+// pages: replays a flash programming trace twice: one command per usb packet,
+//   and batched with ExecuteCommands and QueueCommands.
+//   checks both give the same responses and target memory, and counts usb round trips.
+// replay: sends the requests in a trace file, compares the responses, and counts swclk edges.
+// jtag: tck edges and ir scans per request on a jtag chain of four.
+// blocks: host cpu time of 1 kbyte TransferBlock reads, per swd engine.
+// dump: usb traffic of a target ram dump, with TransferBlock and with the vendor bulk read.
+// check: protocol checks for each swd engine: posted reads, TransferBlock, vendor commands,
+//   match value, WAIT retry, FAULT and sticky errors, handover to another debugger, batching.
+// -w, -W: every nth ap access answers WAIT, W times.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <time.h>
+#include "dap_config.h"
+#include "dap.h"
+
+#define PACKET_SIZE  DAP_CONFIG_PACKET_SIZE
+#define PACKET_COUNT DAP_CONFIG_PACKET_COUNT
+#define MAX_COMMANDS 100000
+#define BLOCK_WORDS  126 /* words per TransferBlock that fit a 512 byte packet */
+#define PAGE_SIZE    1024
+#define FLASH        (SWD_TARGET_RAM + 0x8000) /* flash, modelled as ram */
+#define USB_RTT_US   125 /* one high speed microframe per round trip */
+
+#define ID_DAP_INFO               0x00
+#define ID_DAP_CONNECT            0x02
+#define ID_DAP_DISCONNECT         0x03
+#define ID_DAP_TRANSFER_CONFIGURE 0x04
+#define ID_DAP_TRANSFER           0x05
+#define ID_DAP_TRANSFER_BLOCK     0x06
+#define ID_DAP_SWJ_CLOCK          0x11
+#define ID_DAP_SWJ_SEQUENCE       0x12
+#define ID_DAP_SWD_CONFIGURE      0x13
+#define ID_DAP_JTAG_SEQUENCE      0x14
+#define ID_DAP_JTAG_CONFIGURE     0x15
+#define ID_DAP_JTAG_IDCODE        0x16
+#define ID_DAP_QUEUE_COMMANDS     0x7e
+#define ID_DAP_EXECUTE_COMMANDS   0x7f
+#define ID_DAP_VENDOR_CRC32       0x80 /* dap_vendor.c */
+#define ID_DAP_VENDOR_COMPARE     0x81
+#define ID_DAP_VENDOR_READ        0x82
+#define ID_DAP_VENDOR_READ_NEXT   0x83
+#define ID_DAP_VENDOR_WRITE       0x84
+#define ID_DAP_VENDOR_WRITE_NEXT  0x85
+#define ID_DAP_VENDOR_STATS       0x86
+#define ID_DAP_VENDOR_TUNE        0x87
+#define VENDOR_READ_WORDS         127 /* words per vendor read that fit a 512 byte packet */
+
+#define DP_ABORT   0x00
+#define DP_RDBUFF  0x0e
+#define DP_IDCODE  0x02
+#define DP_CTRL_W  0x04
+#define DP_CTRL_R  0x06
+#define DP_SELECT  0x08
+#define AP_CSW     0x01
+#define AP_CSW_R   0x03
+#define AP_TAR_R   0x07
+#define AP_TAR     0x05
+#define AP_DRW_W   0x0d
+#define AP_DRW_R   0x0f
+#define AP_IDR_R   0x0f /* with SELECT bank 0xf0 */
+#define MATCH_VALUE 0x10
+#define MATCH_MASK  0x20
+#define TIMESTAMP   0x80
+
+#define ACK_OK       0x01
+#define ACK_WAIT     0x02
+#define ACK_FAULT    0x04
+#define ACK_MISMATCH 0x10
+
+#define DHCSR 0xe000edf0
+#define DCRSR 0xe000edf4
+#define DCRDR 0xe000edf8
+
+struct command
+{
+    uint8_t req[PACKET_SIZE];
+    int     len;
+    int     resp_max; /* largest response */
+    bool    sync;     /* host needs the response before the next command */
+};
+
+struct run
+{
+    const char *name;
+    uint32_t    round_trips;
+    uint32_t    packets;
+    uint32_t    bytes_out;
+    uint32_t    bytes_in;
+    uint32_t    edges;
+    uint8_t    *resp; /* responses of all commands, concatenated */
+    uint32_t    resp_len;
+};
+
+static struct command *trace;
+static int             trace_len;
+static uint8_t        *image;
+static int             engine = DAP_SWD_ENGINE_BIT;
+static const char     *engine_name[] = {"bit", "word", "verify"};
+
+/* trace ***********************************************************************/
+
+static struct command *cmd_new(uint8_t id)
+{
+    struct command *c = &trace[trace_len++];
+
+    if (trace_len > MAX_COMMANDS)
+    {
+        fprintf(stderr, "trace too long\n");
+        exit(1);
+    }
+    memset(c, 0, sizeof(*c));
+    c->req[c->len++] = id;
+    c->resp_max      = 64;
+    return c;
+}
+
+static void cmd_byte(struct command *c, uint8_t value)
+{
+    c->req[c->len++] = value;
+}
+
+static void cmd_word(struct command *c, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        cmd_byte(c, value >> (8 * i));
+}
+
+static void info(uint8_t index)
+{
+    struct command *c = cmd_new(ID_DAP_INFO);
+    cmd_byte(c, index);
+    c->sync = true;
+}
+
+static void swj_sequence(int bits, const uint8_t *data)
+{
+    struct command *c = cmd_new(ID_DAP_SWJ_SEQUENCE);
+    cmd_byte(c, bits);
+    for (int i = 0; i < (bits + 7) / 8; i++)
+        cmd_byte(c, data[i]);
+}
+
+/* Transfer: up to 8 requests, built with xfer_*() */
+static struct command *xfer_begin()
+{
+    struct command *c = cmd_new(ID_DAP_TRANSFER);
+    cmd_byte(c, 0); /* dap index */
+    cmd_byte(c, 0); /* count */
+    c->resp_max = 3;
+    return c;
+}
+
+static void xfer_write(struct command *c, uint8_t request, uint32_t value)
+{
+    c->req[2]++;
+    cmd_byte(c, request);
+    cmd_word(c, value);
+    if (request & TIMESTAMP)
+        c->resp_max += 4;
+}
+
+static void xfer_read(struct command *c, uint8_t request)
+{
+    c->req[2]++;
+    cmd_byte(c, request);
+    c->resp_max += (request & TIMESTAMP) ? 8 : 4;
+}
+
+static void mem_write(uint32_t addr, uint32_t value)
+{
+    struct command *c = xfer_begin();
+    xfer_write(c, AP_TAR, addr);
+    xfer_write(c, AP_DRW_W, value);
+}
+
+/* read, and wait for the answer */
+static void mem_poll(uint32_t addr)
+{
+    struct command *c = xfer_begin();
+    xfer_write(c, AP_TAR, addr);
+    xfer_read(c, AP_DRW_R);
+    c->sync = true;
+}
+
+static void block(uint8_t request, int count, const uint8_t *data)
+{
+    struct command *c = cmd_new(ID_DAP_TRANSFER_BLOCK);
+    cmd_byte(c, 0);
+    cmd_byte(c, count);
+    cmd_byte(c, count >> 8);
+    cmd_byte(c, request);
+    c->resp_max = 4;
+    if (data)
+        for (int i = 0; i < 4 * count; i++)
+            cmd_byte(c, data[i]);
+    else
+        c->resp_max += 4 * count;
+}
+
+/* one page: set tar, then TransferBlocks. tar wraps at 1 kbyte */
+static void page_write(uint32_t addr, const uint8_t *data)
+{
+    struct command *c = xfer_begin();
+    xfer_write(c, AP_TAR, addr);
+    for (int i = 0; i < PAGE_SIZE / 4; i += BLOCK_WORDS)
+    {
+        int n = PAGE_SIZE / 4 - i < BLOCK_WORDS ? PAGE_SIZE / 4 - i : BLOCK_WORDS;
+        block(AP_DRW_W, n, data + 4 * i);
+    }
+}
+
+static void page_read(uint32_t addr)
+{
+    struct command *c = xfer_begin();
+    xfer_write(c, AP_TAR, addr);
+    for (int i = 0; i < PAGE_SIZE / 4; i += BLOCK_WORDS)
+    {
+        int n = PAGE_SIZE / 4 - i < BLOCK_WORDS ? PAGE_SIZE / 4 - i : BLOCK_WORDS;
+        block(AP_DRW_R, n, NULL);
+    }
+}
+
+/* vendor bulk read: index, address, count. a continued read has the count only */
+static void vendor_read(int dev, uint32_t addr, int count)
+{
+    struct command *c = cmd_new(ID_DAP_VENDOR_READ);
+    cmd_byte(c, dev);
+    cmd_word(c, addr);
+    cmd_byte(c, count);
+    cmd_byte(c, count >> 8);
+    c->resp_max = 4 + 4 * count;
+}
+
+static void vendor_read_next(int count)
+{
+    struct command *c = cmd_new(ID_DAP_VENDOR_READ_NEXT);
+    cmd_byte(c, count);
+    cmd_byte(c, count >> 8);
+    c->resp_max = 4 + 4 * count;
+}
+
+static void vendor_write(int dev, uint32_t addr, int count, const uint8_t *data)
+{
+    struct command *c = cmd_new(dev < 0 ? ID_DAP_VENDOR_WRITE_NEXT : ID_DAP_VENDOR_WRITE);
+    if (dev >= 0)
+    {
+        cmd_byte(c, dev);
+        cmd_word(c, addr);
+    }
+    cmd_byte(c, count);
+    cmd_byte(c, count >> 8);
+    for (int i = 0; i < 4 * count; i++)
+        cmd_byte(c, data[i]);
+}
+
+/* vendor tune: ack, idcode, freq, fastest, failed, cached */
+static void vendor_tune(bool retune, uint32_t addr)
+{
+    struct command *c = cmd_new(ID_DAP_VENDOR_TUNE);
+    cmd_byte(c, retune);
+    cmd_word(c, addr);
+}
+
+/* vendor stats: ack, wait, retries, timeouts, fault, parity, no ack, longest retry, budget */
+static void vendor_stats(bool clear, uint32_t budget)
+{
+    struct command *c = cmd_new(ID_DAP_VENDOR_STATS);
+    cmd_byte(c, clear);
+    cmd_word(c, budget);
+}
+
+/* write a core register, through DCRDR and DCRSR */
+static void core_reg_write(struct command *c, int reg, uint32_t value)
+{
+    xfer_write(c, AP_TAR, DCRDR);
+    xfer_write(c, AP_DRW_W, value);
+    xfer_write(c, AP_TAR, DCRSR);
+    xfer_write(c, AP_DRW_W, 0x10000 | reg);
+}
+
+/* call a flash algorithm function: set registers, run, wait for halt, read r0 */
+static void algo_call(uint32_t pc, uint32_t r0, uint32_t r1, uint32_t r2)
+{
+    struct command *c;
+    uint32_t        regs[][2] = {{0, r0}, {1, r1}, {2, r2}, {13, SWD_TARGET_RAM + 0x7000}, {14, SWD_TARGET_RAM + 1}, {15, pc}};
+
+    for (int i = 0; i < 6; i += 2)
+    {
+        c = xfer_begin();
+        core_reg_write(c, regs[i][0], regs[i][1]);
+        core_reg_write(c, regs[i + 1][0], regs[i + 1][1]);
+    }
+    mem_write(DHCSR, 0xa05f0001); /* run */
+    mem_poll(DHCSR);              /* until halted */
+    c = xfer_begin();
+    xfer_write(c, AP_TAR, DCRSR);
+    xfer_write(c, AP_DRW_W, 0); /* r0 */
+    xfer_write(c, AP_TAR, DCRDR);
+    xfer_read(c, AP_DRW_R);
+    c->sync = true;
+}
+
+/* connect, power up, word access with auto-increment */
+static void trace_connect()
+{
+    static const uint8_t ones[7]   = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+    static const uint8_t select[2] = {0x9e, 0xe7};
+    static const uint8_t zero[1]   = {0};
+    struct command      *c;
+
+    info(0xfe);
+    info(0xff);
+    c = cmd_new(ID_DAP_CONNECT);
+    cmd_byte(c, 1);
+    c = cmd_new(ID_DAP_SWJ_CLOCK);
+    cmd_word(c, 4000000);
+    c = cmd_new(ID_DAP_TRANSFER_CONFIGURE);
+    cmd_byte(c, 0);
+    cmd_byte(c, 64); /* wait retries */
+    cmd_byte(c, 0);
+    cmd_byte(c, 8); /* match retries */
+    cmd_byte(c, 0);
+    c = cmd_new(ID_DAP_SWD_CONFIGURE);
+    cmd_byte(c, 0);
+    swj_sequence(51, ones);
+    swj_sequence(16, select);
+    swj_sequence(51, ones);
+    swj_sequence(8, zero);
+    c = xfer_begin();
+    xfer_read(c, DP_IDCODE);
+    c->sync = true;
+    c = xfer_begin();
+    xfer_write(c, DP_ABORT, 0x1e);
+    xfer_write(c, DP_CTRL_W, 0x50000000);
+    xfer_read(c, DP_CTRL_R);
+    c->sync = true;
+    c = xfer_begin();
+    xfer_write(c, DP_SELECT, 0xf0);
+    xfer_read(c, AP_IDR_R);
+    xfer_write(c, DP_SELECT, 0);
+    c->sync = true;
+    c = xfer_begin();
+    xfer_write(c, AP_CSW, 0x23000012); /* word, auto-increment */
+}
+
+/* jtag connect to the chain in jtag_target_config, power up the dp of device dev */
+static void trace_connect_jtag(int dev)
+{
+    static const uint8_t reset[1] = {0x7f}; /* test-logic-reset, then idle */
+    struct command      *c;
+
+    c = cmd_new(ID_DAP_CONNECT);
+    cmd_byte(c, 2);
+    c = cmd_new(ID_DAP_SWJ_CLOCK);
+    cmd_word(c, 4000000);
+    c = cmd_new(ID_DAP_TRANSFER_CONFIGURE);
+    cmd_byte(c, 0);
+    cmd_byte(c, 64);
+    cmd_byte(c, 0);
+    cmd_byte(c, 8);
+    cmd_byte(c, 0);
+    c = cmd_new(ID_DAP_JTAG_CONFIGURE);
+    cmd_byte(c, jtag_target_config.count);
+    for (int i = 0; i < jtag_target_config.count; i++)
+        cmd_byte(c, jtag_target_config.ir_length[i]);
+    swj_sequence(8, reset);
+    c = xfer_begin();
+    c->req[1] = dev;
+    xfer_write(c, DP_ABORT, 0x1e);
+    xfer_write(c, DP_CTRL_W, 0x50000000);
+    xfer_read(c, DP_CTRL_R);
+    xfer_write(c, AP_CSW, 0x23000012);
+}
+
+static void trace_flash(int pages)
+{
+    trace_len = 0;
+    trace_connect();
+
+    /* halt, load the flash algorithm, init */
+    mem_write(DHCSR, 0xa05f0003);
+    mem_poll(DHCSR);
+    page_write(SWD_TARGET_RAM, image);
+    algo_call(SWD_TARGET_RAM + 0x01, FLASH, 0, 1);
+
+    /* program: one page, then call the algorithm. the model has no flash
+       algorithm, so pages are written straight to "flash" */
+    for (int i = 0; i < pages; i++)
+    {
+        page_write(FLASH + PAGE_SIZE * i, image + PAGE_SIZE * i);
+        algo_call(SWD_TARGET_RAM + 0x41, FLASH + PAGE_SIZE * i, PAGE_SIZE, FLASH + PAGE_SIZE * i);
+    }
+
+    /* verify */
+    for (int i = 0; i < pages; i++)
+        page_read(FLASH + PAGE_SIZE * i);
+    trace[trace_len - 1].sync = true;
+}
+
+/* device **********************************************************************/
+
+/* as usb_dap.c: responses to queued packets are held back until a packet that is not queued */
+static void usb_exchange(struct run *run, uint8_t req[][PACKET_SIZE], int *req_len, int count, uint8_t resp[][PACKET_SIZE], int *resp_len)
+{
+    for (int i = 0; i < count; i++)
+    {
+        run->packets++;
+        run->bytes_out += req_len[i];
+    }
+    for (int i = 0; i < count; i++)
+    {
+        resp_len[i] = dap_process_request(req[i], PACKET_SIZE, resp[i], PACKET_SIZE);
+        run->bytes_in += resp_len[i];
+    }
+    run->round_trips++;
+}
+
+/* length of the response to one command */
+static int resp_length(const uint8_t *req, const uint8_t *resp)
+{
+    int reads, len;
+
+    switch (req[0])
+    {
+    case ID_DAP_INFO:
+        return 2 + resp[1];
+    case ID_DAP_TRANSFER:
+        reads = 0;
+        len   = 3;
+        for (int i = 0; i < resp[1]; i++, len++)
+            if (req[len] & 2)
+                reads++;
+            else
+                len += 4;
+        return 3 + 4 * reads;
+    case ID_DAP_TRANSFER_BLOCK:
+        return 4 + ((req[4] & 2) ? 4 * (resp[1] | resp[2] << 8) : 0);
+    case ID_DAP_VENDOR_READ:
+    case ID_DAP_VENDOR_READ_NEXT:
+        return 4 + ((resp[1] == ACK_OK) ? 4 * (resp[2] | resp[3] << 8) : 0);
+    case ID_DAP_VENDOR_WRITE:
+    case ID_DAP_VENDOR_WRITE_NEXT:
+        return 4;
+    default:
+        return 2;
+    }
+}
+
+static void resp_save(struct run *run, const uint8_t *resp, int len)
+{
+    memcpy(run->resp + run->resp_len, resp, len);
+    run->resp_len += len;
+}
+
+static void target_reset()
+{
+    swd_target_reset();
+    jtag_target_reset();
+    for (int i = 0; i < SWD_TARGET_RAM_SIZE; i++)
+        swd_target_ram[i] = i * 7 + (i >> 8);
+    swd_target_edges = 0;
+    memset(&swd_target_stats, 0, sizeof(swd_target_stats));
+    dap_init();
+    dap_swd_set_engine(engine);
+    dap_set_wait_budget(DAP_CONFIG_WAIT_BUDGET_US);
+}
+
+static void run_single(struct run *run)
+{
+    static uint8_t req[1][PACKET_SIZE], resp[1][PACKET_SIZE];
+    int            req_len[1], resp_len[1];
+
+    target_reset();
+    for (int i = 0; i < trace_len; i++)
+    {
+        memcpy(req[0], trace[i].req, trace[i].len);
+        req_len[0] = trace[i].len;
+        usb_exchange(run, req, req_len, 1, resp, resp_len);
+        resp_save(run, resp[0], resp_len[0]);
+    }
+    run->edges = swd_target_edges;
+}
+
+/* fill up to PACKET_COUNT packets with commands, up to the next sync command */
+static void run_batched(struct run *run)
+{
+    static uint8_t req[PACKET_COUNT][PACKET_SIZE], resp[PACKET_COUNT][PACKET_SIZE];
+    int            req_len[PACKET_COUNT], resp_len[PACKET_COUNT];
+    int            first[PACKET_COUNT + 1];
+    int            next = 0;
+
+    target_reset();
+    while (next < trace_len)
+    {
+        int  packets = 0;
+        bool sync    = false;
+
+        do
+        {
+            int len = 2, resp_max = 2;
+
+            first[packets] = next;
+            req[packets][0] = ID_DAP_QUEUE_COMMANDS;
+            req[packets][1] = 0;
+            while (next < trace_len && !sync && len + trace[next].len <= PACKET_SIZE && resp_max + trace[next].resp_max <= PACKET_SIZE)
+            {
+                memcpy(&req[packets][len], trace[next].req, trace[next].len);
+                len += trace[next].len;
+                resp_max += trace[next].resp_max;
+                req[packets][1]++;
+                sync = trace[next].sync;
+                next++;
+            }
+            req_len[packets++] = len;
+        } while (packets < PACKET_COUNT && next < trace_len && !sync);
+        first[packets] = next;
+        req[packets - 1][0] = ID_DAP_EXECUTE_COMMANDS;
+
+        usb_exchange(run, req, req_len, packets, resp, resp_len);
+
+        /* split responses per command */
+        for (int p = 0; p < packets; p++)
+        {
+            int pos = 2;
+
+            if (resp[p][0] != ID_DAP_EXECUTE_COMMANDS || resp[p][1] != req[p][1])
+            {
+                fprintf(stderr, "%s: bad response header %02x %02x\n", run->name, resp[p][0], resp[p][1]);
+                exit(1);
+            }
+            for (int i = first[p]; i < first[p + 1]; i++)
+            {
+                int len = resp_length(trace[i].req, &resp[p][pos]);
+                resp_save(run, &resp[p][pos], len);
+                pos += len;
+            }
+            if (pos != resp_len[p])
+            {
+                fprintf(stderr, "%s: response length %d, expected %d\n", run->name, resp_len[p], pos);
+                exit(1);
+            }
+        }
+    }
+    run->edges = swd_target_edges;
+}
+
+/* one command per packet, up to PACKET_COUNT packets in flight, up to the next sync command */
+static void run_pipelined(struct run *run)
+{
+    static uint8_t req[PACKET_COUNT][PACKET_SIZE], resp[PACKET_COUNT][PACKET_SIZE];
+    int            req_len[PACKET_COUNT], resp_len[PACKET_COUNT];
+    int            next = 0;
+
+    target_reset();
+    while (next < trace_len)
+    {
+        int  packets = 0;
+        bool sync;
+
+        do
+        {
+            memcpy(req[packets], trace[next].req, trace[next].len);
+            req_len[packets++] = trace[next].len;
+            sync               = trace[next++].sync;
+        } while (packets < PACKET_COUNT && next < trace_len && !sync);
+
+        usb_exchange(run, req, req_len, packets, resp, resp_len);
+        for (int p = 0; p < packets; p++)
+            resp_save(run, resp[p], resp_len[p]);
+    }
+    run->edges = swd_target_edges;
+}
+
+/* bench ***********************************************************************/
+
+static void print_run(const struct run *run)
+{
+    printf("%-8s %8u %8u %10u %10u %10u %8u\n", run->name, run->round_trips, run->packets, run->bytes_out, run->bytes_in,
+        run->edges, run->round_trips * USB_RTT_US / 1000);
+}
+
+/* target memory after the trace: the flash algorithm, and the image in flash */
+static bool check_image(const struct run *run, int pages)
+{
+    if (memcmp(&swd_target_ram[0], image, PAGE_SIZE) || memcmp(&swd_target_ram[FLASH - SWD_TARGET_RAM], image, PAGE_SIZE * pages))
+    {
+        fprintf(stderr, "%s: target memory differs from image\n", run->name);
+        return false;
+    }
+    return true;
+}
+
+static int bench(int pages, bool quiet)
+{
+    struct run single = {"single"}, batched = {"batched"};
+    uint32_t   resp_size;
+    uint32_t   checks, errors;
+    int        result = 1;
+
+    image = malloc(PAGE_SIZE * pages);
+    srand(1);
+    for (int i = 0; i < PAGE_SIZE * pages; i++)
+        image[i] = rand();
+
+    trace_flash(pages);
+    resp_size = 0;
+    for (int i = 0; i < trace_len; i++)
+        resp_size += trace[i].resp_max;
+    single.resp  = malloc(resp_size);
+    batched.resp = malloc(resp_size);
+
+    run_single(&single);
+    if (!check_image(&single, pages))
+        goto done;
+    run_batched(&batched);
+    if (!check_image(&batched, pages))
+        goto done;
+
+    if (single.resp_len != batched.resp_len || memcmp(single.resp, batched.resp, single.resp_len))
+    {
+        fprintf(stderr, "responses differ\n");
+        goto done;
+    }
+    result = 0;
+    if (quiet)
+        goto done;
+
+    printf("flash programming trace: %d pages of %d bytes, %d commands\n", pages, PAGE_SIZE, trace_len);
+    printf("mode     round-trips packets  bytes out   bytes in  swclk     usb ms\n");
+    print_run(&single);
+    print_run(&batched);
+    dap_swd_verify_stats(&checks, &errors, false);
+    if (engine == DAP_SWD_ENGINE_VERIFY)
+        printf("verify: %u checks, %u errors\n", checks, errors);
+    if (swd_target_config.wait_every)
+        printf("target: %u ok, %u wait, %u fault\n", swd_target_stats.ok, swd_target_stats.wait, swd_target_stats.fault);
+    printf("round trips saved: %u (%u%%)\n", single.round_trips - batched.round_trips,
+        100 * (single.round_trips - batched.round_trips) / single.round_trips);
+
+done:
+    free(single.resp);
+    free(batched.resp);
+    free(image);
+    return result;
+}
+
+/* host cpu time to read target ram in 1 kbyte pages with TransferBlock, best of
+   BENCH_RUNS. the target model would take most of the time: the first run records
+   what the target drives, and the timed runs play it back without the model */
+#define BENCH_RUNS 5
+
+static int bench_blocks(int kbytes)
+{
+    static const int engines[] = {DAP_SWD_ENGINE_BIT, DAP_SWD_ENGINE_WORD};
+    static uint8_t   resp[PACKET_SIZE];
+    struct timespec  start, end;
+    uint32_t         words = kbytes * PAGE_SIZE / 4;
+    uint8_t         *bits;
+    double           ns, best;
+
+    printf("%d kbyte TransferBlock reads\n", kbytes);
+    printf("engine  ns/word  swclk/word\n");
+    for (int e = 0; e < sizeof(engines) / sizeof(engines[0]); e++)
+    {
+        engine    = engines[e];
+        trace_len = 0;
+        trace_connect();
+        for (int i = 0; i < kbytes; i++)
+            page_read(SWD_TARGET_RAM + PAGE_SIZE * (i % (SWD_TARGET_RAM_SIZE / PAGE_SIZE)));
+
+        bits              = malloc(64 * words + 100000);
+        swd_target_record = bits;
+        target_reset();
+        for (int i = 0; i < trace_len; i++)
+            dap_process_request(trace[i].req, PACKET_SIZE, resp, PACKET_SIZE);
+        swd_target_record = NULL;
+
+        best = 0;
+        for (int run = 0; run < BENCH_RUNS; run++)
+        {
+            target_reset();
+            swd_target_playback = bits;
+            clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+            for (int i = 0; i < trace_len; i++)
+                dap_process_request(trace[i].req, PACKET_SIZE, resp, PACKET_SIZE);
+            clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end);
+            swd_target_playback = NULL;
+            ns = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / words;
+            if (run == 0 || ns < best)
+                best = ns;
+        }
+        free(bits);
+
+        printf("%-6s %8.1f %11.1f\n", engine_name[engine], best, (double)swd_target_edges / words);
+    }
+    return 0;
+}
+
+/* target ram dump: TransferBlock reads in 1 kbyte pages, one command per packet, batched,
+   and pipelined, against vendor bulk reads that go on across the 1 kbyte tar wraps */
+static int bench_dump(int kbytes)
+{
+    struct run runs[] = {{"single"}, {"batched"}, {"pipeline"}, {"vendor"}};
+    uint32_t   addr = SWD_TARGET_RAM, words = kbytes * PAGE_SIZE / 4;
+    uint8_t   *data;
+    int        result = 0;
+
+    if (kbytes < 1 || kbytes * PAGE_SIZE > SWD_TARGET_RAM_SIZE)
+    {
+        fprintf(stderr, "kbytes 1..%d\n", SWD_TARGET_RAM_SIZE / PAGE_SIZE);
+        return 1;
+    }
+    printf("%d kbyte ram dump\n", kbytes);
+    printf("mode     round-trips packets  bytes out   bytes in  swclk     usb ms\n");
+    for (int r = 0; r < 4; r++)
+    {
+        trace_len = 0;
+        trace_connect();
+        trace[trace_len - 1].sync = true;
+        if (r < 3)
+            for (int i = 0; i < kbytes; i++)
+                page_read(addr + PAGE_SIZE * i);
+        else
+        {
+            vendor_read(0, addr, words < VENDOR_READ_WORDS ? words : VENDOR_READ_WORDS);
+            for (int i = VENDOR_READ_WORDS; i < words; i += VENDOR_READ_WORDS)
+                vendor_read_next(words - i < VENDOR_READ_WORDS ? words - i : VENDOR_READ_WORDS);
+        }
+        runs[r].resp = malloc(trace_len * (PACKET_SIZE + 4));
+        if (r == 0)
+            run_single(&runs[r]);
+        else if (r == 1)
+            run_batched(&runs[r]);
+        else
+            run_pipelined(&runs[r]);
+        print_run(&runs[r]);
+    }
+
+    for (int r = 1; r < 3; r++)
+        if (runs[r].resp_len != runs[0].resp_len || memcmp(runs[r].resp, runs[0].resp, runs[0].resp_len))
+        {
+            fprintf(stderr, "%s: responses differ\n", runs[r].name);
+            result = 1;
+        }
+
+    /* the data of the vendor reads, after the responses to the connect trace */
+    data = malloc(4 * words);
+    for (uint32_t i = 0, pos = 0, n = 0; i < trace_len; i++)
+    {
+        uint8_t *resp = &runs[3].resp[pos];
+        int      len  = resp_length(trace[i].req, resp);
+
+        if (trace[i].req[0] == ID_DAP_VENDOR_READ || trace[i].req[0] == ID_DAP_VENDOR_READ_NEXT)
+        {
+            memcpy(&data[4 * n], &resp[4], len - 4);
+            n += (len - 4) / 4;
+            if (resp[1] != ACK_OK)
+                result = 1;
+        }
+        pos += len;
+    }
+    if (result || memcmp(data, swd_target_ram, 4 * words))
+    {
+        fprintf(stderr, "vendor: dump differs from target ram\n");
+        result = 1;
+    }
+    printf("vendor against batched: %+d round trips, %+d packets\n", (int)(runs[3].round_trips - runs[1].round_trips),
+        (int)(runs[3].packets - runs[1].packets));
+    free(data);
+
+    for (int r = 0; r < 4; r++)
+        free(runs[r].resp);
+    return result;
+}
+
+/* replay **********************************************************************/
+
+/*
+   trace file: one request per line, in hex. a line starting with '=' is the
+   expected response to the request before it; xx matches any byte, and the
+   response may be longer than expected. '#' starts a comment.
+   05 00 01 02
+   = 05 01 01 77 14 a0 2b
+ */
+
+/* hex bytes to buf, returns count or -1. xx is a wildcard, marked in mask */
+static int parse_hex(char *s, uint8_t *buf, bool *mask, int size)
+{
+    int n = 0;
+
+    while (1)
+    {
+        while (isspace((unsigned char)*s))
+            s++;
+        if (*s == 0)
+            return n;
+        if (n == size || !isxdigit((unsigned char)s[0]) && s[0] != 'x' || !isxdigit((unsigned char)s[1]) && s[1] != 'x')
+            return -1;
+        if (mask)
+            mask[n] = s[0] == 'x';
+        buf[n++] = s[0] == 'x' ? 0 : strtoul((char[]){s[0], s[1], 0}, NULL, 16);
+        s += 2;
+    }
+}
+
+static void print_hex(const uint8_t *buf, int len)
+{
+    for (int i = 0; i < len && i < 16; i++)
+        printf(" %02x", buf[i]);
+    if (len > 16)
+        printf(" ... (%d)", len);
+    printf("\n");
+}
+
+static int replay(const char *name)
+{
+    static uint8_t req[PACKET_SIZE], resp[PACKET_SIZE], expect[PACKET_SIZE];
+    static bool    wildcard[PACKET_SIZE];
+    char           line[4 * PACKET_SIZE];
+    FILE          *f;
+    int            line_nr = 0, commands = 0, mismatches = 0, resp_len = 0;
+    uint32_t       edges, transfers, total;
+
+    if ((f = fopen(name, "r")) == NULL)
+    {
+        perror(name);
+        return 1;
+    }
+    target_reset();
+    printf("  #  edges xfers response\n");
+    while (fgets(line, sizeof(line), f))
+    {
+        char *s = line;
+        int   len;
+
+        line_nr++;
+        if (strchr(s, '#'))
+            *strchr(s, '#') = 0;
+        while (isspace((unsigned char)*s))
+            s++;
+        if (*s == 0)
+            continue;
+
+        if (*s == '=')
+        {
+            if ((len = parse_hex(s + 1, expect, wildcard, PACKET_SIZE)) < 0 || commands == 0)
+            {
+                fprintf(stderr, "%s:%d: bad response\n", name, line_nr);
+                return 1;
+            }
+            for (int i = 0; i < len; i++)
+                if (i >= resp_len || !wildcard[i] && resp[i] != expect[i])
+                {
+                    printf("%s:%d: expected", name, line_nr);
+                    print_hex(expect, len);
+                    mismatches++;
+                    break;
+                }
+            continue;
+        }
+
+        if ((len = parse_hex(s, req, NULL, PACKET_SIZE)) <= 0)
+        {
+            fprintf(stderr, "%s:%d: bad request\n", name, line_nr);
+            return 1;
+        }
+        edges     = swd_target_edges;
+        transfers = swd_target_stats.ok + swd_target_stats.wait + swd_target_stats.fault;
+        memset(req + len, 0, PACKET_SIZE - len);
+        resp_len = dap_process_request(req, PACKET_SIZE, resp, PACKET_SIZE);
+        commands++;
+        printf("%3d %6u %5u", commands, swd_target_edges - edges,
+            swd_target_stats.ok + swd_target_stats.wait + swd_target_stats.fault - transfers);
+        print_hex(resp, resp_len);
+    }
+    fclose(f);
+
+    total = swd_target_stats.ok + swd_target_stats.wait + swd_target_stats.fault;
+    printf("%d commands, %u swclk edges, %u transfers (%u ok, %u wait, %u fault)", commands, swd_target_edges, total,
+        swd_target_stats.ok, swd_target_stats.wait, swd_target_stats.fault);
+    if (total)
+        printf(", %.1f edges per transfer", (double)swd_target_stats.transfer_edges / total);
+    printf("\n");
+    if (swd_target_stats.protocol_errors)
+        printf("%u protocol errors, %u line resets\n", swd_target_stats.protocol_errors, swd_target_stats.line_resets);
+    if (mismatches)
+        printf("%d responses differ\n", mismatches);
+    return mismatches != 0;
+}
+
+/* check ***********************************************************************/
+
+static const char *check_name;
+static int         check_failed;
+
+static void expect(bool ok, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (ok)
+        return;
+    check_failed++;
+    printf("%s %s: ", engine_name[engine], check_name);
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    printf("\n");
+}
+
+/* run the commands built since the last call, one per packet. resp is the response to the last */
+static uint8_t resp[PACKET_SIZE];
+
+static void check_run()
+{
+    for (int i = 0; i < trace_len; i++)
+    {
+        memset(resp, 0, sizeof(resp));
+        dap_process_request(trace[i].req, PACKET_SIZE, resp, PACKET_SIZE);
+    }
+    trace_len = 0;
+}
+
+static uint32_t resp_word(int pos)
+{
+    return resp[pos] | resp[pos + 1] << 8 | resp[pos + 2] << 16 | (uint32_t)resp[pos + 3] << 24;
+}
+
+static uint32_t ram_word(uint32_t addr)
+{
+    uint8_t *p = &swd_target_ram[addr - SWD_TARGET_RAM];
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/* Transfer response: count, ack */
+static void expect_ack(int count, int ack)
+{
+    expect(resp[1] == count && resp[2] == ack, "count %d ack %#x, expected count %d ack %#x", resp[1], resp[2], count, ack);
+}
+
+static void check_start(const char *name)
+{
+    check_name = name;
+    target_reset();
+    memset(&swd_target_config, 0, sizeof(swd_target_config));
+    trace_len = 0;
+    trace_connect();
+    check_run();
+    /* counts of the check only, not of the connect */
+    memset(&swd_target_stats, 0, sizeof(swd_target_stats));
+}
+
+/* one transfer: 8 bit header, turnaround, 3 bit ack, 32 bit data, parity, turnaround */
+static void check_timing()
+{
+    struct command *c;
+
+    check_start("timing");
+    c = xfer_begin();
+    xfer_read(c, DP_IDCODE);
+    check_run();
+    expect_ack(1, ACK_OK);
+    expect(resp_word(3) == SWD_TARGET_IDCODE, "idcode %08x", resp_word(3));
+    expect(swd_target_stats.protocol_errors == 0, "%u protocol errors", swd_target_stats.protocol_errors);
+    expect(swd_target_stats.transfer_edges == 46 * (swd_target_stats.ok + swd_target_stats.wait + swd_target_stats.fault),
+        "%u edges for %u transfers", swd_target_stats.transfer_edges, swd_target_stats.ok);
+}
+
+/* ap reads are posted: the data of a read arrives with the next ap read, or with RDBUFF */
+static void check_posted()
+{
+    struct command *c;
+    uint32_t        addr = SWD_TARGET_RAM + 0x100;
+
+    check_start("posted read");
+    c = xfer_begin();
+    xfer_write(c, AP_TAR, addr);
+    xfer_read(c, AP_DRW_R);
+    xfer_read(c, AP_DRW_R);
+    xfer_read(c, DP_CTRL_R);
+    xfer_read(c, AP_DRW_R);
+    check_run();
+    expect_ack(5, ACK_OK);
+    expect(resp_word(3) == ram_word(addr), "word 0 %08x", resp_word(3));
+    expect(resp_word(7) == ram_word(addr + 4), "word 1 %08x", resp_word(7));
+    expect((resp_word(11) & 0xf0000000) == 0xf0000000, "ctrl/stat %08x", resp_word(11));
+    expect(resp_word(15) == ram_word(addr + 8), "word 2 %08x", resp_word(15));
+}
+
+/* a timestamp, in swclk edges here, comes before the data of its transfer. posted reads
+   have the timestamp of the read, and the data with the next transfer */
+static void check_timestamp()
+{
+    struct command *c;
+    uint32_t        addr = SWD_TARGET_RAM + 0x100;
+    uint32_t        t[4];
+
+    check_start("timestamp");
+    info(0xf1);
+    check_run();
+    expect(resp[1] == 4 && resp_word(2) != 0, "timestamp clock: size %d", resp[1]);
+
+    c = xfer_begin();
+    xfer_write(c, AP_TAR | TIMESTAMP, addr);
+    xfer_read(c, AP_DRW_R | TIMESTAMP);
+    xfer_read(c, AP_DRW_R | TIMESTAMP);
+    xfer_read(c, DP_CTRL_R | TIMESTAMP);
+    xfer_read(c, AP_DRW_R);
+    check_run();
+    expect_ack(5, ACK_OK);
+    t[0] = resp_word(3);
+    t[1] = resp_word(7);
+    t[2] = resp_word(15);
+    t[3] = resp_word(23);
+    for (int i = 1; i < 4; i++)
+        expect(t[i] - t[i - 1] >= 46 && t[i] - t[i - 1] < 200, "timestamps %u %u", t[i - 1], t[i]);
+    expect(resp_word(11) == ram_word(addr), "word 0 %08x", resp_word(11));
+    expect(resp_word(19) == ram_word(addr + 4), "word 1 %08x", resp_word(19));
+    expect((resp_word(27) & 0xf0000000) == 0xf0000000, "ctrl/stat %08x", resp_word(27));
+    expect(resp_word(31) == ram_word(addr + 8), "word 2 %08x", resp_word(31));
+}
+
+static uint32_t crc32(uint32_t crc, const uint8_t *buf, uint32_t size)
+{
+    crc = ~crc;
+    for (uint32_t i = 0; i < size; i++)
+    {
+        crc ^= buf[i];
+        for (int j = 0; j < 8; j++)
+            crc = (crc >> 1) ^ (crc & 1 ? 0xedb88320 : 0);
+    }
+    return ~crc;
+}
+
+static void vendor_crc(int dev, uint32_t addr, uint32_t size)
+{
+    struct command *c = cmd_new(ID_DAP_VENDOR_CRC32);
+    cmd_byte(c, dev);
+    cmd_word(c, addr);
+    cmd_word(c, size);
+}
+
+/* vendor crc32 across 1 kbyte tar wraps, with csw and tar left as they were */
+static void check_vendor_crc(int dev)
+{
+    uint32_t        addr = SWD_TARGET_RAM + 0x13f0, size = 0x900;
+    struct command *c;
+
+    for (int i = 0; i < 0x1000; i++)
+        swd_target_ram[0x1000 + i] = i * 7 + (i >> 8);
+    c         = xfer_begin();
+    c->req[1] = dev;
+    xfer_write(c, AP_CSW, 0x23000040);
+    xfer_write(c, AP_TAR, SWD_TARGET_RAM + 0x20);
+    vendor_crc(dev, addr, size);
+    c         = xfer_begin();
+    c->req[1] = dev;
+    xfer_read(c, AP_CSW_R);
+    xfer_read(c, AP_TAR_R);
+    xfer_write(c, AP_CSW, 0x23000012);
+    check_run();
+    expect_ack(3, ACK_OK);
+    expect(resp_word(3) == 0x23000040 && resp_word(7) == SWD_TARGET_RAM + 0x20, "csw %08x tar %08x not restored",
+        resp_word(3), resp_word(7));
+
+    vendor_crc(dev, addr, size);
+    check_run();
+    expect(resp[1] == ACK_OK && resp_word(2) == crc32(0, &swd_target_ram[addr - SWD_TARGET_RAM], size),
+        "crc32: ack %#x crc %08x", resp[1], resp_word(2));
+}
+
+/* DAP_ExecuteCommands: compare count 1 kbyte sectors at addr, then DAP_Info packet count */
+static void vendor_compare_execute(uint32_t addr, int count)
+{
+    struct command *c = cmd_new(ID_DAP_EXECUTE_COMMANDS);
+
+    cmd_byte(c, 2);
+    cmd_byte(c, ID_DAP_VENDOR_COMPARE);
+    cmd_byte(c, 0);
+    cmd_word(c, addr);
+    cmd_word(c, 0x400);
+    cmd_byte(c, count);
+    for (int i = 0; i < count; i++)
+        cmd_word(c, 0);
+    cmd_byte(c, ID_DAP_INFO);
+    cmd_byte(c, 0xfe);
+    check_run();
+}
+
+static void check_vendor()
+{
+    uint32_t        addr = SWD_TARGET_RAM + 0x1000;
+    struct command *c;
+
+    check_start("vendor");
+    check_vendor_crc(0);
+
+    c = cmd_new(ID_DAP_VENDOR_COMPARE);
+    cmd_byte(c, 0);
+    cmd_word(c, addr);
+    cmd_word(c, 0x400);
+    cmd_byte(c, 4);
+    for (int i = 0; i < 4; i++)
+        cmd_word(c, crc32(0, &swd_target_ram[addr - SWD_TARGET_RAM + 0x400 * i], 0x400) ^ (i == 2));
+    check_run();
+    expect(resp[1] == ACK_OK && resp[2] == 4 && resp[3] == 1 && resp[4] == 2 && resp[5] == 0x04,
+        "compare: ack %#x checked %d differ %d first %d bitmap %02x", resp[1], resp[2], resp[3], resp[4], resp[5]);
+
+    vendor_crc(0, addr + 2, 0x100);
+    check_run();
+    expect(resp[1] == 0xff, "unaligned: ack %#x", resp[1]);
+
+    /* the crcs of a compare that stops early are skipped; the next command follows them */
+    vendor_compare_execute(addr + 2, 3);
+    expect(resp[3] == 0xff && resp[4] == 0 && resp[5] == 0 && resp[6] == 0xff && resp[7] == 0,
+        "unaligned compare: ack %#x checked %d differ %d first %d bitmap %02x", resp[3], resp[4], resp[5], resp[6], resp[7]);
+    expect(resp[1] == 2 && resp[8] == ID_DAP_INFO && resp[9] == 1, "after unaligned compare: %02x %02x %02x", resp[1],
+        resp[8], resp[9]);
+    vendor_compare_execute(SWD_TARGET_RAM + SWD_TARGET_RAM_SIZE - 0x400, 3);
+    expect(resp[3] != ACK_OK && resp[4] == 1, "compare past ram: ack %#x checked %d", resp[3], resp[4]);
+    expect(resp[1] == 2 && resp[8] == ID_DAP_INFO && resp[9] == 1, "after compare past ram: %02x %02x %02x", resp[1],
+        resp[8], resp[9]);
+}
+
+/* DAP_ExecuteCommands: vendor read of count words at addr, then DAP_Info packet count */
+static void vendor_read_execute(uint32_t addr, int count)
+{
+    struct command *c = cmd_new(ID_DAP_EXECUTE_COMMANDS);
+
+    cmd_byte(c, 2);
+    cmd_byte(c, ID_DAP_VENDOR_READ);
+    cmd_byte(c, 0);
+    cmd_word(c, addr);
+    cmd_byte(c, count);
+    cmd_byte(c, count >> 8);
+    cmd_byte(c, ID_DAP_INFO);
+    cmd_byte(c, 0xfe);
+    check_run();
+}
+
+/* vendor bulk read and write across 1 kbyte tar wraps, continued, with csw and tar
+   restored by the next command that is not a vendor command */
+static void check_vendor_bulk()
+{
+    uint32_t        addr = SWD_TARGET_RAM + 0x3f0;
+    uint8_t         data[4 * 200];
+    struct command *c;
+
+    check_start("vendor bulk");
+    c = xfer_begin();
+    xfer_write(c, AP_CSW, 0x23000040);
+    xfer_write(c, AP_TAR, SWD_TARGET_RAM + 0x20);
+    vendor_read(0, addr, 300);
+    check_run();
+    expect(resp[1] == ACK_OK && (resp[2] | resp[3] << 8) == VENDOR_READ_WORDS, "read: ack %#x count %d", resp[1],
+        resp[2] | resp[3] << 8);
+    expect(!memcmp(&resp[4], &swd_target_ram[addr - SWD_TARGET_RAM], 4 * VENDOR_READ_WORDS), "read: data differs");
+
+    vendor_read_next(VENDOR_READ_WORDS);
+    check_run();
+    expect(resp[1] == ACK_OK && !memcmp(&resp[4], &swd_target_ram[addr - SWD_TARGET_RAM + 4 * VENDOR_READ_WORDS],
+        4 * VENDOR_READ_WORDS), "read next: ack %#x, data differs", resp[1]);
+
+    for (int i = 0; i < sizeof(data); i++)
+        data[i] = ~i;
+    addr = SWD_TARGET_RAM + 0x7f8;
+    vendor_write(0, addr, 100, data);
+    vendor_write(-1, 0, 100, data + 400);
+    check_run();
+    expect(resp[1] == ACK_OK && resp[2] == 100, "write next: ack %#x count %d", resp[1], resp[2]);
+    expect(!memcmp(&swd_target_ram[addr - SWD_TARGET_RAM], data, sizeof(data)), "write: ram differs");
+
+    c = xfer_begin();
+    xfer_read(c, AP_CSW_R);
+    xfer_read(c, AP_TAR_R);
+    check_run();
+    expect_ack(2, ACK_OK);
+    expect(resp_word(3) == 0x23000040 && resp_word(7) == SWD_TARGET_RAM + 0x20, "csw %08x tar %08x not restored",
+        resp_word(3), resp_word(7));
+
+    vendor_read(0, addr + 2, 4);
+    vendor_read_next(4);
+    check_run();
+    expect(resp[1] == 0xff, "read next after an unaligned read: ack %#x", resp[1]);
+
+    /* a read that fails has no words; the next command follows the count */
+    vendor_read_execute(SWD_TARGET_RAM + SWD_TARGET_RAM_SIZE - 8, 4);
+    expect(resp[3] != ACK_OK && resp[4] == 0 && resp[5] == 0, "read past ram: ack %#x count %d", resp[3],
+        resp[4] | resp[5] << 8);
+    expect(resp[1] == 2 && resp[6] == ID_DAP_INFO && resp[7] == 1, "after read past ram: %02x %02x %02x", resp[1],
+        resp[6], resp[7]);
+    expect(swd_target_stats.protocol_errors == 0, "%u protocol errors", swd_target_stats.protocol_errors);
+}
+
+/* another debugger takes the pins between two requests: dap_suspend() and dap_resume()
+   keep the SELECT, CSW and TAR the host has cached, also with a vendor read open */
+static void check_handover()
+{
+    uint32_t        addr = SWD_TARGET_RAM + 0x40;
+    uint32_t        value;
+    struct command *c;
+
+    check_start("handover");
+    c = xfer_begin();
+    xfer_write(c, AP_CSW, 0x23000012);
+    xfer_write(c, AP_TAR, addr);
+    xfer_read(c, AP_DRW_R);
+    vendor_read(0, SWD_TARGET_RAM + 0x400, 4);
+    check_run();
+    expect(dap_suspend() == ACK_OK, "suspend failed");
+
+    /* the other debugger, straight to the model */
+    value = 0;
+    swd_target_access(DP_SELECT, &value);
+    value = 0x23000000;
+    swd_target_access(AP_CSW, &value);
+    value = SWD_TARGET_RAM + 0x800;
+    swd_target_access(AP_TAR, &value);
+    value = 0xf0;
+    swd_target_access(DP_SELECT, &value);
+
+    expect(dap_resume() == ACK_OK, "resume failed");
+    c = xfer_begin();
+    xfer_read(c, AP_DRW_R);
+    xfer_read(c, AP_CSW_R);
+    check_run();
+    expect_ack(2, ACK_OK);
+    expect(resp_word(3) == ram_word(addr + 4), "data %08x, expected %08x", resp_word(3), ram_word(addr + 4));
+    expect(resp_word(7) == 0x23000012, "csw %08x", resp_word(7));
+    vendor_read_next(4);
+    check_run();
+    expect(resp[1] == ACK_OK && !memcmp(&resp[4], &swd_target_ram[0x410], 16), "read next: ack %#x, data differs",
+        resp[1]);
+
+    /* the other debugger identifies the target with a probe, see attach_cache.c */
+    expect(dap_suspend() == ACK_OK, "suspend failed");
+    expect(dap_probe_begin(&value) == ACK_OK && value == SWD_TARGET_IDCODE, "probe: idcode %08x", value);
+    value = 0xf0;
+    expect(dap_probe_transfer(DP_SELECT, &value) == ACK_OK && dap_probe_transfer(AP_IDR_R, &value) == ACK_OK &&
+        value == SWD_TARGET_AP_IDR, "probe: ap idr %08x", value);
+    dap_probe_end();
+
+    expect(dap_resume() == ACK_OK, "resume after probe failed");
+    c = xfer_begin();
+    xfer_read(c, AP_CSW_R);
+    xfer_read(c, AP_TAR_R);
+    check_run();
+    expect_ack(2, ACK_OK);
+    expect(resp_word(3) == 0x23000012, "after requests: csw %08x", resp_word(3));
+    expect(swd_target_stats.protocol_errors == 0, "%u protocol errors", swd_target_stats.protocol_errors);
+}
+
+/* the auto-tune cache, in place of the eeprom */
+static struct
+{
+    uint32_t idcode, freq;
+} tune_cache[4];
+static int tune_cached;
+
+uint32_t tune_lookup(uint32_t idcode)
+{
+    for (int i = 0; i < tune_cached; i++)
+        if (tune_cache[i].idcode == idcode)
+            return tune_cache[i].freq;
+    return 0;
+}
+
+void tune_store(uint32_t idcode, uint32_t freq)
+{
+    int i;
+
+    for (i = 0; i < tune_cached && tune_cache[i].idcode != idcode; i++)
+        ;
+    if (i == tune_cached && tune_cached < 4)
+        tune_cached++;
+    tune_cache[i < 4 ? i : 3].idcode = idcode;
+    tune_cache[i < 4 ? i : 3].freq   = freq;
+}
+
+/* swclk auto-tune against a target that fails above max_freq: the clock steps up to the
+   first failure, and is set with a margin below the fastest step that passed. The result
+   is cached per idcode */
+static void check_tune()
+{
+    struct dap_tune tune;
+    struct command *c;
+    uint32_t        idcode;
+    int             clock;
+
+    check_start("tune");
+    tune_cached                = 0;
+    swd_target_config.max_freq = 500000;
+    vendor_tune(true, SWD_TARGET_RAM + 0x40);
+    check_run();
+    expect(resp[1] == ACK_OK && resp_word(2) == SWD_TARGET_IDCODE && resp_word(6) == 375000 && resp_word(10) == 500000 &&
+        resp_word(14) == 1000000 && resp[18] == 0, "ack %#x idcode %08x freq %u fastest %u failed %u cached %d", resp[1],
+        resp_word(2), resp_word(6), resp_word(10), resp_word(14), resp[18]);
+    expect(dap_clock_get() == 375000, "clock %d", dap_clock_get());
+
+    c = xfer_begin();
+    xfer_write(c, AP_TAR, SWD_TARGET_RAM + 0x40);
+    xfer_read(c, AP_DRW_R);
+    check_run();
+    expect_ack(2, ACK_OK);
+    expect(resp_word(3) == ram_word(SWD_TARGET_RAM + 0x40), "after tune: data %08x", resp_word(3));
+
+    /* the cached frequency, no steps */
+    vendor_tune(false, 0);
+    check_run();
+    expect(resp[1] == ACK_OK && resp_word(6) == 375000 && resp[18] == 1, "cached: ack %#x freq %u cached %d", resp[1],
+        resp_word(6), resp[18]);
+
+    /* no failure: the fastest step, without margin */
+    swd_target_config.max_freq = 0;
+    vendor_tune(true, SWD_TARGET_RAM + 0x40);
+    check_run();
+    expect(resp[1] == ACK_OK && resp_word(6) == 1000000 && resp_word(14) == 0, "no limit: ack %#x freq %u failed %u",
+        resp[1], resp_word(6), resp_word(14));
+    expect(tune_lookup(SWD_TARGET_IDCODE) == 1000000, "cache %u", tune_lookup(SWD_TARGET_IDCODE));
+
+    vendor_tune(true, SWD_TARGET_RAM + 2);
+    check_run();
+    expect(resp[1] == 0xff, "unaligned: ack %#x", resp[1]);
+
+    /* from the shell, see swd_tune.c: the host keeps its SELECT, CSW, TAR and clock */
+    swd_target_config.max_freq = 500000;
+    c = cmd_new(ID_DAP_SWJ_CLOCK);
+    cmd_word(c, 200000);
+    c = xfer_begin();
+    xfer_write(c, AP_TAR, SWD_TARGET_RAM + 0x80);
+    check_run();
+    clock = dap_clock_get();
+    expect(dap_probe_begin(&idcode) == ACK_OK && idcode == SWD_TARGET_IDCODE, "probe: idcode %08x", idcode);
+    expect(dap_clock_tune(SWD_TARGET_RAM + 0x40, true, &tune) == ACK_OK && tune.freq == 375000, "probe: freq %d",
+        tune.freq);
+    dap_probe_end();
+    expect(dap_clock_get() == clock, "after probe: clock %d, expected %d", dap_clock_get(), clock);
+    c = xfer_begin();
+    xfer_read(c, AP_DRW_R);
+    check_run();
+    expect_ack(1, ACK_OK);
+    expect(resp_word(3) == ram_word(SWD_TARGET_RAM + 0x80), "after probe: data %08x", resp_word(3));
+    expect(swd_target_stats.protocol_errors == 0, "%u protocol errors", swd_target_stats.protocol_errors);
+}
+
+static void check_block()
+{
+    uint8_t  data[4 * BLOCK_WORDS];
+    uint32_t addr = SWD_TARGET_RAM + 0x400;
+    struct command *c;
+
+    check_start("TransferBlock");
+    for (int i = 0; i < sizeof(data); i++)
+        data[i] = i ^ 0x5a;
+    c = xfer_begin();
+    xfer_write(c, AP_TAR, addr);
+    block(AP_DRW_W, BLOCK_WORDS, data);
+    check_run();
+    expect(resp[0] == ID_DAP_TRANSFER_BLOCK && (resp[1] | resp[2] << 8) == BLOCK_WORDS && resp[3] == ACK_OK,
+        "write: count %d ack %#x", resp[1] | resp[2] << 8, resp[3]);
+    expect(!memcmp(&swd_target_ram[addr - SWD_TARGET_RAM], data, sizeof(data)), "write: memory differs");
+
+    c = xfer_begin();
+    xfer_write(c, AP_TAR, addr);
+    block(AP_DRW_R, BLOCK_WORDS, NULL);
+    check_run();
+    expect((resp[1] | resp[2] << 8) == BLOCK_WORDS && resp[3] == ACK_OK, "read: count %d ack %#x", resp[1] | resp[2] << 8, resp[3]);
+    expect(!memcmp(&resp[4], data, sizeof(data)), "read: data differs");
+
+    /* dp registers are not posted */
+    block(DP_IDCODE, 4, NULL);
+    check_run();
+    expect((resp[1] | resp[2] << 8) == 4 && resp[3] == ACK_OK && resp_word(4) == SWD_TARGET_IDCODE && resp_word(16) == SWD_TARGET_IDCODE,
+        "dp read: count %d ack %#x", resp[1] | resp[2] << 8, resp[3]);
+
+    /* WAIT in the middle of a block is retried */
+    swd_target_config.wait_every = 5;
+    swd_target_config.wait_count = 2;
+    c = xfer_begin();
+    xfer_write(c, AP_TAR, addr);
+    block(AP_DRW_R, BLOCK_WORDS, NULL);
+    check_run();
+    expect((resp[1] | resp[2] << 8) == BLOCK_WORDS && resp[3] == ACK_OK, "read with WAIT: count %d ack %#x", resp[1] | resp[2] << 8, resp[3]);
+    expect(!memcmp(&resp[4], data, sizeof(data)), "read with WAIT: data differs");
+
+    /* until the retry count and the time budget are exceeded: the words before are returned */
+    swd_target_config.wait_every = 50;
+    swd_target_config.wait_count = 100;
+    vendor_stats(false, 1);
+    c = xfer_begin();
+    xfer_write(c, AP_TAR, addr);
+    block(AP_DRW_R, BLOCK_WORDS, NULL);
+    check_run();
+    expect((resp[1] | resp[2] << 8) < BLOCK_WORDS && resp[3] == ACK_WAIT, "read, WAIT: count %d ack %#x", resp[1] | resp[2] << 8, resp[3]);
+    expect(!memcmp(&resp[4], data, 4 * (resp[1] | resp[2] << 8)), "read, WAIT: data differs");
+}
+
+/* read until (data & mask) == value, at most match retries times */
+static void check_match()
+{
+    uint32_t        addr = SWD_TARGET_RAM + 0x200;
+    uint32_t        ok;
+    struct command *c;
+
+    check_start("match value");
+    c = xfer_begin();
+    xfer_write(c, MATCH_MASK, 0xffff0000);
+    xfer_write(c, AP_TAR, addr);
+    xfer_write(c, AP_DRW_R | MATCH_VALUE, ram_word(addr) & 0xffff0000);
+    check_run();
+    expect_ack(3, ACK_OK);
+
+    ok = swd_target_stats.ok;
+    c  = xfer_begin();
+    xfer_write(c, AP_TAR, addr);
+    xfer_write(c, AP_DRW_R | MATCH_VALUE, ~ram_word(addr) & 0xffff0000);
+    check_run();
+    expect_ack(1, ACK_OK | ACK_MISMATCH);
+    /* tar, posted read, 8 retries */
+    expect(swd_target_stats.ok - ok == 10, "%u transfers", swd_target_stats.ok - ok);
+}
+
+/* WAIT is retried up to the retry count, then returned. DAPABORT cancels the access */
+static void check_wait()
+{
+    uint32_t        addr = SWD_TARGET_RAM + 0x300;
+    struct command *c;
+
+    check_start("WAIT");
+    swd_target_config.wait_every = 1;
+    swd_target_config.wait_count = 3;
+    c = xfer_begin();
+    xfer_write(c, AP_TAR, addr);
+    xfer_read(c, AP_DRW_R);
+    check_run();
+    expect_ack(2, ACK_OK);
+    expect(resp_word(3) == ram_word(addr), "data %08x", resp_word(3));
+    expect(swd_target_stats.wait == 6, "%u waits", swd_target_stats.wait);
+
+    /* with a short time budget, the retry count of 64 applies */
+    vendor_stats(true, 1);
+    swd_target_config.wait_count = 100;
+    c = xfer_begin();
+    xfer_write(c, AP_TAR, addr);
+    check_run();
+    expect_ack(0, ACK_WAIT);
+
+    swd_target_config.wait_every = 0;
+    c = xfer_begin();
+    xfer_write(c, DP_ABORT, 0x01);
+    xfer_write(c, AP_TAR, addr);
+    xfer_read(c, AP_DRW_R);
+    check_run();
+    expect_ack(3, ACK_OK);
+    expect(resp_word(3) == ram_word(addr), "after abort: data %08x", resp_word(3));
+    vendor_stats(false, 0);
+    check_run();
+    expect(resp[1] == ACK_OK && resp_word(2) == 64 && resp_word(6) == 63 && resp_word(10) == 1 && resp_word(30) == 1,
+        "stats: wait %u retries %u timeouts %u budget %u", resp_word(2), resp_word(6), resp_word(10), resp_word(30));
+}
+
+/* WAIT backoff: idle cycles between retries grow, and the time budget outlasts the retry
+   count. 1 us of budget is 100 swclk edges here */
+static void check_wait_backoff()
+{
+    uint32_t        addr = SWD_TARGET_RAM + 0x300;
+    uint32_t        edges;
+    struct command *c;
+
+    check_start("WAIT backoff");
+    swd_target_config.wait_every = 1;
+    swd_target_config.wait_count = 1000;
+    edges                        = swd_target_edges;
+    c                            = xfer_begin();
+    xfer_write(c, AP_TAR, addr);
+    check_run();
+    expect_ack(1, ACK_OK);
+    edges = swd_target_edges - edges;
+    expect(edges > swd_target_stats.transfer_edges + 900 * 1024, "%u edges, %u in transfers", edges,
+        swd_target_stats.transfer_edges);
+    vendor_stats(true, 0);
+    check_run();
+    expect(resp_word(2) == 1000 && resp_word(6) == 1000 && resp_word(10) == 0 && resp_word(26) >= edges / 100 - 10,
+        "stats: wait %u retries %u timeouts %u longest %u us", resp_word(2), resp_word(6), resp_word(10), resp_word(26));
+
+    /* a target that stays busy: WAIT after the budget */
+    swd_target_config.wait_count = 100000;
+    vendor_stats(true, 2000);
+    c = xfer_begin();
+    xfer_write(c, AP_TAR, addr);
+    check_run();
+    expect_ack(0, ACK_WAIT);
+    vendor_stats(true, 0);
+    check_run();
+    expect(resp_word(10) == 1 && resp_word(26) >= 2000 && resp_word(26) < 2200 && resp_word(30) == 2000,
+        "stats: timeouts %u longest %u us budget %u", resp_word(10), resp_word(26), resp_word(30));
+
+    /* the budget stays below the cycle counter wrap, 42.9 s at 100 MHz */
+    vendor_stats(true, 0xffffffff);
+    check_run();
+    expect(resp_word(30) == 0xffffffff / 100 / 2, "budget %u", resp_word(30));
+}
+
+/* a bus error makes STICKYERR set, ap accesses FAULT until cleared in ABORT */
+static void check_fault()
+{
+    struct command *c;
+
+    check_start("FAULT");
+    c = xfer_begin();
+    xfer_write(c, AP_TAR, 0x40000000);
+    xfer_read(c, AP_DRW_R);
+    check_run();
+    c = xfer_begin();
+    xfer_read(c, AP_DRW_R);
+    check_run();
+    expect_ack(0, ACK_FAULT);
+
+    c = xfer_begin();
+    xfer_read(c, DP_CTRL_R);
+    check_run();
+    expect_ack(1, ACK_OK);
+    expect(resp_word(3) & 0x20, "STICKYERR not set: ctrl/stat %08x", resp_word(3));
+
+    c = xfer_begin();
+    xfer_write(c, DP_ABORT, 0x04);
+    xfer_read(c, DP_CTRL_R);
+    xfer_write(c, AP_TAR, SWD_TARGET_RAM);
+    xfer_read(c, AP_DRW_R);
+    check_run();
+    expect_ack(4, ACK_OK);
+    expect(!(resp_word(3) & 0x20), "STICKYERR not cleared: ctrl/stat %08x", resp_word(3));
+    expect(resp_word(7) == ram_word(SWD_TARGET_RAM), "data %08x", resp_word(7));
+    vendor_stats(false, 0);
+    check_run();
+    expect(resp_word(14) == 1 && resp_word(2) == 0 && resp_word(18) == 0 && resp_word(22) == 0,
+        "stats: fault %u wait %u parity %u no ack %u", resp_word(14), resp_word(2), resp_word(18), resp_word(22));
+}
+
+/* a chain of four, with jtag-dps at 0 and 2 */
+static const struct jtag_target_config jtag_chain = {4, {4, 5, 4, 7}};
+
+static void check_start_jtag(const char *name, int dev)
+{
+    check_name         = name;
+    jtag_target_config = jtag_chain;
+    target_reset();
+    for (int i = 0; i < SWD_TARGET_RAM_SIZE; i++)
+        swd_target_ram[i] = i * 7 + (i >> 8);
+    trace_len = 0;
+    trace_connect_jtag(dev);
+    check_run();
+}
+
+/* IDCODE and memory access through each jtag-dp, switching between them */
+static void check_jtag()
+{
+    uint8_t         data[4 * BLOCK_WORDS];
+    uint32_t        addr = SWD_TARGET_RAM + 0x500;
+    uint32_t        ir;
+    struct command *c;
+
+    check_start_jtag("jtag", 2);
+    expect_ack(4, ACK_OK);
+    expect((resp_word(3) & 0xf0000000) == 0xf0000000, "ctrl/stat %08x", resp_word(3));
+
+    for (int n = 0; n < 2; n++)
+        for (int dev = 0; dev < 4; dev += 2)
+        {
+            c = cmd_new(ID_DAP_JTAG_IDCODE);
+            cmd_byte(c, dev);
+            check_run();
+            expect(resp[1] == 0 && resp_word(2) == jtag_target_idcode(dev), "device %d: idcode %08x", dev, resp_word(2));
+
+            c         = xfer_begin();
+            c->req[1] = dev;
+            xfer_write(c, AP_TAR, addr);
+            xfer_read(c, AP_DRW_R);
+            xfer_read(c, AP_DRW_R);
+            xfer_read(c, DP_CTRL_R);
+            check_run();
+            expect_ack(4, ACK_OK);
+            expect(resp_word(3) == ram_word(addr) && resp_word(7) == ram_word(addr + 4), "device %d: data %08x %08x", dev,
+                resp_word(3), resp_word(7));
+        }
+
+    c = cmd_new(ID_DAP_JTAG_IDCODE);
+    cmd_byte(c, 1);
+    check_run();
+    expect(resp[1] != 0, "device 1 is not a jtag-dp");
+
+    for (int i = 0; i < sizeof(data); i++)
+        data[i] = i ^ 0xa5;
+    c         = xfer_begin();
+    c->req[1] = 0;
+    xfer_write(c, AP_TAR, addr);
+    block(AP_DRW_W, BLOCK_WORDS, data);
+    check_run();
+    expect(!memcmp(&swd_target_ram[addr - SWD_TARGET_RAM], data, sizeof(data)), "block write: memory differs");
+
+    c         = xfer_begin();
+    c->req[1] = 2;
+    xfer_write(c, AP_TAR, addr);
+    block(AP_DRW_R, BLOCK_WORDS, NULL);
+    trace[trace_len - 1].req[1] = 2;
+    check_run();
+    expect((resp[1] | resp[2] << 8) == BLOCK_WORDS && resp[3] == ACK_OK, "block read: count %d ack %#x", resp[1] | resp[2] << 8, resp[3]);
+    expect(!memcmp(&resp[4], data, sizeof(data)), "block read: data differs");
+
+    check_vendor_crc(2);
+
+    /* the ir is kept across requests, and written again after the tap was reset */
+    ir = jtag_target_stats.ir_scans;
+    for (int i = 0; i < 3; i++)
+    {
+        c = cmd_new(ID_DAP_JTAG_IDCODE);
+        cmd_byte(c, 2);
+    }
+    check_run();
+    expect(jtag_target_stats.ir_scans - ir == 1, "idcode x3: %u ir scans", jtag_target_stats.ir_scans - ir);
+
+    c         = xfer_begin();
+    c->req[1] = 2;
+    xfer_read(c, DP_CTRL_R);
+    c = cmd_new(ID_DAP_JTAG_SEQUENCE);
+    cmd_byte(c, 2);
+    cmd_byte(c, 0x40 | 5); /* tms 1: test-logic-reset */
+    cmd_byte(c, 0xff);
+    cmd_byte(c, 1); /* tms 0: run-test/idle */
+    cmd_byte(c, 0xff);
+    c         = xfer_begin();
+    c->req[1] = 2;
+    xfer_read(c, DP_CTRL_R);
+    xfer_write(c, AP_TAR, addr);
+    xfer_read(c, AP_DRW_R);
+    check_run();
+    expect_ack(3, ACK_OK);
+    expect(resp_word(7) == ram_word(addr), "after tap reset: data %08x", resp_word(7));
+
+    jtag_target_config = (struct jtag_target_config){1, {4}};
+}
+
+static int check()
+{
+    int failed = 0;
+
+    for (engine = DAP_SWD_ENGINE_BIT; engine <= DAP_SWD_ENGINE_VERIFY; engine++)
+    {
+        check_failed = 0;
+        check_timing();
+        check_posted();
+        check_timestamp();
+        check_vendor();
+        check_vendor_bulk();
+        check_handover();
+        check_block();
+        check_match();
+        check_wait();
+        check_wait_backoff();
+        check_tune();
+        check_fault();
+        check_jtag();
+        check_name = "batching";
+        memset(&swd_target_config, 0, sizeof(swd_target_config));
+        expect(bench(4, true) == 0, "single and batched differ");
+        swd_target_config.wait_every = 7;
+        swd_target_config.wait_count = 2;
+        expect(bench(4, true) == 0, "single and batched differ, with WAIT");
+        memset(&swd_target_config, 0, sizeof(swd_target_config));
+        printf("%-6s %s\n", engine_name[engine], check_failed ? "FAIL" : "ok");
+        failed += check_failed;
+    }
+    return failed != 0;
+}
+
+/* jtag ************************************************************************/
+
+static void bench_jtag_run(const char *name, int requests, int words)
+{
+    uint32_t edges = swd_target_edges, ir = jtag_target_stats.ir_scans, dr = jtag_target_stats.dr_scans;
+
+    check_run();
+    printf("%-14s %8d %9.1f %9.1f %8u %8u\n", name, requests, (double)(swd_target_edges - edges) / requests,
+        (double)(swd_target_edges - edges) / words, jtag_target_stats.ir_scans - ir, jtag_target_stats.dr_scans - dr);
+}
+
+/* tck edges and ir scans on the chain of check_jtag(), one command per request */
+static int bench_jtag(int requests)
+{
+    struct command *c;
+
+    check_start_jtag("jtag", 2);
+    printf("jtag chain of 4, jtag-dps at 0 and 2\n");
+    printf("command        requests tck/req   tck/word ir scans dr scans\n");
+
+    for (int i = 0; i < requests; i++)
+    {
+        c = cmd_new(ID_DAP_JTAG_IDCODE);
+        cmd_byte(c, 2);
+    }
+    bench_jtag_run("IDCODE", requests, requests);
+
+    for (int i = 0; i < requests; i++)
+    {
+        c         = xfer_begin();
+        c->req[1] = 2;
+        xfer_write(c, AP_TAR, SWD_TARGET_RAM);
+        for (int j = 0; j < 7; j++)
+            xfer_read(c, AP_DRW_R);
+    }
+    bench_jtag_run("APACC x7", requests, 7 * requests);
+
+    for (int i = 0; i < requests; i++)
+    {
+        block(AP_DRW_R, BLOCK_WORDS, NULL);
+        trace[trace_len - 1].req[1] = 2;
+    }
+    bench_jtag_run("TransferBlock", requests, BLOCK_WORDS * requests);
+
+    for (int i = 0; i < requests; i++)
+    {
+        c = cmd_new(ID_DAP_JTAG_IDCODE);
+        cmd_byte(c, i & 2);
+        c         = xfer_begin();
+        c->req[1] = i & 2;
+        xfer_read(c, AP_DRW_R);
+    }
+    bench_jtag_run("both devices", 2 * requests, requests);
+
+    jtag_target_config = (struct jtag_target_config){1, {4}};
+    return 0;
+}
+
+/* main ************************************************************************/
+
+static void usage()
+{
+    fprintf(stderr, "usage: dap_sim [-e bit|word|verify] [-w every] [-W count] [pages | blocks [kbytes] | dump [kbytes] | jtag [requests] | replay file | check]\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int opt, pages = 64;
+
+    while ((opt = getopt(argc, argv, "e:w:W:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'e':
+            for (engine = DAP_SWD_ENGINE_VERIFY; engine > DAP_SWD_ENGINE_BIT; engine--)
+                if (!strcmp(optarg, engine_name[engine]))
+                    break;
+            break;
+        case 'w':
+            swd_target_config.wait_every = atoi(optarg);
+            break;
+        case 'W':
+            swd_target_config.wait_count = atoi(optarg);
+            break;
+        default:
+            usage();
+        }
+    }
+    if (swd_target_config.wait_every && !swd_target_config.wait_count)
+        swd_target_config.wait_count = 1;
+
+    trace = calloc(MAX_COMMANDS, sizeof(*trace));
+
+    if (optind < argc && !strcmp(argv[optind], "replay"))
+    {
+        if (optind + 1 >= argc)
+            usage();
+        return replay(argv[optind + 1]);
+    }
+    if (optind < argc && !strcmp(argv[optind], "check"))
+        return check();
+    if (optind < argc && !strcmp(argv[optind], "jtag"))
+        return bench_jtag(optind + 1 < argc ? atoi(argv[optind + 1]) : 100);
+    if (optind < argc && !strcmp(argv[optind], "blocks"))
+        return bench_blocks(optind + 1 < argc ? atoi(argv[optind + 1]) : 1024);
+    if (optind < argc && !strcmp(argv[optind], "dump"))
+        return bench_dump(optind + 1 < argc ? atoi(argv[optind + 1]) : 64);
+
+    if (optind < argc)
+        pages = atoi(argv[optind]);
+    if (pages < 1 || FLASH - SWD_TARGET_RAM + PAGE_SIZE * pages > SWD_TARGET_RAM_SIZE)
+    {
+        fprintf(stderr, "pages 1..%d\n", (SWD_TARGET_RAM_SIZE - (FLASH - SWD_TARGET_RAM)) / PAGE_SIZE);
+        return 1;
+    }
+    return bench(pages, false);
+}
@@ -0,0 +1,7 @@
+// minimal board.h for host builds of applications/ sources
+#ifndef _BOARD_H
+#define _BOARD_H
+
+#define AT32_RAMFUNC
+
+#endif
@@ -0,0 +1,16 @@
+// minimal memwatch.h for host builds of applications/ sources
+#ifndef _MEMWATCH_H
+#define _MEMWATCH_H
+
+#include <stdint.h>
+
+#define MEMWATCH_NUM 8
+
+typedef struct
+{
+    uint32_t addr;
+    uint32_t mode;
+    char     name[16];
+} memwatch_s;
+
+#endif
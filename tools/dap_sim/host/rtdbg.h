@@ -0,0 +1,10 @@
+// minimal rtdbg.h for host builds of applications/ sources
+#ifndef _RTDBG_H
+#define _RTDBG_H
+
+#define LOG_E(...)
+#define LOG_W(...)
+#define LOG_I(...)
+#define LOG_D(...)
+
+#endif
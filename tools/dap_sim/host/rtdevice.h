@@ -0,0 +1,7 @@
+// minimal rtdevice.h for host builds of applications/ sources
+#ifndef _RTDEVICE_H
+#define _RTDEVICE_H
+
+struct rt_can_msg;
+
+#endif
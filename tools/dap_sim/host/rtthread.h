@@ -0,0 +1,113 @@
+// minimal rt-thread for host builds of applications/ sources
+#ifndef _RTTHREAD_H
+#define _RTTHREAD_H
+
+#include <assert.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+
+#define RT_NULL      NULL
+#define RT_ASSERT(x) assert(x)
+
+#define RT_EOK              0
+#define RT_ERROR            1
+#define RT_ETIMEOUT         2
+#define RT_WAITING_FOREVER  -1
+#define RT_IPC_FLAG_PRIO    1
+#define RT_TICK_PER_SECOND  1000
+
+typedef int               rt_err_t;
+typedef int               rt_bool_t;
+typedef uint32_t          rt_tick_t;
+typedef struct rt_thread *rt_thread_t;
+
+#define rt_kprintf printf
+
+// init functions run before main()
+#define INIT_DEVICE_EXPORT(fn) \
+    static void __attribute__((constructor)) fn##_ctor(void) { fn(); }
+#define INIT_APP_EXPORT(fn) INIT_DEVICE_EXPORT(fn)
+
+static inline rt_thread_t rt_thread_self(void)
+{
+    return (rt_thread_t)pthread_self();
+}
+
+// the scheduler lock is one mutex, per translation unit
+static pthread_mutex_t rt_critical_lock __attribute__((unused)) = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void rt_enter_critical(void)
+{
+    pthread_mutex_lock(&rt_critical_lock);
+}
+
+static inline void rt_exit_critical(void)
+{
+    pthread_mutex_unlock(&rt_critical_lock);
+}
+
+struct rt_mutex
+{
+    pthread_mutex_t mutex;
+};
+
+static inline rt_err_t rt_mutex_init(struct rt_mutex *m, const char *name, uint8_t flag)
+{
+    (void)name;
+    (void)flag;
+    return pthread_mutex_init(&m->mutex, NULL);
+}
+
+static inline rt_err_t rt_mutex_take(struct rt_mutex *m, int32_t timeout)
+{
+    (void)timeout;
+    return pthread_mutex_lock(&m->mutex);
+}
+
+static inline rt_err_t rt_mutex_release(struct rt_mutex *m)
+{
+    return pthread_mutex_unlock(&m->mutex);
+}
+
+// one tick is one millisecond
+struct rt_semaphore
+{
+    sem_t sem;
+};
+
+static inline rt_err_t rt_sem_init(struct rt_semaphore *s, const char *name, uint32_t value, uint8_t flag)
+{
+    (void)name;
+    (void)flag;
+    return sem_init(&s->sem, 0, value);
+}
+
+static inline rt_err_t rt_sem_take(struct rt_semaphore *s, int32_t timeout)
+{
+    struct timespec ts;
+
+    if (timeout == RT_WAITING_FOREVER)
+        return sem_wait(&s->sem) ? RT_ERROR : RT_EOK;
+    if (timeout == 0)
+        return sem_trywait(&s->sem) ? RT_ETIMEOUT : RT_EOK;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout / 1000;
+    ts.tv_nsec += (timeout % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return sem_timedwait(&s->sem, &ts) ? RT_ETIMEOUT : RT_EOK;
+}
+
+static inline rt_err_t rt_sem_release(struct rt_semaphore *s)
+{
+    return sem_post(&s->sem);
+}
+
+#endif
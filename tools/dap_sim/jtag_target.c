@@ -0,0 +1,237 @@
+#include <string.h>
+#include "swd_target.h"
+#include "jtag_target.h"
+
+/* jtag scan chain model. see jtag_target.h */
+
+enum tap_state
+{
+    TAP_RESET,
+    TAP_IDLE,
+    TAP_SELECT_DR,
+    TAP_CAPTURE_DR,
+    TAP_SHIFT_DR,
+    TAP_EXIT1_DR,
+    TAP_PAUSE_DR,
+    TAP_EXIT2_DR,
+    TAP_UPDATE_DR,
+    TAP_SELECT_IR,
+    TAP_CAPTURE_IR,
+    TAP_SHIFT_IR,
+    TAP_EXIT1_IR,
+    TAP_PAUSE_IR,
+    TAP_EXIT2_IR,
+    TAP_UPDATE_IR,
+};
+
+/* next state, for tms 0 and 1 */
+static const uint8_t tap_next[16][2] = {
+    [TAP_RESET]      = {TAP_IDLE, TAP_RESET},
+    [TAP_IDLE]       = {TAP_IDLE, TAP_SELECT_DR},
+    [TAP_SELECT_DR]  = {TAP_CAPTURE_DR, TAP_SELECT_IR},
+    [TAP_CAPTURE_DR] = {TAP_SHIFT_DR, TAP_EXIT1_DR},
+    [TAP_SHIFT_DR]   = {TAP_SHIFT_DR, TAP_EXIT1_DR},
+    [TAP_EXIT1_DR]   = {TAP_PAUSE_DR, TAP_UPDATE_DR},
+    [TAP_PAUSE_DR]   = {TAP_PAUSE_DR, TAP_EXIT2_DR},
+    [TAP_EXIT2_DR]   = {TAP_SHIFT_DR, TAP_UPDATE_DR},
+    [TAP_UPDATE_DR]  = {TAP_IDLE, TAP_SELECT_DR},
+    [TAP_SELECT_IR]  = {TAP_CAPTURE_IR, TAP_RESET},
+    [TAP_CAPTURE_IR] = {TAP_SHIFT_IR, TAP_EXIT1_IR},
+    [TAP_SHIFT_IR]   = {TAP_SHIFT_IR, TAP_EXIT1_IR},
+    [TAP_EXIT1_IR]   = {TAP_PAUSE_IR, TAP_UPDATE_IR},
+    [TAP_PAUSE_IR]   = {TAP_PAUSE_IR, TAP_EXIT2_IR},
+    [TAP_EXIT2_IR]   = {TAP_SHIFT_IR, TAP_UPDATE_IR},
+    [TAP_UPDATE_IR]  = {TAP_IDLE, TAP_SELECT_DR},
+};
+
+/* arm jtag-dp instructions */
+#define IR_ABORT  0x8
+#define IR_DPACC  0xa
+#define IR_APACC  0xb
+#define IR_IDCODE 0xe
+
+/* jtag-dp acks */
+#define JTAG_ACK_OK   0x2 /* or FAULT */
+#define JTAG_ACK_WAIT 0x1
+
+#define ACK_OK   1
+#define ACK_WAIT 2
+
+struct device
+{
+    bool     arm;
+    uint32_t ir;
+    uint64_t shift;     /* ir or dr shift register */
+    int      length;    /* of the shift register */
+    uint32_t result;    /* jtag-dp: data of the last access, for the next capture */
+    int      pending;   /* jtag-dp: request that got WAIT, or -1 */
+    uint32_t data;      /* jtag-dp: data of the pending request */
+    bool     skip;      /* jtag-dp: WAIT captured, ignore the next update */
+};
+
+struct jtag_target_config jtag_target_config = {1, {4}};
+struct jtag_target_stats  jtag_target_stats;
+int                       jtag_host_tdi = 1;
+
+static enum tap_state state;
+static struct device  dev[JTAG_TARGET_MAX_DEVICES];
+
+static uint32_t idcode_ir(int i)
+{
+    return dev[i].arm ? IR_IDCODE : 1;
+}
+
+uint32_t jtag_target_idcode(int i)
+{
+    return dev[i].arm ? JTAG_TARGET_DP_IDCODE : 0x10000001 | i << 12;
+}
+
+static bool dp_selected(int i)
+{
+    return dev[i].arm && (dev[i].ir == IR_DPACC || dev[i].ir == IR_APACC);
+}
+
+/* retry a request that got WAIT. returns the jtag ack */
+static uint32_t dp_retry(int i)
+{
+    if (dev[i].pending < 0)
+        return JTAG_ACK_OK;
+    if (swd_target_access(dev[i].pending, &dev[i].data) == ACK_WAIT)
+        return JTAG_ACK_WAIT;
+    dev[i].result  = dev[i].data;
+    dev[i].pending = -1;
+    return JTAG_ACK_OK;
+}
+
+static void capture_dr(int i)
+{
+    uint32_t ack;
+
+    if (dp_selected(i))
+    {
+        ack          = dp_retry(i);
+        dev[i].skip  = ack == JTAG_ACK_WAIT;
+        dev[i].shift = (uint64_t)dev[i].result << 3 | ack;
+        dev[i].length = 35;
+    }
+    else if (dev[i].arm && dev[i].ir == IR_ABORT)
+    {
+        dev[i].shift  = 0;
+        dev[i].length = 35;
+    }
+    else if (dev[i].ir == idcode_ir(i))
+    {
+        dev[i].shift  = jtag_target_idcode(i);
+        dev[i].length = 32;
+    }
+    else
+    {
+        dev[i].shift  = 0;
+        dev[i].length = 1;
+    }
+}
+
+/* bit 0 RnW, bits 2:1 A[3:2], bits 34:3 data */
+static void update_dr(int i)
+{
+    int      req;
+    uint32_t data = dev[i].shift >> 3;
+
+    if (dev[i].arm && dev[i].ir == IR_ABORT)
+    {
+        swd_target_access(0, &data);
+        return;
+    }
+    if (!dp_selected(i))
+        return;
+    if (dev[i].skip)
+    {
+        dev[i].skip = false;
+        return;
+    }
+    req = (dev[i].ir == IR_APACC) | (dev[i].shift & 7) << 1;
+    if (swd_target_access(req, &data) == ACK_WAIT)
+    {
+        dev[i].pending = req;
+        dev[i].data    = data;
+        return;
+    }
+    dev[i].result = data;
+}
+
+/* tdi -> device count-1 -> ... -> device 0 -> tdo */
+static void shift()
+{
+    int count = jtag_target_config.count;
+
+    for (int i = 0; i < count; i++)
+    {
+        int in = i == count - 1 ? jtag_host_tdi : dev[i + 1].shift & 1;
+        dev[i].shift = dev[i].shift >> 1 | (uint64_t)in << (dev[i].length - 1);
+    }
+}
+
+void jtag_target_clock_rise()
+{
+    int count = jtag_target_config.count;
+    int tms   = swd_host_swdio;
+
+    swd_target_edges++;
+
+    switch (state)
+    {
+    case TAP_RESET:
+        for (int i = 0; i < count; i++)
+            dev[i].ir = idcode_ir(i);
+        break;
+    case TAP_CAPTURE_DR:
+        for (int i = 0; i < count; i++)
+            capture_dr(i);
+        break;
+    case TAP_CAPTURE_IR:
+        for (int i = 0; i < count; i++)
+        {
+            dev[i].shift  = 1;
+            dev[i].length = jtag_target_config.ir_length[i];
+        }
+        break;
+    case TAP_SHIFT_DR:
+    case TAP_SHIFT_IR:
+        shift();
+        break;
+    case TAP_UPDATE_DR:
+        jtag_target_stats.dr_scans++;
+        for (int i = 0; i < count; i++)
+            update_dr(i);
+        break;
+    case TAP_UPDATE_IR:
+        jtag_target_stats.ir_scans++;
+        for (int i = 0; i < count; i++)
+            dev[i].ir = dev[i].shift & ((1 << dev[i].length) - 1);
+        break;
+    default:
+        break;
+    }
+    state = tap_next[state][tms];
+}
+
+/* tdo changes on the falling edge: the shift register of device 0 */
+int jtag_target_tdo()
+{
+    if (state != TAP_SHIFT_DR && state != TAP_SHIFT_IR)
+        return 1;
+    return dev[0].shift & 1;
+}
+
+void jtag_target_reset()
+{
+    state = TAP_RESET;
+    memset(dev, 0, sizeof(dev));
+    for (int i = 0; i < jtag_target_config.count; i++)
+    {
+        dev[i].arm     = jtag_target_config.ir_length[i] == 4;
+        dev[i].ir      = idcode_ir(i);
+        dev[i].pending = -1;
+    }
+    memset(&jtag_target_stats, 0, sizeof(jtag_target_stats));
+}
@@ -0,0 +1,40 @@
+#ifndef _JTAG_TARGET_H
+#define _JTAG_TARGET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+   pin-level model of a jtag scan chain. tck is swclk, tms is swdio.
+   devices with a 4 bit ir are arm jtag-dps, connected to the dp and mem-ap of
+   swd_target.c. other devices only have BYPASS and IDCODE.
+   device 0 is nearest to tdo, as in DAP_JTAG_Configure.
+ */
+
+#define JTAG_TARGET_MAX_DEVICES 8
+#define JTAG_TARGET_DP_IDCODE   0x4ba00477
+
+struct jtag_target_config
+{
+    int count;
+    int ir_length[JTAG_TARGET_MAX_DEVICES];
+};
+
+struct jtag_target_stats
+{
+    uint32_t ir_scans; /* Update-IR */
+    uint32_t dr_scans; /* Update-DR */
+};
+
+extern struct jtag_target_config jtag_target_config;
+extern struct jtag_target_stats  jtag_target_stats;
+
+/* tdi, as driven by the host */
+extern int jtag_host_tdi;
+
+void     jtag_target_reset(void);
+void     jtag_target_clock_rise(void);
+int      jtag_target_tdo(void);
+uint32_t jtag_target_idcode(int device);
+
+#endif
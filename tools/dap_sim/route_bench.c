@@ -0,0 +1,239 @@
+// host test of applications/route.c, with counting stub sinks.
+// usage: route_bench [calls]
+// checks fan-out, the lua sink wakeup, the loop check used by the route command, that the rtt and slcan
+// sinks see one source at a time, and that an slcan reply routed back into slcan
+// returns instead of deadlocking. then prints the time per route_write() for each sink.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include "route.h"
+#include "settings.h"
+#include "usb_slcan.h"
+
+#define LEN     64
+#define THREADS 4
+
+settings_struct settings;
+
+static uint32_t sink_bytes[ROUTE_SINK_NUM];
+static int      rtt_inside, slcan_inside;
+static uint32_t errors;
+
+// stub sinks. the rtt and slcan stubs check they are not entered twice at once
+
+void cdc1_write(uint8_t *buf, uint32_t nbytes)
+{
+    __atomic_add_fetch(&sink_bytes[0], nbytes, __ATOMIC_RELAXED);
+}
+
+void logger(char *buf, uint32_t buflen)
+{
+    __atomic_add_fetch(&sink_bytes[1], buflen, __ATOMIC_RELAXED);
+}
+
+int32_t serial0_write(uint8_t *buf, uint32_t len)
+{
+    __atomic_add_fetch(&sink_bytes[3], len, __ATOMIC_RELAXED);
+    return len;
+}
+
+int32_t serial1_write(uint8_t *buf, uint32_t len)
+{
+    __atomic_add_fetch(&sink_bytes[4], len, __ATOMIC_RELAXED);
+    return len;
+}
+
+int32_t rtt_read(uint8_t *buf, uint32_t len)
+{
+    if (__atomic_add_fetch(&rtt_inside, 1, __ATOMIC_SEQ_CST) != 1)
+        __atomic_add_fetch(&errors, 1, __ATOMIC_RELAXED);
+    sched_yield();
+    sink_bytes[5] += len;
+    __atomic_sub_fetch(&rtt_inside, 1, __ATOMIC_SEQ_CST);
+    return len;
+}
+
+// answers every packet, like slcan_process() answers commands
+void slcan_process(uint8_t *buf, uint32_t len)
+{
+    static uint8_t reply[] = "\r";
+
+    if (__atomic_add_fetch(&slcan_inside, 1, __ATOMIC_SEQ_CST) != 1)
+        __atomic_add_fetch(&errors, 1, __ATOMIC_RELAXED);
+    sched_yield();
+    sink_bytes[6] += len;
+    slcan_send_reply(reply, 1);
+    __atomic_sub_fetch(&slcan_inside, 1, __ATOMIC_SEQ_CST);
+}
+
+static void check(int ok, const char *what)
+{
+    if (!ok)
+    {
+        printf("route: %s failed\n", what);
+        errors++;
+    }
+}
+
+static void check_loops(void)
+{
+    uint8_t route[ROUTE_SRC_NUM];
+
+    memcpy(route, settings.route, sizeof(route));
+    check(!route_loop(route), "default routes");
+    route[ROUTE_SRC_SERIAL0] = ROUTE_SINK_SERIAL0;
+    check(route_loop(route), "serial0 to serial0");
+    memcpy(route, settings.route, sizeof(route));
+    route[ROUTE_SRC_CAN] |= ROUTE_SINK_SLCAN;
+    check(route_loop(route), "can to slcan");
+    memcpy(route, settings.route, sizeof(route));
+    route[ROUTE_SRC_SERIAL0] = ROUTE_SINK_RTT;
+    check(!route_loop(route), "serial0 to rtt");
+    route[ROUTE_SRC_RTT] = ROUTE_SINK_SERIAL1;
+    check(!route_loop(route), "serial0 to rtt to serial1");
+    route[ROUTE_SRC_SERIAL1] = ROUTE_SINK_SERIAL0;
+    check(route_loop(route), "serial0 to rtt to serial1 to serial0");
+}
+
+static void check_fanout(void)
+{
+    uint8_t  buf[LEN], tail[2 * LEN];
+    uint32_t before[ROUTE_SINK_NUM];
+
+    memset(buf, 'x', sizeof(buf));
+    memcpy(before, sink_bytes, sizeof(before));
+    settings.route[ROUTE_SRC_SWO] = ROUTE_SINK_CDC1 | ROUTE_SINK_TAIL | ROUTE_SINK_SERIAL1 | ROUTE_SINK_RTT;
+    route_write(ROUTE_SRC_SWO, buf, sizeof(buf));
+    check(sink_bytes[0] - before[0] == LEN, "swo to usb");
+    check(sink_bytes[1] == before[1], "swo not to log");
+    check(sink_bytes[4] - before[4] == LEN, "swo to serial1");
+    check(sink_bytes[5] - before[5] == LEN, "swo to rtt");
+    check(route_tail_read(tail, sizeof(tail)) == LEN && !memcmp(tail, buf, LEN), "swo to tail");
+    settings.route[ROUTE_SRC_SWO] = ROUTE_DEFAULT_OUTPUT;
+}
+
+// the lua sink wakes a reader waiting on it, and times out when empty
+static void *lua_writer(void *arg)
+{
+    uint8_t buf[LEN];
+
+    memset(buf, 'x', sizeof(buf));
+    route_write(ROUTE_SRC_SERIAL0, buf, sizeof(buf));
+    return NULL;
+}
+
+static void check_lua(void)
+{
+    uint8_t   buf[2 * LEN];
+    pthread_t t;
+
+    settings.route[ROUTE_SRC_SERIAL0] = ROUTE_SINK_LUA;
+    check(route_lua_read(buf, sizeof(buf), 0) == 0, "lua empty");
+    check(route_lua_read(buf, sizeof(buf), 10) == 0, "lua timeout");
+    pthread_create(&t, NULL, lua_writer, NULL);
+    check(route_lua_read(buf, sizeof(buf), RT_WAITING_FOREVER) == LEN, "serial0 to lua");
+    pthread_join(t, NULL);
+    check(route_lua_read(buf, sizeof(buf), 0) == 0, "lua drained");
+    settings.route[ROUTE_SRC_SERIAL0] = ROUTE_DEFAULT_OUTPUT;
+}
+
+// usb to slcan, and the slcan reply back into slcan as well as to usb
+static void check_slcan_reply(void)
+{
+    uint8_t  buf[] = "t1230\r";
+    uint32_t before[ROUTE_SINK_NUM];
+
+    memcpy(before, sink_bytes, sizeof(before));
+    settings.route[ROUTE_SRC_CDC1] = ROUTE_SINK_SLCAN;
+    settings.route[ROUTE_SRC_CAN]  = ROUTE_SINK_CDC1 | ROUTE_SINK_SLCAN;
+    route_write(ROUTE_SRC_CDC1, buf, sizeof(buf) - 1);
+    check(sink_bytes[6] - before[6] == sizeof(buf) - 1, "slcan reply not parsed");
+    check(sink_bytes[0] - before[0] == 1, "slcan reply to usb");
+    settings.route[ROUTE_SRC_CDC1] = ROUTE_DEFAULT_INPUT;
+    settings.route[ROUTE_SRC_CAN]  = ROUTE_DEFAULT_OUTPUT;
+}
+
+// several sources into rtt and slcan at once
+static void *source(void *arg)
+{
+    uint8_t buf[LEN];
+
+    memset(buf, 'x', sizeof(buf));
+    for (int i = 0; i < 2000; i++)
+        route_write((uintptr_t)arg, buf, sizeof(buf));
+    return NULL;
+}
+
+static void check_threads(void)
+{
+    pthread_t t[THREADS];
+    uint32_t  before = sink_bytes[5] + sink_bytes[6];
+
+    for (uintptr_t i = 0; i < THREADS; i++)
+    {
+        settings.route[i] = ROUTE_SINK_RTT | ROUTE_SINK_SLCAN;
+        pthread_create(&t[i], NULL, source, (void *)i);
+    }
+    for (int i = 0; i < THREADS; i++)
+        pthread_join(t[i], NULL);
+    check(sink_bytes[5] + sink_bytes[6] - before == 2 * THREADS * 2000 * LEN, "threads to rtt and slcan");
+    for (int i = 0; i < THREADS; i++)
+        settings.route[i] = ROUTE_DEFAULT_OUTPUT;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void bench(const char *name, uint8_t sinks, uint32_t calls)
+{
+    uint8_t buf[LEN];
+    double  start;
+
+    memset(buf, 'x', sizeof(buf));
+    settings.route[ROUTE_SRC_SWO] = sinks;
+    start = now_ns();
+    for (uint32_t i = 0; i < calls; i++)
+    {
+        route_write(ROUTE_SRC_SWO, buf, sizeof(buf));
+        if (sinks & ROUTE_SINK_TAIL)
+            route_tail_read(buf, sizeof(buf));
+    }
+    printf("%-8s %6.1f ns per %d byte write\n", name, (now_ns() - start) / calls, LEN);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t calls = argc > 1 ? atoi(argv[1]) : 1000000;
+
+    for (int i = 0; i < ROUTE_SRC_NUM; i++)
+        settings.route[i] = ROUTE_DEFAULT_OUTPUT;
+    settings.route[ROUTE_SRC_CDC1] = ROUTE_DEFAULT_INPUT;
+    settings.logging_enable = settings.serial0_enable = settings.serial1_enable = true;
+    settings.rtt_enable = settings.can1_slcan = true;
+
+    check_loops();
+    check_fanout();
+    check_lua();
+    check_slcan_reply();
+    check_threads();
+    printf("route: %u errors\n", errors);
+    if (errors)
+        return 1;
+
+    // stub sinks, so this is the routing overhead. rtt and slcan stubs yield, and are left out
+    bench("none", 0, calls);
+    bench("usb", ROUTE_SINK_CDC1, calls);
+    bench("tail", ROUTE_SINK_TAIL, calls);
+    bench("default", ROUTE_DEFAULT_OUTPUT, calls);
+    bench("all", 0x7f & ~(ROUTE_SINK_RTT | ROUTE_SINK_SLCAN), calls);
+    return 0;
+}
@@ -0,0 +1,117 @@
+// two-thread stress test of applications/spsc_rb.c, on the host.
+// usage: spsc_test [megabytes]
+// a producer thread writes a byte sequence with spsc_rb_put() and spsc_rb_reserve()/produce(),
+// a consumer thread reads it with spsc_rb_get(), spsc_rb_getchar() and spsc_rb_peek()/commit(),
+// and checks every byte. chunk sizes and thread switches are random, and the ring is small,
+// so it wraps often.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "spsc_rb.h"
+
+#define RB_SIZE   64
+#define MAX_CHUNK 80 /* larger than the ring */
+
+static uint8_t        rb_buf[RB_SIZE];
+static struct spsc_rb rb;
+static uint32_t       total;
+static uint32_t       errors;
+
+// byte n of the sequence
+static uint8_t seq(uint32_t n)
+{
+    return (uint8_t)(n * 7 + (n >> 8));
+}
+
+static void *producer(void *arg)
+{
+    unsigned int seed = 1;
+    uint8_t      chunk[MAX_CHUNK];
+    uint8_t     *span;
+    uint32_t     n = 0, len, i;
+
+    (void)arg;
+    while (n < total)
+    {
+        len = 1 + rand_r(&seed) % MAX_CHUNK;
+        if (len > total - n)
+            len = total - n;
+        if (rand_r(&seed) & 1)
+        {
+            for (i = 0; i < len; i++)
+                chunk[i] = seq(n + i);
+            len = spsc_rb_put(&rb, chunk, len);
+        }
+        else
+        {
+            uint32_t space = spsc_rb_reserve(&rb, &span);
+            if (len > space)
+                len = space;
+            for (i = 0; i < len; i++)
+                span[i] = seq(n + i);
+            spsc_rb_produce(&rb, len);
+        }
+        n += len;
+        // let the other side in at random points, also on a single cpu
+        if (len == 0 || rand_r(&seed) % 4 == 0)
+            sched_yield();
+    }
+    return NULL;
+}
+
+static void *consumer(void *arg)
+{
+    unsigned int seed = 2;
+    uint8_t      chunk[MAX_CHUNK];
+    uint8_t     *span;
+    uint32_t     n = 0, len, i;
+
+    (void)arg;
+    while (n < total)
+    {
+        switch (rand_r(&seed) % 3)
+        {
+        case 0:
+            len = spsc_rb_get(&rb, chunk, 1 + rand_r(&seed) % MAX_CHUNK);
+            span = chunk;
+            break;
+        case 1:
+            len = spsc_rb_getchar(&rb, chunk) ? 1 : 0;
+            span = chunk;
+            break;
+        default:
+            len = spsc_rb_peek(&rb, &span);
+            break;
+        }
+        for (i = 0; i < len; i++)
+            if (span[i] != seq(n + i))
+                errors++;
+        if (span != chunk)
+            spsc_rb_commit(&rb, len);
+        if (spsc_rb_data_len(&rb) > RB_SIZE)
+            errors++;
+        n += len;
+        if (len == 0 || rand_r(&seed) % 4 == 0)
+            sched_yield();
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t p, c;
+
+    total = (argc > 1 ? atoi(argv[1]) : 16) * 1024 * 1024;
+    spsc_rb_init(&rb, rb_buf, sizeof(rb_buf));
+    pthread_create(&c, NULL, consumer, NULL);
+    pthread_create(&p, NULL, producer, NULL);
+    pthread_join(p, NULL);
+    pthread_join(c, NULL);
+    if (spsc_rb_data_len(&rb) != 0)
+        errors++;
+    printf("spsc_rb: %u bytes, %u errors\n", total, errors);
+    return errors != 0;
+}
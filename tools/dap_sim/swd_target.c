@@ -0,0 +1,573 @@
+#include <string.h>
+#include "swd_target.h"
+#include "jtag_target.h"
+
+/* sw-dp and mem-ap model. see swd_target.h */
+
+enum swd_state
+{
+    SWD_RESET,    /* line reset, waiting for idle */
+    SWD_IDLE,     /* waiting for a start bit */
+    SWD_HEADER,   /* request header, from host */
+    SWD_TURN_ACK, /* turnaround before ack */
+    SWD_ACK,      /* ack, from target */
+    SWD_RDATA,    /* read data and parity, from target */
+    SWD_TURN_END, /* turnaround after read data, or after wait/fault */
+    SWD_TURN_W,   /* turnaround before write data */
+    SWD_WDATA,    /* write data and parity, from host */
+    SWD_LOCKOUT,  /* protocol error, wait for line reset */
+};
+
+#define SWD_SELECT_SEQ 0xe79e /* jtag-to-swd select, lsb first */
+
+#define ACK_OK    1
+#define ACK_WAIT  2
+#define ACK_FAULT 4
+
+/* dp registers */
+#define DP_ABORT_STKCMPCLR  (1 << 1)
+#define DP_ABORT_STKERRCLR  (1 << 2)
+#define DP_ABORT_WDERRCLR   (1 << 3)
+#define DP_ABORT_ORUNERRCLR (1 << 4)
+#define DP_ABORT_DAPABORT   (1 << 0)
+#define DP_CTRL_ORUNDETECT  (1 << 0)
+#define DP_CTRL_STICKYORUN  (1 << 1)
+#define DP_CTRL_STICKYCMP   (1 << 4)
+#define DP_CTRL_STICKYERR   (1 << 5)
+#define DP_CTRL_WDATAERR    (1 << 7)
+#define DP_CTRL_STICKY      (DP_CTRL_STICKYORUN | DP_CTRL_STICKYCMP | DP_CTRL_STICKYERR | DP_CTRL_WDATAERR)
+#define DP_CTRL_PWRUPREQ    ((1 << 30) | (1 << 28))
+
+/* core debug registers */
+#define DHCSR 0xe000edf0
+#define DCRSR 0xe000edf4
+#define DCRDR 0xe000edf8
+#define DEMCR 0xe000edfc
+
+#define DHCSR_S_REGRDY (1 << 16)
+#define DHCSR_S_HALT   (1 << 17)
+
+int      swd_host_swdio;
+bool     swd_host_swdio_out;
+uint32_t swd_target_edges;
+uint8_t  swd_target_ram[SWD_TARGET_RAM_SIZE];
+
+struct swd_target_config swd_target_config;
+struct swd_target_stats  swd_target_stats;
+bool                     swd_target_jtag;
+uint8_t                 *swd_target_record;
+const uint8_t           *swd_target_playback;
+
+static int            swclk;
+static enum swd_state state;
+static uint32_t       bit;       /* bit number within the current phase */
+static uint32_t       shift;     /* bits shifted in or out */
+static uint32_t       ones;      /* consecutive ones, for line reset */
+static uint32_t       select_bit;   /* bits of the jtag-to-swd select matched since the line reset */
+static bool           select_error; /* header error, unless the bits are the jtag-to-swd select */
+static int            drive;     /* target swdio output, or -1 if not driving */
+static uint32_t       header;
+static uint32_t       ack;
+static uint32_t       turnaround = 1;
+static uint32_t       start_edge;
+
+static uint32_t ap_accesses;
+static uint32_t wait_left;
+static bool     waiting;
+
+static uint32_t dp_ctrl;
+static uint32_t dp_select;
+static uint32_t dp_rdbuff;
+static uint32_t ap_csw;
+static uint32_t ap_tar;
+static uint32_t core_reg[4]; /* dhcsr, dcrsr, dcrdr, demcr */
+static uint32_t core_regs[32];
+
+static int parity(uint32_t value)
+{
+    return __builtin_parity(value);
+}
+
+/* memory ********************************************************************/
+
+static bool mem_read(uint32_t addr, uint32_t *value)
+{
+    addr &= ~3U;
+    if (addr >= SWD_TARGET_RAM && addr < SWD_TARGET_RAM + SWD_TARGET_RAM_SIZE)
+    {
+        memcpy(value, &swd_target_ram[addr - SWD_TARGET_RAM], 4);
+        return true;
+    }
+    if (addr >= DHCSR && addr <= DEMCR)
+    {
+        *value = core_reg[(addr - DHCSR) / 4];
+        if (addr == DHCSR)
+            *value |= DHCSR_S_HALT | DHCSR_S_REGRDY;
+        return true;
+    }
+    return false;
+}
+
+static bool mem_write(uint32_t addr, uint32_t value, uint32_t mask)
+{
+    uint32_t old;
+
+    addr &= ~3U;
+    if (!mem_read(addr, &old))
+        return false;
+    value = (old & ~mask) | (value & mask);
+    if (addr >= SWD_TARGET_RAM && addr < SWD_TARGET_RAM + SWD_TARGET_RAM_SIZE)
+    {
+        memcpy(&swd_target_ram[addr - SWD_TARGET_RAM], &value, 4);
+        return true;
+    }
+    core_reg[(addr - DHCSR) / 4] = value;
+    /* register transfer: dcrsr bit 16 is write, bits 4:0 register number */
+    if (addr == DCRSR)
+    {
+        if (value & (1 << 16))
+            core_regs[value & 0x1f] = core_reg[(DCRDR - DHCSR) / 4];
+        else
+            core_reg[(DCRDR - DHCSR) / 4] = core_regs[value & 0x1f];
+    }
+    return true;
+}
+
+/* mem-ap ********************************************************************/
+
+static uint32_t ap_size()
+{
+    return 1U << (ap_csw & 7);
+}
+
+/* tar auto-increment wraps at 1 kbyte */
+static void ap_increment()
+{
+    if ((ap_csw & 0x30) == 0x10)
+        ap_tar = (ap_tar & ~0x3ffU) | ((ap_tar + ap_size()) & 0x3ff);
+}
+
+static bool ap_read(uint32_t reg, uint32_t *value)
+{
+    uint32_t word;
+
+    switch (reg)
+    {
+    case 0x00:
+        *value = ap_csw;
+        return true;
+    case 0x04:
+        *value = ap_tar;
+        return true;
+    case 0x0c:
+        if (!mem_read(ap_tar, &word))
+            return false;
+        /* data on the byte lanes of the address */
+        *value = ap_size() == 4 ? word : word & (0xffffffffU >> (32 - 8 * ap_size())) << (8 * (ap_tar & 3));
+        ap_increment();
+        return true;
+    case 0xfc:
+        *value = SWD_TARGET_AP_IDR;
+        return true;
+    default:
+        *value = 0;
+        return true;
+    }
+}
+
+static bool ap_write(uint32_t reg, uint32_t value)
+{
+    uint32_t mask;
+
+    switch (reg)
+    {
+    case 0x00:
+        ap_csw = value;
+        return true;
+    case 0x04:
+        ap_tar = value;
+        return true;
+    case 0x0c:
+        mask = ap_size() == 4 ? 0xffffffffU : (0xffffffffU >> (32 - 8 * ap_size())) << (8 * (ap_tar & 3));
+        if (!mem_write(ap_tar, value, mask))
+            return false;
+        ap_increment();
+        return true;
+    default:
+        return true;
+    }
+}
+
+/* sw-dp *********************************************************************/
+
+static uint32_t req_addr()
+{
+    return (header >> 1) & 0xc;
+}
+
+static bool req_ap()
+{
+    return header & (1 << 1);
+}
+
+static bool req_read()
+{
+    return header & (1 << 2);
+}
+
+static uint32_t ap_reg()
+{
+    return (dp_select & 0xf0) | req_addr();
+}
+
+/* ap access: FAULT while an error is sticky, else injected WAITs */
+static uint32_t ap_ack()
+{
+    if (dp_ctrl & DP_CTRL_STICKY)
+        return ACK_FAULT;
+    if (waiting)
+    {
+        if (wait_left == 0)
+        {
+            waiting = false;
+            return ACK_OK;
+        }
+        wait_left--;
+        return ACK_WAIT;
+    }
+    if (swd_target_config.wait_every && swd_target_config.wait_count && ++ap_accesses % swd_target_config.wait_every == 0)
+    {
+        waiting   = true;
+        wait_left = swd_target_config.wait_count - 1;
+        return ACK_WAIT;
+    }
+    return ACK_OK;
+}
+
+/* reads execute at the ack. ap reads are posted: the data is from the previous ap read */
+static uint32_t do_read(uint32_t *value)
+{
+    uint32_t data, ack;
+
+    if (req_ap())
+    {
+        if ((ack = ap_ack()) != ACK_OK)
+            return ack;
+        *value = dp_rdbuff;
+        if (!ap_read(ap_reg(), &data))
+        {
+            dp_ctrl |= DP_CTRL_STICKYERR;
+            data = 0;
+        }
+        dp_rdbuff = data;
+        return ACK_OK;
+    }
+
+    switch (req_addr())
+    {
+    case 0x0:
+        *value = SWD_TARGET_IDCODE;
+        break;
+    case 0x4:
+        /* power-up acks follow the requests */
+        *value = dp_ctrl | ((dp_ctrl & DP_CTRL_PWRUPREQ) << 1);
+        break;
+    case 0x8:
+        *value = 0; /* resend, not modelled */
+        break;
+    case 0xc:
+        *value = dp_rdbuff;
+        break;
+    }
+    return ACK_OK;
+}
+
+/* writes execute after the data phase */
+static uint32_t write_ack()
+{
+    if (req_ap())
+        return ap_ack();
+    return ACK_OK;
+}
+
+static void do_write(uint32_t value)
+{
+    if (req_ap())
+    {
+        if (!ap_write(ap_reg(), value))
+            dp_ctrl |= DP_CTRL_STICKYERR;
+        return;
+    }
+
+    switch (req_addr())
+    {
+    case 0x0:
+        if (value & DP_ABORT_DAPABORT)
+            waiting = false;
+        if (value & DP_ABORT_STKCMPCLR)
+            dp_ctrl &= ~DP_CTRL_STICKYCMP;
+        if (value & DP_ABORT_STKERRCLR)
+            dp_ctrl &= ~DP_CTRL_STICKYERR;
+        if (value & DP_ABORT_WDERRCLR)
+            dp_ctrl &= ~DP_CTRL_WDATAERR;
+        if (value & DP_ABORT_ORUNERRCLR)
+            dp_ctrl &= ~DP_CTRL_STICKYORUN;
+        break;
+    case 0x4:
+        dp_ctrl = (dp_ctrl & DP_CTRL_STICKY) | (value & ~DP_CTRL_STICKY);
+        break;
+    case 0x8:
+        dp_select = value;
+        break;
+    }
+}
+
+/* with overrun detection, WAIT and FAULT make the overrun sticky */
+static void count_ack()
+{
+    if (ack == ACK_OK)
+        swd_target_stats.ok++;
+    else if (ack == ACK_WAIT)
+        swd_target_stats.wait++;
+    else
+        swd_target_stats.fault++;
+    if (ack != ACK_OK && (dp_ctrl & DP_CTRL_ORUNDETECT))
+        dp_ctrl |= DP_CTRL_STICKYORUN;
+}
+
+static void transfer_end()
+{
+    swd_target_stats.transfer_edges += swd_target_edges - start_edge + 1;
+    state = SWD_IDLE;
+}
+
+static bool header_valid()
+{
+    return (header & 0x81) == 0x81 && !(header & 0x40) && parity((header >> 1) & 0xf) == ((header >> 5) & 1);
+}
+
+/* one dp or ap access from the jtag-dp. req as in DAP_Transfer. ap reads are
+   not posted: the data is that of this read */
+uint32_t swd_target_access(int req, uint32_t *value)
+{
+    header = 0x81 | (req & 0xf) << 1;
+    if (req_read())
+    {
+        ack = do_read(value);
+        if (ack == ACK_OK && req_ap())
+            *value = dp_rdbuff;
+    }
+    else
+    {
+        ack = write_ack();
+        if (ack == ACK_OK)
+            do_write(*value);
+    }
+    count_ack();
+    return ack;
+}
+
+/* one rising edge of swclk */
+static void clock_rise()
+{
+    int in = swd_host_swdio_out ? swd_host_swdio : -1;
+
+    swd_target_edges++;
+
+    /* line reset: at least 50 clocks with swdio high */
+    if (in == 1)
+    {
+        if (++ones == 50)
+        {
+            swd_target_stats.line_resets++;
+            select_bit = 0;
+            state = SWD_RESET;
+            drive = -1;
+            return;
+        }
+    }
+    else
+        ones = 0;
+
+    /* the jtag-to-swd select after a line reset. the dp is swd already, and waits for a line reset */
+    if (ones > 50)
+        select_bit = 0;
+    else if (select_bit < 16)
+    {
+        if (in != ((SWD_SELECT_SEQ >> select_bit) & 1))
+        {
+            select_bit = 16;
+            if (select_error)
+                swd_target_stats.protocol_errors++;
+            select_error = false;
+        }
+        else if (++select_bit == 16)
+        {
+            select_error = false;
+            state        = SWD_LOCKOUT;
+            return;
+        }
+    }
+
+    switch (state)
+    {
+    case SWD_RESET:
+        if (in == 0)
+            state = SWD_IDLE;
+        break;
+    case SWD_IDLE:
+        if (in == 1)
+        {
+            header     = 1;
+            bit        = 1;
+            start_edge = swd_target_edges;
+            state      = SWD_HEADER;
+        }
+        break;
+    case SWD_HEADER:
+        header |= (in == 1) << bit;
+        if (++bit < 8)
+            break;
+        if (!header_valid())
+        {
+            /* all ones is the start of a line reset */
+            if (select_bit < 16)
+                select_error = true;
+            else if (header != 0xff)
+                swd_target_stats.protocol_errors++;
+            state = SWD_LOCKOUT;
+            break;
+        }
+        bit   = 0;
+        state = SWD_TURN_ACK;
+        break;
+    case SWD_TURN_ACK:
+        if (++bit < turnaround)
+            break;
+        ack = req_read() ? do_read(&shift) : write_ack();
+        count_ack();
+        drive = ack & 1;
+        bit   = 0;
+        state = SWD_ACK;
+        break;
+    case SWD_ACK:
+        if (++bit < 3)
+        {
+            drive = (ack >> bit) & 1;
+            break;
+        }
+        bit = 0;
+        if (ack == ACK_OK && req_read())
+        {
+            drive = shift & 1;
+            state = SWD_RDATA;
+        }
+        else
+        {
+            drive = -1;
+            state = ack == ACK_OK ? SWD_TURN_W : SWD_TURN_END;
+        }
+        break;
+    case SWD_RDATA:
+        if (++bit < 32)
+            drive = (shift >> bit) & 1;
+        else if (bit == 32)
+            drive = parity(shift);
+        else
+        {
+            drive = -1;
+            bit   = 0;
+            state = SWD_TURN_END;
+        }
+        break;
+    case SWD_TURN_END:
+        if (++bit >= turnaround)
+            transfer_end();
+        break;
+    case SWD_TURN_W:
+        if (++bit < turnaround)
+            break;
+        bit   = 0;
+        shift = 0;
+        state = SWD_WDATA;
+        break;
+    case SWD_WDATA:
+        if (bit < 32)
+        {
+            shift |= (uint32_t)(in == 1) << bit++;
+            break;
+        }
+        if ((in == 1) != parity(shift))
+            dp_ctrl |= DP_CTRL_WDATAERR;
+        else
+            do_write(shift);
+        transfer_end();
+        break;
+    case SWD_LOCKOUT:
+        break;
+    }
+}
+
+/* api ***********************************************************************/
+
+void swd_target_reset()
+{
+    swclk      = 0;
+    state      = SWD_LOCKOUT;
+    drive      = -1;
+    ones       = 0;
+    select_bit = 16;
+    select_error = false;
+    turnaround = 1;
+    dp_ctrl    = 0;
+    dp_select  = 0;
+    dp_rdbuff  = 0;
+    waiting    = false;
+    wait_left  = 0;
+    ap_accesses = 0;
+    ap_csw     = 0x23000002;
+    ap_tar     = 0;
+    memset(core_reg, 0, sizeof(core_reg));
+    memset(core_regs, 0, sizeof(core_regs));
+    memset(&swd_target_stats, 0, sizeof(swd_target_stats));
+}
+
+void swd_target_clock_low()
+{
+    swclk = 0;
+}
+
+void swd_target_clock_high()
+{
+    if (!swclk && swd_target_jtag)
+        jtag_target_clock_rise();
+    else if (!swclk)
+        clock_rise();
+    swclk = 1;
+}
+
+int swd_target_clock_read()
+{
+    return swclk;
+}
+
+int swd_target_misread(int freq)
+{
+    static uint32_t bits;
+
+    return swd_target_config.max_freq && freq > swd_target_config.max_freq && ++bits % 16 == 0;
+}
+
+/* pull-up when nobody drives */
+int swd_target_swdio_read()
+{
+    int value;
+
+    if (swd_host_swdio_out)
+        return swd_host_swdio;
+    value = drive < 0 ? 1 : drive;
+    if (swd_target_record)
+        *swd_target_record++ = value;
+    return value;
+}
+
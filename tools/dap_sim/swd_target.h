@@ -0,0 +1,71 @@
+#ifndef _SWD_TARGET_H
+#define _SWD_TARGET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+   pin-level model of an adiv5 sw-dp with one ahb mem-ap.
+   the target samples swdio and changes its output on the rising edge of swclk.
+   memory: ram at SWD_TARGET_RAM, and the core debug registers (dhcsr, dcrsr, dcrdr, demcr).
+   the core is always halted, and register transfers complete at once.
+   ap reads are posted. a bus error sets STICKYERR, and ap accesses answer FAULT until
+   it is cleared in ABORT. ap accesses can be made to answer WAIT.
+ */
+
+#define SWD_TARGET_IDCODE   0x2ba01477
+#define SWD_TARGET_AP_IDR   0x24770011
+#define SWD_TARGET_RAM      0x20000000
+#define SWD_TARGET_RAM_SIZE (128 * 1024)
+
+/* pins, as driven by the host */
+extern int  swd_host_swdio;
+extern bool swd_host_swdio_out;
+
+/* rising edges of swclk */
+extern uint32_t swd_target_edges;
+
+/* swclk clocks the jtag model in jtag_target.c instead */
+extern bool swd_target_jtag;
+
+extern uint8_t swd_target_ram[SWD_TARGET_RAM_SIZE];
+
+struct swd_target_config
+{
+    uint32_t wait_every; /* every nth ap access answers WAIT, 0 for never */
+    uint32_t wait_count; /* WAITs before the access goes through */
+    uint32_t max_freq;   /* above this swclk, every 16th bit the host reads is wrong. 0 for no limit */
+};
+
+struct swd_target_stats
+{
+    uint32_t ok;
+    uint32_t wait;
+    uint32_t fault;
+    uint32_t protocol_errors;
+    uint32_t line_resets;
+    uint32_t transfer_edges; /* swclk edges from start bit to end of transfer */
+};
+
+extern struct swd_target_config swd_target_config;
+extern struct swd_target_stats  swd_target_stats;
+
+/* for benchmarks: with swd_target_record set, the swdio bits the host reads from the
+   target are stored there. with swd_target_playback set, dap_config.h reads them back
+   from there, and bypasses the model */
+extern uint8_t       *swd_target_record;
+extern const uint8_t *swd_target_playback;
+
+void swd_target_reset(void);
+void swd_target_clock_low(void);
+void swd_target_clock_high(void);
+int  swd_target_clock_read(void);
+int  swd_target_swdio_read(void);
+
+/* 1 when the host misreads the next bit at swclk 'freq' */
+int  swd_target_misread(int freq);
+
+/* jtag-dp access to the dp and mem-ap. returns the swd ack */
+uint32_t swd_target_access(int req, uint32_t *value);
+
+#endif